@@ -10,12 +10,57 @@
 #include <stack>
 #include <ranges>
 #include <numbers>
-#include <regex>
+#include <charconv>
 #include <variant>
 #include <chrono>
 #include <cmath>
+#include <cstring>
+#include <span>
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_set>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <deque>
+#include <bit>
+#include <random>
+#if defined(_WIN32)
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <fstream>
+#include <filesystem>
+#include <array>
+#include <optional>
+#include <ctime>
+#include <sstream>
+#include <memory_resource>
+#include <cstdlib>
+#include <new>
+//#define HEADLESS_ONLY //build without SDL, only the command line image export is left
+#ifndef HEADLESS_ONLY
 #define SDL_MAIN_HANDLED
 #include <SDL.h>
+#endif
 
 constexpr uint32_t white = 0xFFFFFFFF;
 constexpr uint32_t black = 0x00000000;
@@ -24,15 +69,59 @@ constexpr uint32_t red = 0xFFBB0000;
 constexpr uint32_t yellow = 0xFFFFFF00;
 constexpr uint32_t bright_red = 0xFFFF0000;
 constexpr uint32_t blue = 0xFF0000FF;
+constexpr uint32_t cyan = 0xFF00FFFF;
+constexpr uint32_t magenta = 0xFFFF00FF;
+constexpr uint32_t orange = 0xFFFF8000;
+constexpr uint32_t light_blue = 0xFF6090FF;
+constexpr uint32_t curve_colors[] = { yellow, cyan, magenta, orange, white, light_blue, bright_red };
 
 #define HIGH_PRECISION_PLOTTING_ENABLED
+#define JIT_ENABLED //compile plotted expressions to native code where jit::compile supports it
+//#define ALLOCATION_COUNTING_ENABLED //replace operator new to count the heap allocations of each thread, alloc_tests() keeps parsing free of them
+//#define PROFILING_ENABLED //time the parse, plot and render phases into per thread rings, f11 shows an overlay, f12 writes a chrome trace
 
 #ifdef HIGH_PRECISION_PLOTTING_ENABLED
-constexpr int max_pt = 1000;
-constexpr int min_pt = 5000;
+constexpr double plot_tolerance = 0.25; //max distance in pixels between a drawn line and the curve
+constexpr int max_subdivisions = 10;
 #else
-constexpr int max_pt = 100;
-constexpr int min_pt = 50;
+constexpr double plot_tolerance = 1.0;
+constexpr int max_subdivisions = 8;
+#endif
+constexpr double coarse_step_px = 4.0; //spacing of the initial samples in pixels, before any subdivision
+constexpr int preview_subdivisions = 2; //rounds of the quick first pass the window shows while zooming
+//#define ANTIALIASED_PLOTTING_ENABLED //blend curves in with wu lines instead of solid pixels
+
+#ifdef ALLOCATION_COUNTING_ENABLED
+//heap allocations this thread made so far, every operator new goes through the replacement below
+thread_local size_t heap_allocations = 0;
+
+//gcc sees malloc in new and free in delete once they are inlined, and warns about the pair
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void* operator new(std::size_t size)
+{
+    ++heap_allocations;
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
 #endif
 
 constexpr int screen_w = 640;
@@ -45,578 +134,9287 @@ struct pt_2d
     int x, y;
 };
 
-namespace parser
+//argb pixels, row major without padding, the size is picked at runtime
+//so the window uses screen_w x screen_h while exported images can be anything
+struct pixel_buffer
 {
-    enum class assoc
+    uint32_t* data;
+    int w, h;
+
+    //the outermost rows and columns are never drawn on
+    bool inside(int x, int y) const
     {
-        LEFT,
-        RIGHT
+        return x > 0 && y > 0 && x < w - 1 && y < h - 1;
+    }
+};
+
+#ifdef PROFILING_ENABLED
+//scoped timers for the hot paths, each thread writes the scopes it finished into its own
+//ring without locking and anyone can read all the rings at any time for a trace or the overlay
+namespace profiler
+{
+    //one finished scope, times in ns since the program started
+    struct event
+    {
+        const char* name;
+        int64_t start;
+        int64_t duration;
+        uint64_t count; //what the scope did, evaluations for plots, 0 if nothing was counted
     };
 
-    //pair is <prec, assoc_id>
-    static std::unordered_map<std::string_view, std::pair<int, assoc>> assoc_prec{
-        {"^", {4, assoc::RIGHT}},
-        {"*", {3, assoc::LEFT}},
-        {"/", {3, assoc::LEFT}},
-        {"+", {2, assoc::LEFT}},
-        {"-", {2, assoc::LEFT}} };
+    constexpr size_t ring_capacity = 1 << 14; //events kept per thread, older ones are overwritten
+    constexpr const char* trace_file = "trace.json"; //where f12 writes the trace
 
-    static std::unordered_map<std::string_view, double(*)(double)> unary_func_tbl{ 
-        {"sin", std::sin},
-        {"cos", std::cos},
-        {"sqrt", std::sqrt},
-        {"abs", std::fabs},
-        {"tan", std::tan},
-        {"acos", std::acos},
-        {"asin", std::asin},
-        {"atan", std::atan},
-        {"log", std::log},
-        {"log10", std::log10},
-        {"cosh", std::cosh},
-        {"sinh", std::sinh},
-        {"tanh", std::tanh},
-        {"exp", std::exp},
-        {"cbrt", std::cbrt},
-        {"tgamma", std::tgamma},
-        {"lgamma", std::lgamma},
-        {"ceil", std::ceil},
-        {"floor", std::floor},
-        {"acosh", std::acosh},
-        {"asinh", std::asinh},
-        {"trunc", std::trunc},
-        {"atanh", std::atanh} };
+    //single writer, any number of readers
+    //the writer publishes every event by bumping head, a reader copies what it sees and then
+    //drops the events the writer may have been overwriting meanwhile
+    class event_ring
+    {
+    public:
+        void push(const event& e)
+        {
+            const uint64_t i = head.load(std::memory_order_relaxed);
+            //pairs with the fence in snapshot, a reader that copied any of the stores below
+            //sees head at least at i afterwards and so drops this slot as torn
+            std::atomic_thread_fence(std::memory_order_release);
+            slot& s = slots[i % ring_capacity];
+            s.name.store(e.name, std::memory_order_relaxed);
+            s.start.store(e.start, std::memory_order_relaxed);
+            s.duration.store(e.duration, std::memory_order_relaxed);
+            s.count.store(e.count, std::memory_order_relaxed);
+            head.store(i + 1, std::memory_order_release);
+        }
+
+        //the events still in the ring, oldest first
+        std::vector<event> snapshot() const
+        {
+            const uint64_t end = head.load(std::memory_order_acquire);
+            const uint64_t begin = end > ring_capacity ? end - ring_capacity : 0;
+            std::vector<event> res;
+            res.reserve(end - begin);
+            for (uint64_t i = begin; i < end; i++)
+            {
+                const slot& s = slots[i % ring_capacity];
+                res.push_back({ s.name.load(std::memory_order_relaxed), s.start.load(std::memory_order_relaxed),
+                                s.duration.load(std::memory_order_relaxed), s.count.load(std::memory_order_relaxed) });
+            }
+            //slot i is rewritten as event i + ring_capacity, so everything the writer got to while
+            //copying is at or before the head it has now minus a whole ring, a full ring loses its oldest
+            //event this way even if the writer is idle
+            std::atomic_thread_fence(std::memory_order_acquire);
+            const uint64_t now = head.load(std::memory_order_relaxed);
+            const uint64_t torn = now >= ring_capacity ? now - ring_capacity + 1 : 0;
+            res.erase(res.begin(), res.begin() + static_cast<ptrdiff_t>(std::min<uint64_t>(std::max(torn, begin) - begin, res.size())));
+            return res;
+        }
+
+        //every event ever pushed, including the overwritten ones
+        uint64_t pushed() const
+        {
+            return head.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct slot
+        {
+            std::atomic<const char*> name{ nullptr };
+            std::atomic<int64_t> start{ 0 };
+            std::atomic<int64_t> duration{ 0 };
+            std::atomic<uint64_t> count{ 0 };
+        };
+
+        std::atomic<uint64_t> head{ 0 };
+        std::unique_ptr<slot[]> slots = std::make_unique<slot[]>(ring_capacity);
+    };
+
+    struct thread_log
+    {
+        uint32_t tid;
+        event_ring events;
+    };
+
+    //all rings, they stay alive after their threads exit so a trace still has them
+    class registry
+    {
+    public:
+        std::shared_ptr<thread_log> add()
+        {
+            std::lock_guard lock(mtx);
+            logs.push_back(std::make_shared<thread_log>());
+            logs.back()->tid = static_cast<uint32_t>(logs.size());
+            return logs.back();
+        }
 
-    bool is_left_assoc(std::string_view str)
+        std::vector<std::shared_ptr<const thread_log>> get_logs() const
+        {
+            std::lock_guard lock(mtx);
+            return { logs.begin(), logs.end() };
+        }
+
+    private:
+        mutable std::mutex mtx;
+        std::vector<std::shared_ptr<thread_log>> logs;
+    };
+
+    registry& get_registry()
     {
-        return assoc_prec[str].second == assoc::LEFT;
+        static registry reg;
+        return reg;
     }
 
-    bool is_binary_op(std::string_view str)
+    //the ring of the calling thread, registered by its first scope
+    thread_log& local_log()
     {
-        return (str == "/" || str == "*" || str == "+" || str == "-" || str == "^");
+        thread_local const std::shared_ptr<thread_log> log = get_registry().add();
+        return *log;
     }
 
-    bool is_func(std::string_view str)
+    int64_t now_ns()
     {
-        return unary_func_tbl.contains(str);
+        static const auto epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
     }
 
-    //checks if the str is a number, handles decimal numbers
-    bool is_num(std::string_view str)
+    //times its own lifetime, count is read when the scope ends so it can be filled in on the way
+    class scope
+    {
+    public:
+        explicit scope(const char* name, const size_t* count = nullptr) : name(name), count(count), start(now_ns()) {}
+
+        ~scope()
+        {
+            local_log().events.push({ name, start, now_ns() - start, count ? *count : 0 });
+        }
+
+        scope(const scope&) = delete;
+        scope& operator=(const scope&) = delete;
+
+    private:
+        const char* name;
+        const size_t* count;
+        int64_t start;
+    };
+
+    //every event still in the rings as chrome trace json, for chrome://tracing or ui.perfetto.dev
+    void write_chrome_trace(std::ostream& out)
     {
-        int num_found_periods = 0;
-        for (const auto c : str)
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        char buf[64];
+        for (const auto& log : get_registry().get_logs())
         {
-            if (c == '.')
+            out << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->tid
+                << ",\"args\":{\"name\":\"thread " << log->tid << "\"}}";
+            first = false;
+            for (const auto& e : log->events.snapshot())
             {
-                ++num_found_periods;
-                if (num_found_periods > 1)
+                //microseconds with the nanoseconds kept as decimals
+                std::snprintf(buf, sizeof(buf), "%.3f,\"dur\":%.3f", e.start / 1e3, e.duration / 1e3);
+                out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << log->tid << ",\"ts\":" << buf;
+                if (e.count)
                 {
-                    return false;
+                    out << ",\"args\":{\"count\":" << e.count << '}';
                 }
-            }
-            if (!std::isdigit(c) && c != '.')
-            {
-                return false;
+                out << '}';
             }
         }
-        return true;
+        out << "\n]}\n";
     }
 
-    //checks if the number of ")" and "(" are the same
-    //this is better than the std algo because it
-    //only walks the str once
-    bool check_num_parentheses(std::string_view str)
+    //frame time and evaluation rate for the overlay, smoothed over the last frames
+    class frame_meter
     {
-        int left_count = 0;
-        int right_count = 0;
-        for (const auto c : str)
+    public:
+        //a frame that took seconds, of which plot_seconds went into the evals evaluations
+        void add(double seconds, double plot_seconds, size_t evals)
         {
-            if (c == '(')
-            {
-                ++left_count;
-            }
-            else if (c == ')')
+            constexpr double smoothing = 0.2;
+            frame_ms = frames++ ? frame_ms + smoothing * (seconds * 1e3 - frame_ms) : seconds * 1e3;
+            if (evals && plot_seconds > 0.0)
             {
-                ++right_count;
+                evals_per_second = evals / plot_seconds; //only frames that plotted say anything about it
             }
         }
-        return left_count == right_count;
-    }
 
-    class parse_error : public std::runtime_error 
+        double get_frame_ms() const { return frame_ms; }
+        double get_evals_per_second() const { return evals_per_second; }
+
+    private:
+        size_t frames = 0;
+        double frame_ms = 0.0;
+        double evals_per_second = 0.0;
+    };
+}
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+//times the rest of the enclosing block under name, which has to be a string literal
+#define PROFILE_SCOPE(name) const profiler::scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+//same, and records the value count (a size_t) has when the block ends
+#define PROFILE_SCOPE_COUNT(name, count) const profiler::scope PROFILE_CONCAT(profile_scope_, __LINE__)(name, &(count))
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_SCOPE_COUNT(name, count)
+#endif
+
+//array kernels used by compiled_func::evaluate
+//every kernel works in place on dst, the sse2 and avx2 versions are picked
+//once at startup and anything without a vector version falls back to scalar code
+namespace simd
+{
+    enum class binary_kernel { ADD, SUB, MUL, DIV, COUNT };
+    enum class unary_kernel { NEG, ABS, SQRT, FLOOR, CEIL, TRUNC, COUNT };
+    enum class approx_kernel { EXP, LOG, SIN, COS, TAN, COUNT };
+
+    //how exactly calls and powers are evaluated, picked by whoever compiles the expression:
+    //the calculator wants what libm gives, a plot only needs a fraction of a pixel
+    enum class accuracy
     {
-        public:
-            explicit parse_error(const std::string& what) : std::runtime_error(what) {}
-            explicit parse_error(const char* what) : std::runtime_error(what) {}
+        EXACT, //libm
+        FAST, //within a few ulp and pow within 160, max_ulp() has the bound of each function
+        COARSE //shorter polynomials, within about 1e-8 relative
     };
 
-    int get_prec(std::string_view str)
+    using binary_fn = void(*)(double* dst, const double* src, size_t n);
+    using binary_scalar_fn = void(*)(double* dst, double src, size_t n);
+    using unary_fn = void(*)(double* dst, size_t n);
+
+    struct kernel_table
     {
-        if (is_func(str)) { return 1; } //TODO: check it this is the correct value
-        else if (is_binary_op(str)) { return assoc_prec[str].first; }
-        else { return 0; }
+        const char* name;
+        binary_fn binary[static_cast<int>(binary_kernel::COUNT)];
+        binary_scalar_fn binary_scalar[static_cast<int>(binary_kernel::COUNT)];
+        unary_fn unary[static_cast<int>(unary_kernel::COUNT)]; //nullptr if there is no vector version
+        unary_fn approx[2][static_cast<int>(approx_kernel::COUNT)]; //FAST then COARSE
+        binary_fn pow[2]; //dst = pow(dst, src), FAST then COARSE
+    };
+
+    template<binary_kernel op>
+    inline double apply(double a, double b)
+    {
+        if constexpr (op == binary_kernel::ADD) return a + b;
+        else if constexpr (op == binary_kernel::SUB) return a - b;
+        else if constexpr (op == binary_kernel::MUL) return a * b;
+        else return a / b;
     }
 
-    //create regex string partially from func table
-    static const std::string get_regex(std::string var_name) 
+    namespace scalar
     {
-        auto func_names{ std::views::keys(unary_func_tbl) };
-        std::ostringstream os;
-        os << "(";
-        for (const auto& name : std::views::keys(unary_func_tbl)) 
+        template<binary_kernel op>
+        void binary(double* dst, const double* src, size_t n)
+        {
+            for (size_t i = 0; i < n; i++) dst[i] = apply<op>(dst[i], src[i]);
+        }
+
+        template<binary_kernel op>
+        void binary_scalar(double* dst, double src, size_t n)
+        {
+            for (size_t i = 0; i < n; i++) dst[i] = apply<op>(dst[i], src);
+        }
+
+        void neg(double* dst, size_t n)
         {
-            os << name << "|";
+            for (size_t i = 0; i < n; i++) dst[i] = -dst[i];
         }
-        os << var_name << "|"
-           << R"(e|pi)|)"
-           << R"(([0-9]+[.])?[0-9]+|[-+\()/*^])";
-        return os.str();
     }
 
-    //passing by value so we can modify the copy
-    //tokenize using regex
-    std::vector<std::string> tokenize(std::string str, std::string var_name)
+    //branch free polynomial versions of exp, log, sin, cos, tan and pow
+    //arguments outside the range the reduction handles go to libm, so nan, inf,
+    //subnormals and huge angles come out exactly as before
+    //the avx2 kernels do the same operations in the same order, without fma,
+    //so every lane gives the same bits as the scalar version
+    namespace approx
     {
-        if (!check_num_parentheses(str))
+        constexpr double magic = 0x1.8p52; //x + magic - magic rounds x, the integer ends up in the low bits of x + magic
+        constexpr uint64_t magic_bits = 0x4338000000000000;
+        constexpr double inv_ln2 = 0x1.71547652b82fep0;
+        constexpr double ln2_hi = 0x1.62e42feep-1; //short enough that k * ln2_hi is exact
+        constexpr double ln2_lo = 0x1.a39ef35793c76p-33;
+        constexpr double two_over_pi = 0x1.45f306dc9c883p-1;
+        constexpr double pio2_1 = 0x1.921fb544p0; //pi / 2 in three parts, k * the first two is exact for k < 2^20
+        constexpr double pio2_2 = 0x1.0b4611a6p-34;
+        constexpr double pio2_3 = 0x1.3198a2e037073p-69;
+        constexpr uint64_t sqrt_half_bits = 0x3fe6a09e667f3bcd; //log reduces to [sqrt(1/2), sqrt(2))
+        constexpr double exp_limit = 708.0; //2^k stays a normal number
+        constexpr double trig_limit = 1e6; //k * pio2_1 and k * pio2_2 stay exact
+
+        //taylor terms kept at each accuracy
+        template<accuracy A>
+        struct terms
         {
-            throw parse_error("parenthesis issue");
+            static constexpr int exp = A == accuracy::FAST ? 14 : 8;
+            static constexpr int log = A == accuracy::FAST ? 11 : 6;
+            static constexpr int sin = A == accuracy::FAST ? 8 : 5;
+            static constexpr int cos = A == accuracy::FAST ? 9 : 6;
+            //pow loses about 2 |b log a| ulp to the rounding of log a, past this it goes to libm
+            static constexpr double pow_limit = 64.0;
+        };
+
+        constexpr double factorial(int n)
+        {
+            return n <= 1 ? 1.0 : n * factorial(n - 1);
         }
 
-        std::vector<std::string> res;
-        std::string test;
-        const std::regex words_regex(get_regex(var_name), std::regex_constants::egrep);
-         
-        auto words_begin = std::sregex_iterator(str.begin(), str.end(), words_regex);
-        auto words_end = std::sregex_iterator();
-        for (std::sregex_iterator i = words_begin; i != words_end; ++i) 
+        //coefficients of exp(r) in r, of atanh(f) / f in f^2, of sin(r) / r and cos(r) in r^2
+        template<int N>
+        constexpr std::array<double, N> exp_coeffs()
         {
-            res.push_back((*i).str());
-            test += (*i).str();
+            std::array<double, N> c{};
+            for (int i = 0; i < N; i++) c[i] = 1.0 / factorial(i);
+            return c;
         }
-        //this will find all unknown tokens, therefor the rest of 
-        //the parser will assume all tokens are valid
-        std::erase(str, ' ');
-        if (test != str)
+
+        template<int N>
+        constexpr std::array<double, N> log_coeffs()
         {
-            throw parse_error("unknown token in input"); 
+            std::array<double, N> c{};
+            for (int i = 0; i < N; i++) c[i] = 1.0 / (2 * i + 1);
+            return c;
         }
-        return res;
-    }
 
-    //params: 
-    //str - string to be converted
-    //var_name - any occurances of this as a seperate token will be treated as a varable
-    //convert string in infix notation to a string in Reverse Polish Notation
-    //using dijkstra's shunting yard algorithm 
-    std::vector<std::variant<double, std::string>> s_yard(const std::string& str, std::string var_name)
-    {
-        std::vector<std::variant<double, std::string>> output_queue;
-        std::stack<std::string> op_stack;
+        template<int N>
+        constexpr std::array<double, N> sin_coeffs()
+        {
+            std::array<double, N> c{};
+            for (int i = 0; i < N; i++) c[i] = (i % 2 ? -1.0 : 1.0) / factorial(2 * i + 1);
+            return c;
+        }
 
-        //tokenize function should handle all bad tokens
-        for (const auto& tok : tokenize(str, var_name)) 
+        template<int N>
+        constexpr std::array<double, N> cos_coeffs()
         {
-            if (tok == "pi")
+            std::array<double, N> c{};
+            for (int i = 0; i < N; i++) c[i] = (i % 2 ? -1.0 : 1.0) / factorial(2 * i);
+            return c;
+        }
+
+        //c[I] + c[I + 1] x + ... + c[I + N - 1] x^(N - 1) by estrin's scheme, pw[k] is x^(2^k)
+        //the two halves don't wait on each other, so the chain is log2(N) steps long instead of
+        //N like horner, which matters when a jit batch calls the scalar versions lane by lane
+        template<size_t I, size_t N, size_t M>
+        inline double estrin(const double* pw, const std::array<double, M>& c)
+        {
+            if constexpr (N == 1)
             {
-                output_queue.push_back(std::numbers::pi);
+                return c[I];
             }
-            else if (tok == "e")
+            else
             {
-                output_queue.push_back(std::numbers::e_v<double>);
+                constexpr size_t h = std::bit_floor(N - 1);
+                return estrin<I, h>(pw, c) + estrin<I + h, N - h>(pw, c) * pw[std::countr_zero(h)];
             }
-            else if (tok == var_name)
+        }
+
+        template<size_t N>
+        inline double poly(double x, const std::array<double, N>& c)
+        {
+            double pw[std::bit_width(N - 1)];
+            pw[0] = x;
+            for (size_t k = 1; k < std::size(pw); k++) pw[k] = pw[k - 1] * pw[k - 1];
+            return estrin<0, N>(pw, c);
+        }
+
+        template<accuracy A>
+        double exp(double x)
+        {
+            if (!(std::abs(x) <= exp_limit))
             {
-                output_queue.push_back(tok);
+                return std::exp(x);
             }
-            else if (is_num(tok))
+            static constexpr auto c = exp_coeffs<terms<A>::exp>();
+            //x = k ln2 + r with |r| <= ln2 / 2, exp(x) = 2^k exp(r)
+            const double t = x * inv_ln2 + magic;
+            const double k = t - magic;
+            const double r = (x - k * ln2_hi) - k * ln2_lo;
+            const uint64_t scale = (std::bit_cast<uint64_t>(t) - magic_bits + 1023) << 52;
+            return poly(r, c) * std::bit_cast<double>(scale);
+        }
+
+        template<accuracy A>
+        double log(double x)
+        {
+            if (!(x >= std::numeric_limits<double>::min() && x <= std::numeric_limits<double>::max()))
             {
-                output_queue.push_back(strtod(tok.c_str(), nullptr));
+                return std::log(x);
             }
-            else if (is_func(tok))
+            static constexpr auto c = log_coeffs<terms<A>::log>();
+            //x = 2^k m with m in [sqrt(1/2), sqrt(2)), log(m) = 2 atanh(f) with f = (m - 1) / (m + 1)
+            const uint64_t ix = std::bit_cast<uint64_t>(x);
+            const uint64_t iz = ix - ((ix - sqrt_half_bits) & 0xfff0000000000000);
+            const double m = std::bit_cast<double>(iz);
+            const double k = std::bit_cast<double>((ix >> 52) - (iz >> 52) + magic_bits) - magic;
+            const double f = (m - 1.0) / (m + 1.0);
+            return k * ln2_hi + (2.0 * f * poly(f * f, c) + k * ln2_lo);
+        }
+
+        //which of sin, cos and tan trig() computes
+        enum class trig_func { SIN, COS, TAN };
+
+        template<accuracy A, trig_func F>
+        double trig(double x)
+        {
+            if (!(std::abs(x) <= trig_limit))
             {
-                op_stack.push(tok);
+                return F == trig_func::SIN ? std::sin(x) : F == trig_func::COS ? std::cos(x) : std::tan(x);
             }
-            else if (is_binary_op(tok))
-            {   
-                while (!op_stack.empty() &&
-                      (is_binary_op(op_stack.top()) && get_prec(op_stack.top()) > get_prec(tok) ||
-                      (get_prec(op_stack.top()) == get_prec(tok) && is_left_assoc(tok))) &&
-                      (op_stack.top() != "("))
-                {
-                    //pop operators from stack to queue
-                    while (!op_stack.empty())
-                    {
-                        output_queue.push_back(op_stack.top());
-                        op_stack.pop();
-                    }
-                }
-                op_stack.push(tok);
+            static constexpr auto sc = sin_coeffs<terms<A>::sin>();
+            static constexpr auto cc = cos_coeffs<terms<A>::cos>();
+            //x = k pi/2 + r with |r| <= pi/4, the low bits of k pick the quadrant
+            const double t = x * two_over_pi + magic;
+            const double k = t - magic;
+            const double r = ((x - k * pio2_1) - k * pio2_2) - k * pio2_3;
+            const uint64_t q = std::bit_cast<uint64_t>(t) + (F == trig_func::COS ? 1 : 0);
+            const double z = r * r;
+            const double s = r * poly(z, sc);
+            const double c = poly(z, cc);
+            if constexpr (F == trig_func::TAN)
+            {
+                return q & 1 ? -c / s : s / c;
             }
-            else if (tok == "(")
+            else
             {
-                op_stack.push(tok);
+                //cos(x) is sin of the next quadrant
+                const double v = q & 1 ? c : s;
+                return std::bit_cast<double>(std::bit_cast<uint64_t>(v) ^ ((q & 2) << 62));
             }
-            else if (tok == ")")
+        }
+
+        template<accuracy A> double sin(double x) { return trig<A, trig_func::SIN>(x); }
+        template<accuracy A> double cos(double x) { return trig<A, trig_func::COS>(x); }
+        template<accuracy A> double tan(double x) { return trig<A, trig_func::TAN>(x); }
+
+        //exp(b log |a|) for a > 0 and for a < 0 with a whole b, negative if b is odd
+        //the rest goes to libm
+        template<accuracy A>
+        double pow(double a, double b)
+        {
+            const double m = std::abs(a);
+            const bool whole = b == std::floor(b);
+            if ((a > 0.0 || (a < 0.0 && whole)) && m <= std::numeric_limits<double>::max())
             {
-                while (op_stack.top() != "(")
-                {
-                    output_queue.push_back(op_stack.top());
-                    op_stack.pop();
-                }
-                if (op_stack.top() == "(")
-                {
-                    op_stack.pop();
-                }
-                if (is_func(op_stack.top()))
+                const double y = b * log<A>(m);
+                if (std::abs(y) <= terms<A>::pow_limit)
                 {
-                    output_queue.push_back(op_stack.top());
-                    op_stack.pop();
+                    const double r = exp<A>(y);
+                    return a < 0.0 && b * 0.5 != std::floor(b * 0.5) ? -r : r;
                 }
             }
-            else
-            {
-                throw parse_error("unknown token: " + tok);
-            }
+            return std::pow(a, b);
         }
-        //all tokens read
-        while (!op_stack.empty())
+
+        template<double(*f)(double)>
+        void unary(double* dst, size_t n)
         {
-            //there are mismatched parentheses
-            if (op_stack.top() == "(" || op_stack.top() == ")")
+            for (size_t i = 0; i < n; i++) dst[i] = f(dst[i]);
+        }
+
+        template<accuracy A>
+        void pow_array(double* dst, const double* src, size_t n)
+        {
+            for (size_t i = 0; i < n; i++) dst[i] = pow<A>(dst[i], src[i]);
+        }
+
+        //largest error the approximations may have, in ulp against libm, checked by approx_tests()
+        double max_ulp(approx_kernel kernel, accuracy acc)
+        {
+            if (acc == accuracy::EXACT) return 0.0;
+            if (acc == accuracy::COARSE) return 1 << 26; //about 1.5e-8 relative
+            return kernel == approx_kernel::TAN ? 8.0 : 4.0;
+        }
+
+        double max_pow_ulp(accuracy acc)
+        {
+            if (acc == accuracy::EXACT) return 0.0;
+            return acc == accuracy::COARSE ? 1 << 26 : 160.0; //2 pow_limit + the error of exp
+        }
+
+        //scalar version of an approx_kernel, indexed like kernel_table::approx
+        double(*get_scalar(approx_kernel kernel, accuracy acc))(double)
+        {
+            constexpr double(*fast[])(double) = { exp<accuracy::FAST>, log<accuracy::FAST>, sin<accuracy::FAST>, cos<accuracy::FAST>, tan<accuracy::FAST> };
+            constexpr double(*coarse[])(double) = { exp<accuracy::COARSE>, log<accuracy::COARSE>, sin<accuracy::COARSE>, cos<accuracy::COARSE>, tan<accuracy::COARSE> };
+            return (acc == accuracy::FAST ? fast : coarse)[static_cast<int>(kernel)];
+        }
+
+        //true if f is one of the scalar approximations
+        bool is_approx(double(*f)(double))
+        {
+            for (int k = 0; k < static_cast<int>(approx_kernel::COUNT); k++)
             {
-                throw parse_error("mismatched parentheses");
+                if (f == get_scalar(static_cast<approx_kernel>(k), accuracy::FAST) || f == get_scalar(static_cast<approx_kernel>(k), accuracy::COARSE))
+                {
+                    return true;
+                }
             }
-            output_queue.push_back(op_stack.top());
-            op_stack.pop();
+            return false;
         }
-        return output_queue;
     }
-    
-    double compute_binary_ops(double d1, double d2, std::string_view op)
+
+    namespace scalar
     {
-        if (op == "*") return d1 * d2;
-        else if (op == "+") return d1 + d2;
-        else if (op == "-") return d1 - d2;
-        else if (op == "/") return d1 / d2;
-        else if (op == "^") return std::pow(d1, d2);
+        using namespace approx;
+
+        constexpr kernel_table table{ "scalar",
+            { binary<binary_kernel::ADD>, binary<binary_kernel::SUB>, binary<binary_kernel::MUL>, binary<binary_kernel::DIV> },
+            { binary_scalar<binary_kernel::ADD>, binary_scalar<binary_kernel::SUB>, binary_scalar<binary_kernel::MUL>, binary_scalar<binary_kernel::DIV> },
+            { neg, nullptr, nullptr, nullptr, nullptr, nullptr },
+            { { unary<exp<accuracy::FAST>>, unary<log<accuracy::FAST>>, unary<sin<accuracy::FAST>>, unary<cos<accuracy::FAST>>, unary<tan<accuracy::FAST>> },
+              { unary<exp<accuracy::COARSE>>, unary<log<accuracy::COARSE>>, unary<sin<accuracy::COARSE>>, unary<cos<accuracy::COARSE>>, unary<tan<accuracy::COARSE>> } },
+            { pow_array<accuracy::FAST>, pow_array<accuracy::COARSE> } };
     }
 
-    //creates function that fully represents the rpn vec that is passed
-    //this can be optimized by reducing uneeded functions
-    //eg 1 + 1 + 2 could just be 4
-    std::function<double(double)> build_func(const std::vector<std::variant<double, std::string>>& tokens, std::string var_name)
+#ifdef SIMD_X86
+    namespace sse2
     {
-        std::stack<std::function<double(double)>> stack;
-        for (const auto& tok : tokens)
+        template<binary_kernel op>
+        inline __m128d apply(__m128d a, __m128d b)
         {
-            if (const double* num_ptr = std::get_if<double>(&tok))
+            if constexpr (op == binary_kernel::ADD) return _mm_add_pd(a, b);
+            else if constexpr (op == binary_kernel::SUB) return _mm_sub_pd(a, b);
+            else if constexpr (op == binary_kernel::MUL) return _mm_mul_pd(a, b);
+            else return _mm_div_pd(a, b);
+        }
+
+        template<binary_kernel op>
+        void binary(double* dst, const double* src, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
             {
-                stack.push([number = *num_ptr](double) {return number;});
+                _mm_storeu_pd(dst + i, apply<op>(_mm_loadu_pd(dst + i), _mm_loadu_pd(src + i)));
             }
-            else if (std::get<std::string>(tok) == var_name)
+            for (; i < n; i++) dst[i] = simd::apply<op>(dst[i], src[i]);
+        }
+
+        template<binary_kernel op>
+        void binary_scalar(double* dst, double src, size_t n)
+        {
+            const __m128d b = _mm_set1_pd(src);
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
             {
-                stack.push([](double var_value) {return var_value;});
+                _mm_storeu_pd(dst + i, apply<op>(_mm_loadu_pd(dst + i), b));
             }
-            else if (is_binary_op(std::get<std::string>(tok)))
+            for (; i < n; i++) dst[i] = simd::apply<op>(dst[i], src);
+        }
+
+        template<unary_kernel op>
+        void unary(double* dst, size_t n)
+        {
+            const __m128d sign = _mm_set1_pd(-0.0);
+            size_t i = 0;
+            for (; i + 2 <= n; i += 2)
             {
-                auto right = stack.top();
-                stack.pop();
-                if (!stack.empty())
-                {
-                    auto left = stack.top();
-                    stack.pop();
-                    auto op = std::get<std::string>(tok);
-                    stack.push([left, right, op](double var_value) {return compute_binary_ops(left(var_value), right(var_value), op);});
-                }
-                //if unary minus
-                else if(std::get<std::string>(tok) == "-")
-                {
-                    stack.push([right](double var_value) {return -(right(var_value));});
-                }         
+                const __m128d a = _mm_loadu_pd(dst + i);
+                if constexpr (op == unary_kernel::NEG) _mm_storeu_pd(dst + i, _mm_xor_pd(a, sign));
+                else if constexpr (op == unary_kernel::ABS) _mm_storeu_pd(dst + i, _mm_andnot_pd(sign, a));
+                else _mm_storeu_pd(dst + i, _mm_sqrt_pd(a));
             }
-            else if (is_func(std::get<std::string>(tok)))
+            for (; i < n; i++)
             {
-                auto operand = stack.top();
-                stack.pop();
-                auto func = unary_func_tbl[std::get<std::string>(tok)];
-                stack.push([operand, func](double var_value) {return func(operand(var_value));});
+                if constexpr (op == unary_kernel::NEG) dst[i] = -dst[i];
+                else if constexpr (op == unary_kernel::ABS) dst[i] = std::fabs(dst[i]);
+                else dst[i] = std::sqrt(dst[i]);
             }
         }
-        return stack.top();
+
+        //sse2 has no packed rounding, floor/ceil/trunc stay scalar, and neither blends nor
+        //64 bit compares, so the approximations are the scalar ones
+        constexpr kernel_table table{ "sse2",
+            { binary<binary_kernel::ADD>, binary<binary_kernel::SUB>, binary<binary_kernel::MUL>, binary<binary_kernel::DIV> },
+            { binary_scalar<binary_kernel::ADD>, binary_scalar<binary_kernel::SUB>, binary_scalar<binary_kernel::MUL>, binary_scalar<binary_kernel::DIV> },
+            { unary<unary_kernel::NEG>, unary<unary_kernel::ABS>, unary<unary_kernel::SQRT>, nullptr, nullptr, nullptr },
+            { scalar::table.approx[0][0], scalar::table.approx[0][1], scalar::table.approx[0][2], scalar::table.approx[0][3], scalar::table.approx[0][4],
+              scalar::table.approx[1][0], scalar::table.approx[1][1], scalar::table.approx[1][2], scalar::table.approx[1][3], scalar::table.approx[1][4] },
+            { scalar::table.pow[0], scalar::table.pow[1] } };
     }
-}
 
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+    namespace avx2
+    {
+        template<binary_kernel op>
+        inline __m256d apply(__m256d a, __m256d b)
+        {
+            if constexpr (op == binary_kernel::ADD) return _mm256_add_pd(a, b);
+            else if constexpr (op == binary_kernel::SUB) return _mm256_sub_pd(a, b);
+            else if constexpr (op == binary_kernel::MUL) return _mm256_mul_pd(a, b);
+            else return _mm256_div_pd(a, b);
+        }
 
-SDL_Window* create_centered_window(uint32_t width, uint32_t height, const char* title)
-{
-    // Get current device's Display Mode to calculate window position
-    SDL_DisplayMode DM;
-    SDL_GetCurrentDisplayMode(0, &DM);
+        template<binary_kernel op>
+        void binary(double* dst, const double* src, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                _mm256_storeu_pd(dst + i, apply<op>(_mm256_loadu_pd(dst + i), _mm256_loadu_pd(src + i)));
+            }
+            for (; i < n; i++) dst[i] = simd::apply<op>(dst[i], src[i]);
+        }
 
-    // Calculate where the upper-left corner of a centered window will be
-    const int32_t x = DM.w / 2 - width / 2;
-    const int32_t y = DM.h / 2 - height / 2;
+        template<binary_kernel op>
+        void binary_scalar(double* dst, double src, size_t n)
+        {
+            const __m256d b = _mm256_set1_pd(src);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                _mm256_storeu_pd(dst + i, apply<op>(_mm256_loadu_pd(dst + i), b));
+            }
+            for (; i < n; i++) dst[i] = simd::apply<op>(dst[i], src);
+        }
 
-    // Create the SDL window
-    SDL_Window* pWindow = SDL_CreateWindow(title, x, y, screen_w, screen_h,
-        SDL_WINDOW_ALLOW_HIGHDPI);
+        template<unary_kernel op>
+        void unary(double* dst, size_t n)
+        {
+            const __m256d sign = _mm256_set1_pd(-0.0);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m256d a = _mm256_loadu_pd(dst + i);
+                if constexpr (op == unary_kernel::NEG) _mm256_storeu_pd(dst + i, _mm256_xor_pd(a, sign));
+                else if constexpr (op == unary_kernel::ABS) _mm256_storeu_pd(dst + i, _mm256_andnot_pd(sign, a));
+                else if constexpr (op == unary_kernel::SQRT) _mm256_storeu_pd(dst + i, _mm256_sqrt_pd(a));
+                else if constexpr (op == unary_kernel::FLOOR) _mm256_storeu_pd(dst + i, _mm256_round_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC));
+                else if constexpr (op == unary_kernel::CEIL) _mm256_storeu_pd(dst + i, _mm256_round_pd(a, _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC));
+                else _mm256_storeu_pd(dst + i, _mm256_round_pd(a, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC));
+            }
+            for (; i < n; i++)
+            {
+                if constexpr (op == unary_kernel::NEG) dst[i] = -dst[i];
+                else if constexpr (op == unary_kernel::ABS) dst[i] = std::fabs(dst[i]);
+                else if constexpr (op == unary_kernel::SQRT) dst[i] = std::sqrt(dst[i]);
+                else if constexpr (op == unary_kernel::FLOOR) dst[i] = std::floor(dst[i]);
+                else if constexpr (op == unary_kernel::CEIL) dst[i] = std::ceil(dst[i]);
+                else dst[i] = std::trunc(dst[i]);
+            }
+        }
 
-    return pWindow;
+        //the same splits as approx::estrin
+        template<size_t I, size_t N, size_t M>
+        inline __m256d estrin(const __m256d* pw, const std::array<double, M>& c)
+        {
+            if constexpr (N == 1)
+            {
+                return _mm256_set1_pd(c[I]);
+            }
+            else
+            {
+                constexpr size_t h = std::bit_floor(N - 1);
+                return _mm256_add_pd(estrin<I, h>(pw, c), _mm256_mul_pd(estrin<I + h, N - h>(pw, c), pw[std::countr_zero(h)]));
+            }
+        }
+
+        template<size_t N>
+        inline __m256d poly(__m256d x, const std::array<double, N>& c)
+        {
+            __m256d pw[std::bit_width(N - 1)];
+            pw[0] = x;
+            for (size_t k = 1; k < std::size(pw); k++) pw[k] = _mm256_mul_pd(pw[k - 1], pw[k - 1]);
+            return estrin<0, N>(pw, c);
+        }
+
+        inline __m256d abs(__m256d x)
+        {
+            return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x);
+        }
+
+        inline __m256i set(uint64_t v)
+        {
+            return _mm256_set1_epi64x(static_cast<long long>(v));
+        }
+
+        //approx::exp, log and trig on four lanes, step for step, for arguments they don't hand to libm
+        template<accuracy A>
+        inline __m256d exp_lanes(__m256d x)
+        {
+            static constexpr auto c = approx::exp_coeffs<approx::terms<A>::exp>();
+            const __m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(approx::inv_ln2)), _mm256_set1_pd(approx::magic));
+            const __m256d k = _mm256_sub_pd(t, _mm256_set1_pd(approx::magic));
+            const __m256d r = _mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(approx::ln2_hi))),
+                                            _mm256_mul_pd(k, _mm256_set1_pd(approx::ln2_lo)));
+            const __m256i scale = _mm256_slli_epi64(_mm256_add_epi64(_mm256_sub_epi64(_mm256_castpd_si256(t), set(approx::magic_bits)), set(1023)), 52);
+            return _mm256_mul_pd(poly(r, c), _mm256_castsi256_pd(scale));
+        }
+
+        template<accuracy A>
+        inline __m256d log_lanes(__m256d x)
+        {
+            static constexpr auto c = approx::log_coeffs<approx::terms<A>::log>();
+            const __m256i ix = _mm256_castpd_si256(x);
+            const __m256i iz = _mm256_sub_epi64(ix, _mm256_and_si256(_mm256_sub_epi64(ix, set(approx::sqrt_half_bits)), set(0xfff0000000000000)));
+            const __m256d m = _mm256_castsi256_pd(iz);
+            const __m256i k_bits = _mm256_add_epi64(_mm256_sub_epi64(_mm256_srli_epi64(ix, 52), _mm256_srli_epi64(iz, 52)), set(approx::magic_bits));
+            const __m256d k = _mm256_sub_pd(_mm256_castsi256_pd(k_bits), _mm256_set1_pd(approx::magic));
+            const __m256d one = _mm256_set1_pd(1.0);
+            const __m256d f = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+            const __m256d p = _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(2.0), f), poly(_mm256_mul_pd(f, f), c));
+            return _mm256_add_pd(_mm256_mul_pd(k, _mm256_set1_pd(approx::ln2_hi)), _mm256_add_pd(p, _mm256_mul_pd(k, _mm256_set1_pd(approx::ln2_lo))));
+        }
+
+        template<accuracy A, approx::trig_func F>
+        inline __m256d trig_lanes(__m256d x)
+        {
+            static constexpr auto sc = approx::sin_coeffs<approx::terms<A>::sin>();
+            static constexpr auto cc = approx::cos_coeffs<approx::terms<A>::cos>();
+            const __m256d t = _mm256_add_pd(_mm256_mul_pd(x, _mm256_set1_pd(approx::two_over_pi)), _mm256_set1_pd(approx::magic));
+            const __m256d k = _mm256_sub_pd(t, _mm256_set1_pd(approx::magic));
+            const __m256d r = _mm256_sub_pd(_mm256_sub_pd(_mm256_sub_pd(x, _mm256_mul_pd(k, _mm256_set1_pd(approx::pio2_1))),
+                                                          _mm256_mul_pd(k, _mm256_set1_pd(approx::pio2_2))),
+                                            _mm256_mul_pd(k, _mm256_set1_pd(approx::pio2_3)));
+            const __m256i q = _mm256_add_epi64(_mm256_castpd_si256(t), set(F == approx::trig_func::COS ? 1 : 0));
+            const __m256d z = _mm256_mul_pd(r, r);
+            const __m256d s = _mm256_mul_pd(r, poly(z, sc));
+            const __m256d c = poly(z, cc);
+            const __m256d odd = _mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_and_si256(q, set(1)), set(1)));
+            if constexpr (F == approx::trig_func::TAN)
+            {
+                const __m256d neg_c = _mm256_xor_pd(c, _mm256_set1_pd(-0.0));
+                return _mm256_div_pd(_mm256_blendv_pd(s, neg_c, odd), _mm256_blendv_pd(c, s, odd));
+            }
+            else
+            {
+                const __m256i sign = _mm256_slli_epi64(_mm256_and_si256(q, set(2)), 62);
+                return _mm256_xor_pd(_mm256_blendv_pd(s, c, odd), _mm256_castsi256_pd(sign));
+            }
+        }
+
+        //lanes the approximations take, the same tests as the scalar versions
+        inline __m256d exp_domain(__m256d x)
+        {
+            return _mm256_cmp_pd(abs(x), _mm256_set1_pd(approx::exp_limit), _CMP_LE_OQ);
+        }
+
+        inline __m256d log_domain(__m256d x)
+        {
+            return _mm256_and_pd(_mm256_cmp_pd(x, _mm256_set1_pd(std::numeric_limits<double>::min()), _CMP_GE_OQ),
+                                 _mm256_cmp_pd(x, _mm256_set1_pd(std::numeric_limits<double>::max()), _CMP_LE_OQ));
+        }
+
+        inline __m256d trig_domain(__m256d x)
+        {
+            return _mm256_cmp_pd(abs(x), _mm256_set1_pd(approx::trig_limit), _CMP_LE_OQ);
+        }
+
+        //four values at a time, the few lanes outside the domain are redone by the scalar
+        //version, which hands them to libm
+        template<__m256d(*lanes)(__m256d), __m256d(*domain)(__m256d), double(*scalar)(double)>
+        void approx_unary(double* dst, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m256d x = _mm256_loadu_pd(dst + i);
+                _mm256_storeu_pd(dst + i, lanes(x));
+                if (const int inside = _mm256_movemask_pd(domain(x)); inside != 0xF)
+                {
+                    alignas(32) double xs[4];
+                    _mm256_store_pd(xs, x);
+                    for (int j = 0; j < 4; j++) if (!(inside >> j & 1)) dst[i + j] = scalar(xs[j]);
+                }
+            }
+            for (; i < n; i++) dst[i] = scalar(dst[i]);
+        }
+
+        template<accuracy A>
+        void approx_pow(double* dst, const double* src, size_t n)
+        {
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4)
+            {
+                const __m256d a = _mm256_loadu_pd(dst + i);
+                const __m256d b = _mm256_loadu_pd(src + i);
+                const __m256d m = abs(a);
+                const __m256d y = _mm256_mul_pd(b, log_lanes<A>(m));
+                const __m256d limit = _mm256_set1_pd(approx::terms<A>::pow_limit);
+                //clamped so the lanes that go to libm don't make exp_lanes work on subnormals
+                const __m256d r = exp_lanes<A>(_mm256_max_pd(_mm256_min_pd(y, limit), _mm256_sub_pd(_mm256_setzero_pd(), limit)));
+                const __m256d negative = _mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_LT_OQ);
+                const __m256d whole = _mm256_cmp_pd(b, _mm256_floor_pd(b), _CMP_EQ_OQ);
+                const __m256d half = _mm256_mul_pd(b, _mm256_set1_pd(0.5));
+                const __m256d odd = _mm256_and_pd(negative, _mm256_cmp_pd(half, _mm256_floor_pd(half), _CMP_NEQ_UQ));
+                _mm256_storeu_pd(dst + i, _mm256_xor_pd(r, _mm256_and_pd(odd, _mm256_set1_pd(-0.0))));
+                const __m256d sign_ok = _mm256_or_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ), _mm256_and_pd(negative, whole));
+                const __m256d fast = _mm256_and_pd(_mm256_and_pd(log_domain(m), sign_ok), _mm256_cmp_pd(abs(y), limit, _CMP_LE_OQ));
+                if (const int inside = _mm256_movemask_pd(fast); inside != 0xF)
+                {
+                    alignas(32) double as[4];
+                    _mm256_store_pd(as, a);
+                    for (int j = 0; j < 4; j++) if (!(inside >> j & 1)) dst[i + j] = approx::pow<A>(as[j], src[i + j]);
+                }
+            }
+            for (; i < n; i++) dst[i] = approx::pow<A>(dst[i], src[i]);
+        }
+
+        template<accuracy A>
+        constexpr unary_fn approx_exp = approx_unary<exp_lanes<A>, exp_domain, approx::exp<A>>;
+        template<accuracy A>
+        constexpr unary_fn approx_log = approx_unary<log_lanes<A>, log_domain, approx::log<A>>;
+        template<accuracy A, approx::trig_func F>
+        constexpr unary_fn approx_trig = approx_unary<trig_lanes<A, F>, trig_domain, approx::trig<A, F>>;
+
+        constexpr kernel_table table{ "avx2",
+            { binary<binary_kernel::ADD>, binary<binary_kernel::SUB>, binary<binary_kernel::MUL>, binary<binary_kernel::DIV> },
+            { binary_scalar<binary_kernel::ADD>, binary_scalar<binary_kernel::SUB>, binary_scalar<binary_kernel::MUL>, binary_scalar<binary_kernel::DIV> },
+            { unary<unary_kernel::NEG>, unary<unary_kernel::ABS>, unary<unary_kernel::SQRT>,
+              unary<unary_kernel::FLOOR>, unary<unary_kernel::CEIL>, unary<unary_kernel::TRUNC> },
+            { { approx_exp<accuracy::FAST>, approx_log<accuracy::FAST>, approx_trig<accuracy::FAST, approx::trig_func::SIN>,
+                approx_trig<accuracy::FAST, approx::trig_func::COS>, approx_trig<accuracy::FAST, approx::trig_func::TAN> },
+              { approx_exp<accuracy::COARSE>, approx_log<accuracy::COARSE>, approx_trig<accuracy::COARSE, approx::trig_func::SIN>,
+                approx_trig<accuracy::COARSE, approx::trig_func::COS>, approx_trig<accuracy::COARSE, approx::trig_func::TAN> } },
+            { approx_pow<accuracy::FAST>, approx_pow<accuracy::COARSE> } };
+    }
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+    bool has_avx2()
+    {
+#if defined(_MSC_VER)
+        int regs[4];
+        __cpuid(regs, 1);
+        //the os has to save the ymm registers too
+        if (!(regs[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+        __cpuidex(regs, 7, 0);
+        return regs[1] & (1 << 5);
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+
+    //best kernel table for this cpu, picked on first use
+    const kernel_table& kernels()
+    {
+#ifdef SIMD_X86
+        static const kernel_table& table = has_avx2() ? avx2::table : sse2::table;
+#else
+        static const kernel_table& table = scalar::table;
+#endif
+        return table;
+    }
+
+    //approximation of a unary_func_tbl entry, -1 if there is none
+    int get_approx_kernel(std::string_view func_name)
+    {
+        constexpr std::string_view names[] = { "exp", "log", "sin", "cos", "tan" };
+        const auto it = std::ranges::find(names, func_name);
+        return it == std::end(names) ? -1 : static_cast<int>(it - std::begin(names));
+    }
+
+    //vector version of a unary_func_tbl entry, nullptr if it only has a scalar one
+    unary_fn get_unary_kernel(std::string_view func_name)
+    {
+        const auto& tbl = kernels().unary;
+        if (func_name == "abs") return tbl[static_cast<int>(unary_kernel::ABS)];
+        else if (func_name == "sqrt") return tbl[static_cast<int>(unary_kernel::SQRT)];
+        else if (func_name == "floor") return tbl[static_cast<int>(unary_kernel::FLOOR)];
+        else if (func_name == "ceil") return tbl[static_cast<int>(unary_kernel::CEIL)];
+        else if (func_name == "trunc") return tbl[static_cast<int>(unary_kernel::TRUNC)];
+        else return nullptr;
+    }
 }
 
-//free and terminate
-[[noreturn]] void shutdown(SDL_Window** ppWindow, SDL_Renderer** ppRenderer, SDL_Texture** ppTexture)
+//native code backend for compiled_func, the code generator is jit::compile
+namespace jit
 {
-    if (ppTexture) { SDL_DestroyTexture(*ppTexture); }
-    if (ppRenderer) { SDL_DestroyRenderer(*ppRenderer); }
-    if (ppWindow) { SDL_DestroyWindow(*ppWindow); }
-    exit(0);
+    using scalar_fn = double(*)(double);
+    using batch_fn = void(*)(const double* xs, double* out, size_t n);
+
+    //owns a block of executable memory holding a scalar and a batch entry point
+    class jit_func
+    {
+    public:
+        //turns written pages into executable read only ones, false if the system refuses
+        using protect_fn = bool(*)(void* mem, size_t size);
+
+        static bool make_executable(void* mem, size_t size)
+        {
+#if defined(_WIN32)
+            DWORD old_protect;
+            if (!VirtualProtect(mem, size, PAGE_EXECUTE_READ, &old_protect))
+            {
+                return false;
+            }
+            FlushInstructionCache(GetCurrentProcess(), mem, size);
+            return true;
+#else
+            return mprotect(mem, size, PROT_READ | PROT_EXEC) == 0;
+#endif
+        }
+
+        //copies code into pages of its own and makes them executable with protect
+        //nullptr if there is no memory or the system won't make it executable (a w^x policy
+        //like selinux execmem), so callers fall back to the interpreter instead of crashing
+        static std::shared_ptr<const jit_func> create(const std::vector<uint8_t>& code, size_t batch_entry, protect_fn protect = make_executable)
+        {
+            const size_t size = code.size();
+#if defined(_WIN32)
+            void* mem = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+            if (!mem)
+            {
+                return nullptr;
+            }
+#else
+            void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mem == MAP_FAILED)
+            {
+                return nullptr;
+            }
+#endif
+            std::memcpy(mem, code.data(), size);
+            if (!protect(mem, size))
+            {
+#if defined(_WIN32)
+                VirtualFree(mem, 0, MEM_RELEASE);
+#else
+                munmap(mem, size);
+#endif
+                return nullptr;
+            }
+            return std::shared_ptr<const jit_func>(new jit_func(mem, size, batch_entry));
+        }
+
+        ~jit_func()
+        {
+#if defined(_WIN32)
+            VirtualFree(mem, 0, MEM_RELEASE);
+#else
+            munmap(mem, size);
+#endif
+        }
+
+        jit_func(const jit_func&) = delete;
+        jit_func& operator=(const jit_func&) = delete;
+
+        scalar_fn scalar() const { return reinterpret_cast<scalar_fn>(mem); }
+        batch_fn batch() const { return reinterpret_cast<batch_fn>(static_cast<uint8_t*>(mem) + batch_offset); }
+
+        //memory the code keeps mapped, whole pages
+        size_t mapped_size() const
+        {
+            const size_t page = page_size();
+            return (size + page - 1) / page * page;
+        }
+
+        static size_t page_size()
+        {
+#if defined(_WIN32)
+            static const size_t page = []
+            {
+                SYSTEM_INFO info;
+                GetSystemInfo(&info);
+                return static_cast<size_t>(info.dwPageSize);
+            }();
+#else
+            static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+            return page;
+        }
+
+    private:
+        void* mem = nullptr;
+        size_t size = 0;
+        size_t batch_offset = 0;
+
+        jit_func(void* mem, size_t size, size_t batch_entry) : mem(mem), size(size), batch_offset(batch_entry) {}
+    };
 }
 
-class SDL_error : public std::runtime_error
+//bump allocator for data that dies together, like everything one parse builds
+//memory is handed out front to back and never freed piece by piece, reset() starts over
+//and keeps the memory, if the last use needed more than one block they are replaced by
+//one big enough for all of it, so after the largest use the arena never touches the heap again
+//a memory_resource, so pmr containers can live in it
+class arena : public std::pmr::memory_resource
 {
 public:
-    explicit SDL_error(const std::string& what) : std::runtime_error(what) {}
-    explicit SDL_error(const char* what) : std::runtime_error(what) {}
+    explicit arena(size_t first_block = 4096) : next_size(first_block) {}
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    //everything allocated before is invalid after this
+    void reset()
+    {
+        if (blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (const auto& b : blocks)
+            {
+                total += b.size;
+            }
+            blocks.clear();
+            blocks.push_back({ std::unique_ptr<std::byte[]>(new std::byte[total]), total });
+            next_size = total * 2;
+        }
+        offset = 0;
+    }
+
+    //bytes held in all blocks
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (const auto& b : blocks)
+        {
+            total += b.size;
+        }
+        return total;
+    }
+
+private:
+    struct block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    std::vector<block> blocks; //allocations come from the last one
+    size_t offset = 0; //bytes used in the last block
+    size_t next_size;
+
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+        if (!blocks.empty())
+        {
+            const auto base = reinterpret_cast<uintptr_t>(blocks.back().data.get());
+            const size_t start = ((base + offset + alignment - 1) & ~(alignment - 1)) - base;
+            if (start + bytes <= blocks.back().size)
+            {
+                offset = start + bytes;
+                return blocks.back().data.get() + start;
+            }
+        }
+        //the rest of the last block stays unused until the next reset
+        const size_t size = std::max(next_size, bytes + alignment);
+        blocks.push_back({ std::unique_ptr<std::byte[]>(new std::byte[size]), size });
+        next_size = size * 2;
+        offset = 0;
+        return do_allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+        return this == &other;
+    }
 };
 
-//from https://stackoverflow.com/a/27030598
-template<typename T>
-std::vector<double> linspace(T start_in, T end_in, int num_in)
+namespace parser
 {
-    std::vector<double> linspaced;
-    linspaced.reserve(num_in);
+    enum class assoc
+    {
+        LEFT,
+        RIGHT
+    };
 
-    double start = static_cast<double>(start_in);
-    double end = static_cast<double>(end_in);
-    double num = static_cast<double>(num_in);
+    //pair is <prec, assoc_id>, constexpr so static_expr parses with the same table
+    constexpr std::pair<std::string_view, std::pair<int, assoc>> assoc_prec[]{
+        {"^", {4, assoc::RIGHT}},
+        {"*", {3, assoc::LEFT}},
+        {"/", {3, assoc::LEFT}},
+        {"+", {2, assoc::LEFT}},
+        {"-", {2, assoc::LEFT}} };
 
-    if (num == 0) { return linspaced; }
-    if (num == 1)
+    //<0, LEFT> for anything that isn't a binary operator
+    constexpr std::pair<int, assoc> get_assoc_prec(std::string_view op)
     {
-        linspaced.push_back(start);
-        return linspaced;
+        for (const auto& [name, value] : assoc_prec)
+        {
+            if (name == op) return value;
+        }
+        return { 0, assoc::LEFT };
     }
 
-    double delta = (end - start) / (num - 1);
+    //every function an expression can call, the lookup tables below are built from it
+    constexpr std::pair<std::string_view, double(*)(double)> unary_funcs[]{
+        {"sin", std::sin},
+        {"cos", std::cos},
+        {"sqrt", std::sqrt},
+        {"abs", std::fabs},
+        {"tan", std::tan},
+        {"acos", std::acos},
+        {"asin", std::asin},
+        {"atan", std::atan},
+        {"log", std::log},
+        {"log10", std::log10},
+        {"cosh", std::cosh},
+        {"sinh", std::sinh},
+        {"tanh", std::tanh},
+        {"exp", std::exp},
+        {"cbrt", std::cbrt},
+        {"tgamma", std::tgamma},
+        {"lgamma", std::lgamma},
+        {"ceil", std::ceil},
+        {"floor", std::floor},
+        {"acosh", std::acosh},
+        {"asinh", std::asinh},
+        {"trunc", std::trunc},
+        {"atanh", std::atanh} };
 
-    for (int i = 0; i < num - 1; ++i)
+    static std::unordered_map<std::string_view, double(*)(double)> unary_func_tbl(std::begin(unary_funcs), std::end(unary_funcs));
+
+    //derivative of lgamma, by the recurrence up to 6 and the asymptotic series from there
+    double digamma(double x)
     {
-        linspaced.push_back(start + delta * i);
+        if (!std::isfinite(x) || (x <= 0.0 && x == std::floor(x)))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        if (x < 0.0)
+        {
+            //reflection, psi(1 - x) - psi(x) = pi cot(pi x)
+            return digamma(1.0 - x) - std::numbers::pi / std::tan(std::numbers::pi * x);
+        }
+        double res = 0.0;
+        for (; x < 6.0; x += 1.0)
+        {
+            res -= 1.0 / x;
+        }
+        const double r = 1.0 / (x * x);
+        return res + std::log(x) - 0.5 / x - r * (1.0 / 12 - r * (1.0 / 120 - r * (1.0 / 252 - r * (1.0 / 240 - r / 132))));
     }
-    linspaced.push_back(end); // I want to ensure that start and end
-                              // are exactly the same as the input
-    return linspaced;
-}
 
-double dist_2d(pt_2d a, pt_2d b)
-{
-    return std::sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
-}
+    //derivative of digamma
+    double trigamma(double x)
+    {
+        if (!std::isfinite(x) || (x <= 0.0 && x == std::floor(x)))
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        if (x < 0.0)
+        {
+            //reflection, psi1(1 - x) + psi1(x) = pi^2 / sin^2(pi x)
+            const double s = std::sin(std::numbers::pi * x);
+            return -trigamma(1.0 - x) + std::numbers::pi * std::numbers::pi / (s * s);
+        }
+        double res = 0.0;
+        for (; x < 6.0; x += 1.0)
+        {
+            res += 1.0 / (x * x);
+        }
+        const double r = 1.0 / (x * x);
+        return res + 1.0 / x + r / 2.0 + r / x * (1.0 / 6 - r * (1.0 / 30 - r * (1.0 / 42 - r / 30)));
+    }
+
+    //first derivative of every unary_func_tbl entry, used by forward mode differentiation
+    //floor, ceil and trunc are flat between their steps
+    static std::unordered_map<std::string_view, double(*)(double)> unary_deriv_tbl{
+        {"sin", [](double x) { return std::cos(x); }},
+        {"cos", [](double x) { return -std::sin(x); }},
+        {"sqrt", [](double x) { return 0.5 / std::sqrt(x); }},
+        {"abs", [](double x) { return x > 0.0 ? 1.0 : x < 0.0 ? -1.0 : 0.0; }},
+        {"tan", [](double x) { const double t = std::tan(x); return 1.0 + t * t; }},
+        {"acos", [](double x) { return -1.0 / std::sqrt(1.0 - x * x); }},
+        {"asin", [](double x) { return 1.0 / std::sqrt(1.0 - x * x); }},
+        {"atan", [](double x) { return 1.0 / (1.0 + x * x); }},
+        {"log", [](double x) { return 1.0 / x; }},
+        {"log10", [](double x) { return 1.0 / (x * std::numbers::ln10); }},
+        {"cosh", [](double x) { return std::sinh(x); }},
+        {"sinh", [](double x) { return std::cosh(x); }},
+        {"tanh", [](double x) { const double t = std::tanh(x); return 1.0 - t * t; }},
+        {"exp", [](double x) { return std::exp(x); }},
+        {"cbrt", [](double x) { const double c = std::cbrt(x); return 1.0 / (3.0 * c * c); }},
+        {"tgamma", [](double x) { return std::tgamma(x) * digamma(x); }},
+        {"lgamma", digamma},
+        {"ceil", [](double) { return 0.0; }},
+        {"floor", [](double) { return 0.0; }},
+        {"acosh", [](double x) { return 1.0 / std::sqrt(x * x - 1.0); }},
+        {"asinh", [](double x) { return 1.0 / std::sqrt(x * x + 1.0); }},
+        {"trunc", [](double) { return 0.0; }},
+        {"atanh", [](double x) { return 1.0 / (1.0 - x * x); }},
+        {"digamma", trigamma} };
+
+    //closed range of values, empty when lo > hi or either end is NaN
+    //continuous is cleared where the function may jump, have a pole or be undefined
+    //somewhere in the range, so a plot can't connect samples across it
+    struct interval
+    {
+        double lo;
+        double hi;
+        bool continuous = true;
+
+        bool empty() const { return !(lo <= hi); }
+    };
+
+    constexpr double infinity = std::numeric_limits<double>::infinity();
+
+    interval empty_interval() { return { infinity, -infinity, false }; }
+    interval entire_interval() { return { -infinity, infinity, false }; }
+
+    //moves both ends outward by at least ulps units in the last place, enough to cover
+    //the rounding of the arithmetic and the error of the libm functions, and clears
+    //continuous if the range became infinite
+    //a relative step instead of nextafter, which is much slower and this runs for every op
+    interval widen(interval x, int ulps = 1)
+    {
+        if (x.empty())
+        {
+            return empty_interval();
+        }
+        const double k = ulps * std::numeric_limits<double>::epsilon();
+        constexpr double tiny = std::numeric_limits<double>::denorm_min();
+        if (std::isfinite(x.lo)) x.lo -= std::abs(x.lo) * k + tiny;
+        if (std::isfinite(x.hi)) x.hi += std::abs(x.hi) * k + tiny;
+        x.continuous &= std::isfinite(x.lo) && std::isfinite(x.hi);
+        return x;
+    }
+
+    //range of an increasing (or decreasing) function over the part of x inside its domain
+    template<bool increasing = true>
+    interval monotonic(double(*f)(double), interval x, double domain_lo = -infinity, double domain_hi = infinity)
+    {
+        if (x.empty() || x.hi < domain_lo || x.lo > domain_hi)
+        {
+            return empty_interval();
+        }
+        const double a = f(std::max(x.lo, domain_lo));
+        const double b = f(std::min(x.hi, domain_hi));
+        const bool inside = x.lo >= domain_lo && x.hi <= domain_hi;
+        return widen({ increasing ? a : b, increasing ? b : a, x.continuous && inside }, 2);
+    }
+
+    //true if p + k period lies in x for some integer k, ends that are
+    //too close to call count as inside
+    bool hits_period(interval x, double p, double period)
+    {
+        constexpr double slop = 1e-9;
+        return std::floor((x.hi - p) / period + slop) >= std::ceil((x.lo - p) / period - slop);
+    }
+
+    //sin and cos with the peaks and troughs inside x, peak is where the function is 1
+    interval periodic(double(*f)(double), interval x, double peak)
+    {
+        if (x.empty())
+        {
+            return empty_interval();
+        }
+        constexpr double tau = 2 * std::numbers::pi;
+        //far out the phase is lost in rounding
+        if (!(x.hi - x.lo < tau) || std::abs(x.lo) > 1e6 || std::abs(x.hi) > 1e6)
+        {
+            return { -1.0, 1.0, x.continuous && std::isfinite(x.lo) && std::isfinite(x.hi) };
+        }
+        interval res = widen({ std::min(f(x.lo), f(x.hi)), std::max(f(x.lo), f(x.hi)), x.continuous }, 2);
+        if (hits_period(x, peak, tau)) res.hi = 1.0;
+        if (hits_period(x, peak + std::numbers::pi, tau)) res.lo = -1.0;
+        res.lo = std::max(res.lo, -1.0);
+        res.hi = std::min(res.hi, 1.0);
+        return res;
+    }
+
+    //gamma falls to its minimum at gamma_min_x and rises after it, between the poles
+    //at 0, -1, -2, ... it has one extremum per unit where digamma is 0
+    constexpr double gamma_min_x = 1.4616321449683623;
+
+    //root of digamma between the poles n and n + 1 for n < 0, digamma rises from -inf to inf there
+    double find_digamma_root(double n)
+    {
+        double lo = n;
+        double hi = n + 1.0;
+        for (int i = 0; i < 64 && std::nextafter(lo, hi) < hi; i++)
+        {
+            const double mid = (lo + hi) / 2.0;
+            (digamma(mid) < 0.0 ? lo : hi) = mid;
+        }
+        return lo;
+    }
+
+    //the bisection takes about 60 digamma calls, so the cells closest to 0 are found once
+    double digamma_root(double n)
+    {
+        static const auto roots = []
+        {
+            std::array<double, 64> res{};
+            for (size_t i = 0; i < res.size(); i++) res[i] = find_digamma_root(-1.0 - i);
+            return res;
+        }();
+        const double i = -1.0 - n;
+        return i < roots.size() ? roots[static_cast<size_t>(i)] : find_digamma_root(n);
+    }
+
+    //tgamma and lgamma, entire across a pole, the ends and the extremum inside x otherwise
+    //both are only accurate to a few ulps, so the result is widened by a relative margin
+    interval gamma_interval(double(*f)(double), interval x)
+    {
+        if (x.empty())
+        {
+            return empty_interval();
+        }
+        double extremum;
+        if (x.lo > 0.0)
+        {
+            extremum = gamma_min_x;
+        }
+        else if (std::ceil(x.lo) <= std::min(std::floor(x.hi), 0.0))
+        {
+            return entire_interval();
+        }
+        else
+        {
+            extremum = digamma_root(std::floor(x.lo));
+        }
+        double lo = std::min(f(x.lo), f(x.hi));
+        double hi = std::max(f(x.lo), f(x.hi));
+        if (x.lo < extremum && extremum < x.hi)
+        {
+            lo = std::min(lo, f(extremum));
+            hi = std::max(hi, f(extremum));
+        }
+        constexpr double margin = 1e-13;
+        return widen({ lo - std::abs(lo) * margin, hi + std::abs(hi) * margin, x.continuous }, 1);
+    }
+
+    //steps of floor, ceil and trunc, continuous only if x doesn't cross one
+    interval step_interval(double(*f)(double), interval x)
+    {
+        if (x.empty())
+        {
+            return empty_interval();
+        }
+        return { f(x.lo), f(x.hi), x.continuous && f(x.lo) == f(x.hi) };
+    }
+
+    //range of every unary_func_tbl entry over an interval, used by interval evaluation
+    static std::unordered_map<std::string_view, interval(*)(interval)> unary_interval_tbl{
+        {"sin", [](interval x) { return periodic(std::sin, x, std::numbers::pi / 2); }},
+        {"cos", [](interval x) { return periodic(std::cos, x, 0.0); }},
+        {"sqrt", [](interval x) { return monotonic(std::sqrt, x, 0.0); }},
+        {"abs", [](interval x)
+        {
+            if (x.empty()) return empty_interval();
+            if (x.lo >= 0.0) return x;
+            if (x.hi <= 0.0) return interval{ -x.hi, -x.lo, x.continuous };
+            return interval{ 0.0, std::max(-x.lo, x.hi), x.continuous };
+        }},
+        {"tan", [](interval x)
+        {
+            if (x.empty()) return empty_interval();
+            //poles at pi/2 + k pi
+            if (!(x.hi - x.lo < std::numbers::pi) || hits_period(x, std::numbers::pi / 2, std::numbers::pi)) return entire_interval();
+            return monotonic(std::tan, x);
+        }},
+        {"acos", [](interval x) { return monotonic<false>(std::acos, x, -1.0, 1.0); }},
+        {"asin", [](interval x) { return monotonic(std::asin, x, -1.0, 1.0); }},
+        {"atan", [](interval x) { return monotonic(std::atan, x); }},
+        {"log", [](interval x) { return monotonic(std::log, x, 0.0); }},
+        {"log10", [](interval x) { return monotonic(std::log10, x, 0.0); }},
+        {"cosh", [](interval x)
+        {
+            if (x.empty()) return empty_interval();
+            const double lo = x.lo > 0.0 ? x.lo : x.hi < 0.0 ? -x.hi : 0.0;
+            return monotonic(std::cosh, { lo, std::max(std::abs(x.lo), std::abs(x.hi)), x.continuous });
+        }},
+        {"sinh", [](interval x) { return monotonic(std::sinh, x); }},
+        {"tanh", [](interval x) { return monotonic(std::tanh, x); }},
+        {"exp", [](interval x) { return monotonic(std::exp, x); }},
+        {"cbrt", [](interval x) { return monotonic(std::cbrt, x); }},
+        {"tgamma", [](interval x) { return gamma_interval(std::tgamma, x); }},
+        {"lgamma", [](interval x) { return gamma_interval(std::lgamma, x); }},
+        {"ceil", [](interval x) { return step_interval(std::ceil, x); }},
+        {"floor", [](interval x) { return step_interval(std::floor, x); }},
+        {"acosh", [](interval x) { return monotonic(std::acosh, x, 1.0); }},
+        {"asinh", [](interval x) { return monotonic(std::asinh, x); }},
+        {"trunc", [](interval x) { return step_interval(std::trunc, x); }},
+        {"atanh", [](interval x) { return monotonic(std::atanh, x, -1.0, 1.0); }} };
+
+    //everything about one function of unary_func_tbl, functions are interned
+    //as their index in get_functions(), so the parser passes ids around instead of names
+    struct function_info
+    {
+        std::string_view name;
+        double(*func)(double);
+        simd::unary_fn batch_func; //nullptr means call func on every element
+        double(*deriv)(double);
+        interval(*range)(interval);
+    };
+
+    //sorted by name, so the ids are the same in every run
+    const std::vector<function_info>& get_functions()
+    {
+        static const auto functions = []
+        {
+            std::vector<function_info> res;
+            for (const auto& [name, func] : unary_func_tbl)
+            {
+                res.push_back({ name, func, simd::get_unary_kernel(name), unary_deriv_tbl[name], unary_interval_tbl[name] });
+            }
+            std::ranges::sort(res, {}, &function_info::name);
+            return res;
+        }();
+        return functions;
+    }
+
+    constexpr bool is_left_assoc(std::string_view str)
+    {
+        return get_assoc_prec(str).second == assoc::LEFT;
+    }
+
+    constexpr bool is_binary_op(std::string_view str)
+    {
+        return (str == "/" || str == "*" || str == "+" || str == "-" || str == "^");
+    }
+
+    //prefix tree over the names of get_functions(), used by the lexer
+    //so function lookup never hashes or builds a string
+    class func_trie
+    {
+    public:
+        explicit func_trie(std::span<const function_info> functions)
+        {
+            nodes.emplace_back();
+            for (size_t id = 0; id < functions.size(); id++)
+            {
+                int cur = 0;
+                for (const char c : functions[id].name)
+                {
+                    const int idx = get_index(c);
+                    if (!nodes[cur].child[idx])
+                    {
+                        nodes[cur].child[idx] = static_cast<int>(nodes.size());
+                        nodes.emplace_back();
+                    }
+                    cur = nodes[cur].child[idx];
+                }
+                nodes[cur].id = static_cast<int>(id);
+            }
+        }
+
+        //returns the id of the function, -1 if str is not a function name
+        int find(std::string_view str) const
+        {
+            int cur = 0;
+            for (const char c : str)
+            {
+                const int idx = get_index(c);
+                if (idx < 0 || !nodes[cur].child[idx])
+                {
+                    return -1;
+                }
+                cur = nodes[cur].child[idx];
+            }
+            return nodes[cur].id;
+        }
+
+        //length of the longest function name str starts with, 0 if there is none
+        size_t longest_prefix(std::string_view str) const
+        {
+            size_t res = 0;
+            int cur = 0;
+            for (size_t i = 0; i < str.size(); i++)
+            {
+                const int idx = get_index(str[i]);
+                if (idx < 0 || !nodes[cur].child[idx])
+                {
+                    break;
+                }
+                cur = nodes[cur].child[idx];
+                res = nodes[cur].id >= 0 ? i + 1 : res;
+            }
+            return res;
+        }
+
+    private:
+        //function names only use lower case letters and digits
+        static constexpr int alphabet_size = 26 + 10;
+
+        struct node
+        {
+            int child[alphabet_size] = {};
+            int id = -1;
+        };
+
+        std::vector<node> nodes;
+
+        static int get_index(char c)
+        {
+            if (c >= 'a' && c <= 'z') return c - 'a';
+            else if (c >= '0' && c <= '9') return 26 + (c - '0');
+            else return -1;
+        }
+    };
+
+    const func_trie& get_func_trie()
+    {
+        static const func_trie trie(get_functions());
+        return trie;
+    }
+
+    //id of the named function, -1 if there is none
+    int find_function(std::string_view name)
+    {
+        return get_func_trie().find(name);
+    }
+
+    bool is_func(std::string_view str)
+    {
+        return find_function(str) >= 0;
+    }
+
+    class parse_error : public std::runtime_error 
+    {
+        public:
+            explicit parse_error(const std::string& what) : std::runtime_error(what) {}
+            explicit parse_error(const char* what) : std::runtime_error(what) {}
+    };
+
+    int get_prec(std::string_view str)
+    {
+        if (is_func(str)) { return 1; } //TODO: check it this is the correct value
+        else if (is_binary_op(str)) { return get_assoc_prec(str).first; }
+        else { return 0; }
+    }
+
+    enum class token_kind
+    {
+        NUMBER,
+        IDENTIFIER,
+        OPERATOR,
+        LEFT_PAREN,
+        RIGHT_PAREN
+    };
+
+    //text points into the string passed to tokenize, nothing is copied
+    struct token
+    {
+        token_kind kind;
+        std::string_view text;
+        size_t offset; //position of text in the source string
+    };
+
+    constexpr bool is_digit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    //ascii letters, what isalpha gives in the "C" locale, spelled out so static_expr can lex at compile time
+    constexpr bool is_ident_start(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+    }
+
+    constexpr bool is_ident_char(char c)
+    {
+        return is_ident_start(c) || is_digit(c);
+    }
+
+    //single pass lexer, numbers are [0-9]+ optionally followed by .[0-9]+
+    //identifiers are read whole, so classifying them is left to s_yard, except that a function
+    //name glued to a name after it is split off like the regex lexer did, sinx is sin x
+    //a run that is one of var_names, a function or a constant is never split
+    std::pmr::vector<token> tokenize(std::string_view str, std::span<const std::string_view> var_names = {},
+                                     std::pmr::memory_resource* mem = std::pmr::get_default_resource())
+    {
+        PROFILE_SCOPE("tokenize");
+        std::pmr::vector<token> res(mem);
+        int paren_depth = 0;
+        size_t i = 0;
+        while (i < str.size())
+        {
+            const char c = str[i];
+            const size_t start = i;
+            if (c == ' ' || c == '\t')
+            {
+                ++i;
+                continue;
+            }
+            else if (is_digit(c))
+            {
+                while (i < str.size() && is_digit(str[i])) ++i;
+                if (i + 1 < str.size() && str[i] == '.' && is_digit(str[i + 1]))
+                {
+                    ++i;
+                    while (i < str.size() && is_digit(str[i])) ++i;
+                }
+                res.push_back({ token_kind::NUMBER, str.substr(start, i - start), start });
+            }
+            else if (is_ident_start(c))
+            {
+                while (i < str.size() && is_ident_char(str[i])) ++i;
+                size_t begin = start;
+                for (std::string_view run = str.substr(start, i - start);
+                     !is_func(run) && run != "pi" && run != "e" && std::ranges::find(var_names, run) == var_names.end();)
+                {
+                    const size_t len = get_func_trie().longest_prefix(run);
+                    if (len == 0 || !is_ident_start(run[len]))
+                    {
+                        break;
+                    }
+                    res.push_back({ token_kind::IDENTIFIER, run.substr(0, len), begin });
+                    begin += len;
+                    run.remove_prefix(len);
+                }
+                res.push_back({ token_kind::IDENTIFIER, str.substr(begin, i - begin), begin });
+            }
+            else if (is_binary_op(str.substr(i, 1)))
+            {
+                res.push_back({ token_kind::OPERATOR, str.substr(i++, 1), start });
+            }
+            else if (c == '(')
+            {
+                ++paren_depth;
+                res.push_back({ token_kind::LEFT_PAREN, str.substr(i++, 1), start });
+            }
+            else if (c == ')')
+            {
+                --paren_depth;
+                res.push_back({ token_kind::RIGHT_PAREN, str.substr(i++, 1), start });
+            }
+            else
+            {
+                throw parse_error("unknown token in input at: " + std::to_string(start));
+            }
+        }
+        if (paren_depth != 0)
+        {
+            throw parse_error("parenthesis issue");
+        }
+        return res;
+    }
+
+    //what an entry of the rpn is
+    enum class rpn_kind : uint8_t
+    {
+        NUMBER,
+        VAR, //id is the slot of the variable
+        OP, //id is the operator character, a "-" may still turn out to be unary minus
+        FUNC //id is the index of the function in get_functions()
+    };
+
+    //one entry of the rpn built by to_rpn, symbols are interned instead of kept as strings
+    struct rpn_token
+    {
+        rpn_kind kind;
+        uint16_t id = 0;
+        double value = 0.0;
+    };
+
+    //most variables an expression can be compiled with
+    constexpr size_t max_vars = 256;
+
+    //params: 
+    //str - string to be converted
+    //var_names - any occurances of these as a seperate token will be treated as varables
+    //mem - where the tokens, the operator stack and the result are allocated
+    //convert string in infix notation to a string in Reverse Polish Notation
+    //using dijkstra's shunting yard algorithm 
+    std::pmr::vector<rpn_token> to_rpn(std::string_view str, std::span<const std::string_view> var_names,
+                                       std::pmr::memory_resource* mem = std::pmr::get_default_resource())
+    {
+        PROFILE_SCOPE("s_yard");
+        if (var_names.size() > max_vars)
+        {
+            throw parse_error("too many variables");
+        }
+        std::pmr::vector<rpn_token> output_queue(mem);
+        std::pmr::vector<token> op_stack(mem);
+        const auto pop_op = [&]
+        {
+            const token& top = op_stack.back();
+            if (top.kind == token_kind::OPERATOR)
+            {
+                output_queue.push_back({ rpn_kind::OP, static_cast<uint16_t>(top.text[0]) });
+            }
+            else
+            {
+                output_queue.push_back({ rpn_kind::FUNC, static_cast<uint16_t>(find_function(top.text)) });
+            }
+            op_stack.pop_back();
+        };
+
+        //tokenize function should handle all bad tokens
+        for (const auto& tok : tokenize(str, var_names, mem)) 
+        {
+            if (tok.kind == token_kind::NUMBER)
+            {
+                double value = 0.0;
+                std::from_chars(tok.text.data(), tok.text.data() + tok.text.size(), value);
+                output_queue.push_back({ rpn_kind::NUMBER, 0, value });
+            }
+            else if (tok.kind == token_kind::IDENTIFIER)
+            {
+                if (const auto var = std::ranges::find(var_names, tok.text); var != var_names.end())
+                {
+                    output_queue.push_back({ rpn_kind::VAR, static_cast<uint16_t>(var - var_names.begin()) });
+                }
+                else if (tok.text == "pi")
+                {
+                    output_queue.push_back({ rpn_kind::NUMBER, 0, std::numbers::pi });
+                }
+                else if (tok.text == "e")
+                {
+                    output_queue.push_back({ rpn_kind::NUMBER, 0, std::numbers::e_v<double> });
+                }
+                else if (is_func(tok.text))
+                {
+                    op_stack.push_back(tok);
+                }
+                else
+                {
+                    throw parse_error("unknown token: " + std::string(tok.text));
+                }
+            }
+            else if (tok.kind == token_kind::OPERATOR)
+            {
+                //pop operators that bind at least as tightly, one at a time
+                while (!op_stack.empty() && op_stack.back().kind == token_kind::OPERATOR &&
+                      (get_prec(op_stack.back().text) > get_prec(tok.text) ||
+                      (get_prec(op_stack.back().text) == get_prec(tok.text) && is_left_assoc(tok.text))))
+                {
+                    pop_op();
+                }
+                op_stack.push_back(tok);
+            }
+            else if (tok.kind == token_kind::LEFT_PAREN)
+            {
+                op_stack.push_back(tok);
+            }
+            else
+            {
+                while (!op_stack.empty() && op_stack.back().kind != token_kind::LEFT_PAREN)
+                {
+                    pop_op();
+                }
+                if (op_stack.empty())
+                {
+                    throw parse_error("mismatched parentheses");
+                }
+                op_stack.pop_back();
+                if (!op_stack.empty() && op_stack.back().kind == token_kind::IDENTIFIER)
+                {
+                    pop_op();
+                }
+            }
+        }
+        //all tokens read
+        while (!op_stack.empty())
+        {
+            //there are mismatched parentheses
+            if (op_stack.back().kind == token_kind::LEFT_PAREN)
+            {
+                throw parse_error("mismatched parentheses");
+            }
+            pop_op();
+        }
+        return output_queue;
+    }
+
+    //to_rpn with every symbol spelled out again, the form build_func and older callers take
+    std::vector<std::variant<double, std::string>> s_yard(std::string_view str, std::span<const std::string_view> var_names)
+    {
+        std::vector<std::variant<double, std::string>> res;
+        for (const auto& tok : to_rpn(str, var_names))
+        {
+            switch (tok.kind)
+            {
+            case rpn_kind::NUMBER: res.push_back(tok.value); break;
+            case rpn_kind::VAR: res.push_back(std::string(var_names[tok.id])); break;
+            case rpn_kind::OP: res.push_back(std::string(1, static_cast<char>(tok.id))); break;
+            case rpn_kind::FUNC: res.push_back(std::string(get_functions()[tok.id].name)); break;
+            }
+        }
+        return res;
+    }
+
+    std::vector<std::variant<double, std::string>> s_yard(std::string_view str, std::string_view var_name)
+    {
+        return s_yard(str, std::span(&var_name, 1));
+    }
+    
+    double compute_binary_ops(double d1, double d2, std::string_view op)
+    {
+        if (op == "*") return d1 * d2;
+        else if (op == "+") return d1 + d2;
+        else if (op == "-") return d1 - d2;
+        else if (op == "/") return d1 / d2;
+        else if (op == "^") return std::pow(d1, d2);
+    }
+
+    enum class op_code : uint8_t
+    {
+        PUSH_CONST,
+        PUSH_VAR,
+        ADD,
+        SUB,
+        MUL,
+        DIV,
+        POW,
+        NEG,
+        CALL,
+        STORE, //copies the top of the stack to a temporary, it stays on the stack
+        LOAD //pushes a temporary
+    };
+
+    //one slot of the flat program built by compile()
+    //var is only used by PUSH_VAR, STORE and LOAD, value only by PUSH_CONST, func, batch_func, deriv and range only by CALL
+    struct instruction
+    {
+        op_code op;
+        uint16_t var = 0; //index of the variable in the names passed to compile, or of the temporary
+        double value = 0;
+        double(*func)(double) = nullptr;
+        simd::unary_fn batch_func = nullptr; //nullptr means call func on every element
+        double(*deriv)(double) = nullptr; //derivative of func, nullptr if it has none
+        interval(*range)(interval) = nullptr; //range of func over an interval, nullptr if it has none
+    };
+
+    //value and derivative of an expression at one point
+    struct dual
+    {
+        double value;
+        double deriv;
+    };
+
+    //a^b with its derivative, the terms of a constant base or exponent are left
+    //out so that x^2 at x < 0 and 0^x stay finite
+    dual pow_dual(dual a, dual b)
+    {
+        const double value = std::pow(a.value, b.value);
+        double deriv = 0.0;
+        if (a.deriv != 0.0)
+        {
+            deriv += b.value * std::pow(a.value, b.value - 1.0) * a.deriv;
+        }
+        if (b.deriv != 0.0)
+        {
+            deriv += value * std::log(a.value) * b.deriv;
+        }
+        return { value, deriv };
+    }
+
+    double call_deriv(const instruction& ins, double x)
+    {
+        return ins.deriv ? ins.deriv(x) : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    //interval versions of the binary op_codes, every result encloses all values
+    //the op can take for operands in a and b
+    interval add_interval(interval a, interval b)
+    {
+        return widen({ a.lo + b.lo, a.hi + b.hi, a.continuous && b.continuous });
+    }
+
+    interval sub_interval(interval a, interval b)
+    {
+        return widen({ a.lo - b.hi, a.hi - b.lo, a.continuous && b.continuous });
+    }
+
+    interval mul_interval(interval a, interval b)
+    {
+        if (a.empty() || b.empty())
+        {
+            return empty_interval();
+        }
+        //0 * inf is 0 here, an end at infinity only stands for large finite values
+        const auto mul = [](double x, double y) { return x == 0.0 || y == 0.0 ? 0.0 : x * y; };
+        const double p[] = { mul(a.lo, b.lo), mul(a.lo, b.hi), mul(a.hi, b.lo), mul(a.hi, b.hi) };
+        return widen({ *std::min_element(p, p + 4), *std::max_element(p, p + 4), a.continuous && b.continuous });
+    }
+
+    interval div_interval(interval a, interval b)
+    {
+        if (a.empty() || b.empty() || (b.lo == 0.0 && b.hi == 0.0))
+        {
+            return empty_interval();
+        }
+        if (b.lo <= 0.0 && b.hi >= 0.0)
+        {
+            return entire_interval();
+        }
+        return mul_interval(a, widen({ 1.0 / b.hi, 1.0 / b.lo, b.continuous }));
+    }
+
+    interval pow_interval(interval a, interval b)
+    {
+        if (a.empty() || b.empty())
+        {
+            return empty_interval();
+        }
+        const bool continuous = a.continuous && b.continuous;
+        if (b.lo == b.hi && std::trunc(b.lo) == b.lo)
+        {
+            const double n = b.lo;
+            if (n == 0.0)
+            {
+                return { 1.0, 1.0, continuous };
+            }
+            if (n < 0.0)
+            {
+                return div_interval({ 1.0, 1.0 }, pow_interval(a, { -n, -n, b.continuous }));
+            }
+            const auto pow_n = [n](double x) { return std::pow(x, n); };
+            if (std::fmod(n, 2.0) != 0.0 || a.lo >= 0.0)
+            {
+                return widen({ pow_n(a.lo), pow_n(a.hi), continuous }, 2);
+            }
+            //even powers fall to the left of 0 and rise to the right
+            const double far = pow_n(std::max(-a.lo, a.hi));
+            const double near = a.hi < 0.0 ? pow_n(a.hi) : 0.0;
+            return widen({ near, far, continuous }, 2);
+        }
+        //other exponents are only defined for a >= 0, where the result is exp(b log a)
+        if (a.hi < 0.0)
+        {
+            return empty_interval();
+        }
+        if (a.lo < 0.0 && b.lo < b.hi)
+        {
+            //the integers in b still reach a < 0
+            return entire_interval();
+        }
+        const interval base{ std::max(a.lo, 0.0), a.hi, continuous && a.lo >= 0.0 };
+        if (b.lo == b.hi)
+        {
+            const double e = b.lo;
+            const double lo = std::pow(e > 0.0 ? base.lo : base.hi, e);
+            const double hi = std::pow(e > 0.0 ? base.hi : base.lo, e);
+            return widen({ lo, hi, base.continuous }, 2);
+        }
+        return unary_interval_tbl["exp"](mul_interval(b, unary_interval_tbl["log"](base)));
+    }
+
+    //deepest value stack a compiled expression may need,
+    //compile() rejects anything deeper so eval never checks bounds
+    constexpr int max_stack_depth = 64;
+
+    //deepest expression tree build_tree accepts, the passes over the tree recurse once per level
+    //so this keeps them off the end of the thread's stack, a long sum like x+x+...+x
+    //is this deep even though it needs only 2 stack slots
+    constexpr int max_tree_depth = 1000;
+
+    //temporaries a compiled expression may keep shared values in,
+    //once they are all taken emit() computes a shared subtree again instead
+    constexpr int max_temps = 32;
+
+    //number of inputs evaluate() pushes through each instruction at once
+    constexpr size_t batch_size = 256;
+
+    bool is_binary_op_code(op_code op)
+    {
+        return op == op_code::ADD || op == op_code::SUB || op == op_code::MUL || op == op_code::DIV || op == op_code::POW;
+    }
+
+    //ADD..DIV are laid out in the same order as simd::binary_kernel
+    int get_binary_kernel(op_code op)
+    {
+        return static_cast<int>(op) - static_cast<int>(op_code::ADD);
+    }
+
+    //flat bytecode form of an rpn expression, evaluated by a stack machine
+    //callable the same way as the std::function returned by build_func
+    //variables are bound to slots when compiling, so every evaluation takes
+    //the values in the order the names were passed to compile
+    struct compiled_func
+    {
+        std::vector<instruction> code;
+        int stack_depth = 0;
+        int num_temps = 0; //temporaries STORE and LOAD use
+        int num_vars = 1;
+        simd::accuracy math = simd::accuracy::EXACT; //set by approximate()
+        double(*power)(double, double) = std::pow; //what POW evaluates, scalar and in batches
+        simd::binary_fn batch_power = nullptr; //nullptr means call power on every element
+        std::shared_ptr<const jit::jit_func> native; //set by jit::compile, used instead of the interpreter
+
+        //only for functions of one variable
+        double operator()(double var_value) const
+        {
+            if (native)
+            {
+                return native->scalar()(var_value);
+            }
+            return (*this)(std::span(&var_value, 1));
+        }
+
+        //vars holds one value per slot
+        double operator()(std::span<const double> vars) const
+        {
+            double stack[max_stack_depth];
+            double temps[max_temps];
+            int sp = 0;
+            for (const auto& ins : code)
+            {
+                switch (ins.op)
+                {
+                case op_code::PUSH_CONST: stack[sp++] = ins.value; break;
+                case op_code::PUSH_VAR: stack[sp++] = vars[ins.var]; break;
+                case op_code::ADD: --sp; stack[sp - 1] += stack[sp]; break;
+                case op_code::SUB: --sp; stack[sp - 1] -= stack[sp]; break;
+                case op_code::MUL: --sp; stack[sp - 1] *= stack[sp]; break;
+                case op_code::DIV: --sp; stack[sp - 1] /= stack[sp]; break;
+                case op_code::POW: --sp; stack[sp - 1] = power(stack[sp - 1], stack[sp]); break;
+                case op_code::NEG: stack[sp - 1] = -stack[sp - 1]; break;
+                case op_code::CALL: stack[sp - 1] = ins.func(stack[sp - 1]); break;
+                case op_code::STORE: temps[ins.var] = stack[sp - 1]; break;
+                case op_code::LOAD: stack[sp++] = temps[ins.var]; break;
+                }
+            }
+            return stack[0];
+        }
+
+        //evaluates every element of xs into out (which must be at least as long)
+        //only for functions of one variable
+        //each instruction runs over a whole block of inputs before moving
+        //on, so the dispatch cost is paid per block instead of per sample
+        void evaluate(std::span<const double> xs, std::span<double> out) const
+        {
+            if (native)
+            {
+                native->batch()(xs.data(), out.data(), xs.size());
+                return;
+            }
+            const double* columns[] = { xs.data() };
+            evaluate(columns, xs.size(), out);
+        }
+
+        //struct of arrays batch, columns[i] holds n values of the variable in slot i
+        //and out receives n results
+        void evaluate(std::span<const double* const> columns, size_t n_total, std::span<double> out) const
+        {
+            const auto& kernels = simd::kernels();
+            //one row of batch_size values per stack slot, then one per temporary
+            std::vector<double> stack(static_cast<size_t>(stack_depth + num_temps) * batch_size);
+            double* const temps = stack.data() + static_cast<size_t>(stack_depth) * batch_size;
+
+            for (size_t start = 0; start < n_total; start += batch_size)
+            {
+                const size_t n = std::min(batch_size, n_total - start);
+                int sp = 0;
+                for (size_t i = 0; i < code.size(); i++)
+                {
+                    const auto& ins = code[i];
+                    //first free row, the current top of the stack is the row before it
+                    double* next = stack.data() + sp * batch_size;
+                    //a push directly followed by a binary op is applied straight
+                    //to the top row instead of being copied into its own row first
+                    const bool fuse = i + 1 < code.size() && is_binary_op_code(code[i + 1].op) && code[i + 1].op != op_code::POW;
+                    switch (ins.op)
+                    {
+                    case op_code::PUSH_CONST:
+                        if (fuse)
+                        {
+                            kernels.binary_scalar[get_binary_kernel(code[i + 1].op)](next - batch_size, ins.value, n);
+                            ++i;
+                        }
+                        else
+                        {
+                            std::fill_n(next, n, ins.value);
+                            ++sp;
+                        }
+                        break;
+                    case op_code::PUSH_VAR:
+                    case op_code::LOAD:
+                    {
+                        const double* x = ins.op == op_code::LOAD ? temps + ins.var * batch_size : columns[ins.var] + start;
+                        if (fuse)
+                        {
+                            kernels.binary[get_binary_kernel(code[i + 1].op)](next - batch_size, x, n);
+                            ++i;
+                        }
+                        else
+                        {
+                            std::memcpy(next, x, n * sizeof(double));
+                            ++sp;
+                        }
+                        break;
+                    }
+                    case op_code::ADD:
+                    case op_code::SUB:
+                    case op_code::MUL:
+                    case op_code::DIV:
+                        kernels.binary[get_binary_kernel(ins.op)](next - 2 * batch_size, next - batch_size, n);
+                        --sp;
+                        break;
+                    case op_code::POW:
+                        if (batch_power)
+                        {
+                            batch_power(next - 2 * batch_size, next - batch_size, n);
+                        }
+                        else
+                        {
+                            for (size_t j = 0; j < n; j++)
+                            {
+                                next[j - 2 * batch_size] = power(next[j - 2 * batch_size], next[j - batch_size]);
+                            }
+                        }
+                        --sp;
+                        break;
+                    case op_code::NEG:
+                        kernels.unary[static_cast<int>(simd::unary_kernel::NEG)](next - batch_size, n);
+                        break;
+                    case op_code::CALL:
+                        if (ins.batch_func)
+                        {
+                            ins.batch_func(next - batch_size, n);
+                        }
+                        else
+                        {
+                            double* top = next - batch_size;
+                            for (size_t j = 0; j < n; j++) top[j] = ins.func(top[j]);
+                        }
+                        break;
+                    case op_code::STORE:
+                        std::memcpy(temps + ins.var * batch_size, next - batch_size, n * sizeof(double));
+                        break;
+                    }
+                }
+                std::memcpy(out.data() + start, stack.data(), n * sizeof(double));
+            }
+        }
+
+        //value and derivative with respect to the variable in slot wrt in one pass,
+        //forward mode, every stack slot carries a dual number
+        dual evaluate_dual(std::span<const double> vars, int wrt = 0) const
+        {
+            dual stack[max_stack_depth];
+            dual temps[max_temps];
+            int sp = 0;
+            for (const auto& ins : code)
+            {
+                if (ins.op == op_code::PUSH_CONST)
+                {
+                    stack[sp++] = { ins.value, 0.0 };
+                    continue;
+                }
+                if (ins.op == op_code::LOAD)
+                {
+                    stack[sp++] = temps[ins.var];
+                    continue;
+                }
+                if (ins.op == op_code::PUSH_VAR)
+                {
+                    stack[sp++] = { vars[ins.var], ins.var == wrt ? 1.0 : 0.0 };
+                    continue;
+                }
+                dual b{};
+                if (is_binary_op_code(ins.op))
+                {
+                    b = stack[--sp];
+                }
+                dual& a = stack[sp - 1];
+                switch (ins.op)
+                {
+                case op_code::ADD: a = { a.value + b.value, a.deriv + b.deriv }; break;
+                case op_code::SUB: a = { a.value - b.value, a.deriv - b.deriv }; break;
+                case op_code::MUL: a = { a.value * b.value, a.deriv * b.value + a.value * b.deriv }; break;
+                case op_code::DIV:
+                {
+                    const double q = a.value / b.value;
+                    a = { q, (a.deriv - q * b.deriv) / b.value };
+                    break;
+                }
+                case op_code::POW: a = pow_dual(a, b); break;
+                case op_code::NEG: a = { -a.value, -a.deriv }; break;
+                case op_code::CALL: a = { ins.func(a.value), call_deriv(ins, a.value) * a.deriv }; break;
+                case op_code::STORE: temps[ins.var] = a; break;
+                default: break;
+                }
+            }
+            return stack[0];
+        }
+
+        //only for functions of one variable
+        dual evaluate_dual(double var_value) const
+        {
+            return evaluate_dual(std::span(&var_value, 1));
+        }
+
+        //interval enclosing every value the expression takes while each variable
+        //ranges over its interval, an empty result means it is undefined throughout
+        //bounds are rounded outward, so no value is missed, but may be wider than the true range
+        interval evaluate_interval(std::span<const interval> vars) const
+        {
+            interval stack[max_stack_depth];
+            interval temps[max_temps];
+            int sp = 0;
+            for (const auto& ins : code)
+            {
+                switch (ins.op)
+                {
+                case op_code::PUSH_CONST: stack[sp++] = { ins.value, ins.value, !std::isnan(ins.value) }; break;
+                case op_code::PUSH_VAR: stack[sp++] = vars[ins.var]; break;
+                case op_code::ADD: --sp; stack[sp - 1] = add_interval(stack[sp - 1], stack[sp]); break;
+                case op_code::SUB: --sp; stack[sp - 1] = sub_interval(stack[sp - 1], stack[sp]); break;
+                case op_code::MUL: --sp; stack[sp - 1] = mul_interval(stack[sp - 1], stack[sp]); break;
+                case op_code::DIV: --sp; stack[sp - 1] = div_interval(stack[sp - 1], stack[sp]); break;
+                case op_code::POW: --sp; stack[sp - 1] = pow_interval(stack[sp - 1], stack[sp]); break;
+                case op_code::NEG: stack[sp - 1] = { -stack[sp - 1].hi, -stack[sp - 1].lo, stack[sp - 1].continuous }; break;
+                case op_code::CALL:
+                {
+                    interval& a = stack[sp - 1];
+                    if (a.empty())
+                    {
+                        a = empty_interval();
+                    }
+                    else if (a.lo == a.hi && std::isfinite(a.lo))
+                    {
+                        //a point stays a point, the call is only rounded outward
+                        a = widen({ ins.func(a.lo), ins.func(a.lo), a.continuous }, 2);
+                    }
+                    else
+                    {
+                        a = ins.range ? ins.range(a) : entire_interval();
+                    }
+                    break;
+                }
+                case op_code::STORE: temps[ins.var] = stack[sp - 1]; break;
+                case op_code::LOAD: stack[sp++] = temps[ins.var]; break;
+                }
+            }
+            return stack[0];
+        }
+
+        //only for functions of one variable
+        interval evaluate_interval(interval var_value) const
+        {
+            return evaluate_interval(std::span(&var_value, 1));
+        }
+
+        //batched evaluate_dual over a struct of arrays, like evaluate
+        //values and derivs receive n results each
+        void evaluate_dual(std::span<const double* const> columns, size_t n_total, int wrt,
+                           std::span<double> values, std::span<double> derivs) const
+        {
+            const auto& kernels = simd::kernels();
+            const auto kernel = [&](op_code op) { return kernels.binary[get_binary_kernel(op)]; };
+            //rows of batch_size values, the stack and then the temporaries,
+            //the derivatives of a row are stack_depth + num_temps rows further on
+            std::vector<double> stack(static_cast<size_t>(stack_depth + num_temps) * batch_size * 2);
+            const size_t deriv_offset = static_cast<size_t>(stack_depth + num_temps) * batch_size;
+            double* const temps = stack.data() + static_cast<size_t>(stack_depth) * batch_size;
+
+            for (size_t start = 0; start < n_total; start += batch_size)
+            {
+                const size_t n = std::min(batch_size, n_total - start);
+                int sp = 0;
+                for (const auto& ins : code)
+                {
+                    double* v = stack.data() + sp * batch_size; //first free row
+                    double* d = v + deriv_offset;
+                    double* av = v - 2 * batch_size; //lhs and rhs of a binary op
+                    double* ad = d - 2 * batch_size;
+                    double* bv = v - batch_size;
+                    double* bd = d - batch_size;
+                    switch (ins.op)
+                    {
+                    case op_code::PUSH_CONST:
+                        std::fill_n(v, n, ins.value);
+                        std::fill_n(d, n, 0.0);
+                        ++sp;
+                        break;
+                    case op_code::PUSH_VAR:
+                        std::memcpy(v, columns[ins.var] + start, n * sizeof(double));
+                        std::fill_n(d, n, ins.var == wrt ? 1.0 : 0.0);
+                        ++sp;
+                        break;
+                    //the rhs rows are free once the op is done, so they hold the product terms
+                    case op_code::ADD:
+                    case op_code::SUB:
+                        kernel(ins.op)(av, bv, n);
+                        kernel(ins.op)(ad, bd, n);
+                        --sp;
+                        break;
+                    case op_code::MUL:
+                        //a' b + a b'
+                        kernel(op_code::MUL)(ad, bv, n);
+                        kernel(op_code::MUL)(bd, av, n);
+                        kernel(op_code::ADD)(ad, bd, n);
+                        kernel(op_code::MUL)(av, bv, n);
+                        --sp;
+                        break;
+                    case op_code::DIV:
+                        //(a' - q b') / b with q = a / b
+                        kernel(op_code::DIV)(av, bv, n);
+                        kernel(op_code::MUL)(bd, av, n);
+                        kernel(op_code::SUB)(ad, bd, n);
+                        kernel(op_code::DIV)(ad, bv, n);
+                        --sp;
+                        break;
+                    case op_code::POW:
+                        for (size_t j = 0; j < n; j++)
+                        {
+                            const dual res = pow_dual({ av[j], ad[j] }, { bv[j], bd[j] });
+                            av[j] = res.value;
+                            ad[j] = res.deriv;
+                        }
+                        --sp;
+                        break;
+                    case op_code::NEG:
+                        kernels.unary[static_cast<int>(simd::unary_kernel::NEG)](bv, n);
+                        kernels.unary[static_cast<int>(simd::unary_kernel::NEG)](bd, n);
+                        break;
+                    case op_code::CALL:
+                        //the derivative needs the argument, so it goes first
+                        for (size_t j = 0; j < n; j++) bd[j] *= call_deriv(ins, bv[j]);
+                        if (ins.batch_func)
+                        {
+                            ins.batch_func(bv, n);
+                        }
+                        else
+                        {
+                            for (size_t j = 0; j < n; j++) bv[j] = ins.func(bv[j]);
+                        }
+                        break;
+                    case op_code::STORE:
+                        std::memcpy(temps + ins.var * batch_size, bv, n * sizeof(double));
+                        std::memcpy(temps + ins.var * batch_size + deriv_offset, bd, n * sizeof(double));
+                        break;
+                    case op_code::LOAD:
+                        std::memcpy(v, temps + ins.var * batch_size, n * sizeof(double));
+                        std::memcpy(d, temps + ins.var * batch_size + deriv_offset, n * sizeof(double));
+                        ++sp;
+                        break;
+                    }
+                }
+                std::memcpy(values.data() + start, stack.data(), n * sizeof(double));
+                std::memcpy(derivs.data() + start, stack.data() + deriv_offset, n * sizeof(double));
+            }
+        }
+
+        //only for functions of one variable
+        void evaluate_dual(std::span<const double> xs, std::span<double> values, std::span<double> derivs) const
+        {
+            const double* columns[] = { xs.data() };
+            evaluate_dual(columns, xs.size(), 0, values, derivs);
+        }
+    };
+
+    op_code get_binary_op_code(std::string_view op)
+    {
+        if (op == "*") return op_code::MUL;
+        else if (op == "+") return op_code::ADD;
+        else if (op == "-") return op_code::SUB;
+        else if (op == "/") return op_code::DIV;
+        else return op_code::POW;
+    }
+
+    //node of the expression tree the optimizer works on
+    //leaves are PUSH_CONST/PUSH_VAR, NEG and CALL only use lhs
+    struct expr_node
+    {
+        op_code op;
+        double value = 0.0;
+        double(*func)(double) = nullptr;
+        simd::unary_fn batch_func = nullptr;
+        int lhs = -1; //index into expr_tree::nodes
+        int rhs = -1;
+        uint16_t var = 0; //slot of a PUSH_VAR
+        double(*deriv)(double) = nullptr;
+        interval(*range)(interval) = nullptr;
+    };
+
+    //nodes come from the memory resource passed to the constructor, copies use the default one
+    struct expr_tree
+    {
+        std::pmr::vector<expr_node> nodes;
+        int root = -1;
+
+        expr_tree() = default;
+        explicit expr_tree(std::pmr::memory_resource* mem) : nodes(mem) {}
+
+        int add(const expr_node& node)
+        {
+            nodes.push_back(node);
+            return static_cast<int>(nodes.size()) - 1;
+        }
+
+        bool is_const(int idx) const
+        {
+            return nodes[idx].op == op_code::PUSH_CONST;
+        }
+
+        bool is_const(int idx, double value) const
+        {
+            return is_const(idx) && nodes[idx].value == value;
+        }
+
+        //number of nodes reachable from idx, a shared subtree counts once per use
+        int count(int idx) const
+        {
+            std::vector<int> sizes(nodes.size(), -1);
+            return count(idx, sizes);
+        }
+
+        int count(int idx, std::vector<int>& sizes) const
+        {
+            if (idx < 0) return 0;
+            if (sizes[idx] < 0) sizes[idx] = 1 + count(nodes[idx].lhs, sizes) + count(nodes[idx].rhs, sizes);
+            return sizes[idx];
+        }
+    };
+
+    //builds the tree for the rpn, in mem
+    //follows the same rules as build_func, a "-" with only one operand
+    //on the stack is treated as unary minus
+    expr_tree build_tree(std::span<const rpn_token> rpn, size_t num_vars, std::pmr::memory_resource* mem = std::pmr::get_default_resource())
+    {
+        if (num_vars > max_vars)
+        {
+            throw parse_error("too many variables");
+        }
+        expr_tree tree(mem);
+        std::pmr::vector<int> stack(mem);
+        std::pmr::vector<int> depths(mem); //depth of the subtree of each entry of stack
+        //a new node on top of the subtrees with the given depth
+        const auto deeper = [](int depth)
+        {
+            if (depth >= max_tree_depth)
+            {
+                throw parse_error("expression is nested too deeply");
+            }
+            return depth + 1;
+        };
+        for (const auto& tok : rpn)
+        {
+            if (tok.kind == rpn_kind::NUMBER)
+            {
+                stack.push_back(tree.add({ op_code::PUSH_CONST, tok.value }));
+                depths.push_back(1);
+            }
+            else if (tok.kind == rpn_kind::VAR)
+            {
+                expr_node node{ op_code::PUSH_VAR };
+                node.var = tok.id;
+                stack.push_back(tree.add(node));
+                depths.push_back(1);
+            }
+            else if (tok.kind == rpn_kind::OP)
+            {
+                const char op = static_cast<char>(tok.id);
+                if (stack.size() >= 2)
+                {
+                    const int rhs = stack.back();
+                    const int rhs_depth = depths.back();
+                    stack.pop_back();
+                    depths.pop_back();
+                    const int lhs = stack.back();
+                    depths.back() = deeper(std::max(depths.back(), rhs_depth));
+                    stack.back() = tree.add({ get_binary_op_code(std::string_view(&op, 1)), 0.0, nullptr, nullptr, lhs, rhs });
+                }
+                else if (stack.size() == 1 && op == '-')
+                {
+                    depths.back() = deeper(depths.back());
+                    stack.back() = tree.add({ op_code::NEG, 0.0, nullptr, nullptr, stack.back() });
+                }
+                else
+                {
+                    throw parse_error("missing operand for: " + std::string(1, op));
+                }
+            }
+            else
+            {
+                const function_info& func = get_functions()[tok.id];
+                if (stack.empty())
+                {
+                    throw parse_error("missing argument for: " + std::string(func.name));
+                }
+                expr_node node{ op_code::CALL, 0.0, func.func, func.batch_func, stack.back() };
+                node.deriv = func.deriv;
+                node.range = func.range;
+                depths.back() = deeper(depths.back());
+                stack.back() = tree.add(node);
+            }
+        }
+        if (stack.size() != 1)
+        {
+            throw parse_error(stack.empty() ? "empty expression" : "missing operator");
+        }
+        tree.root = stack.back();
+        return tree;
+    }
+
+    //builds the tree for the rpn vec
+    //each variable is bound to its index in var_names
+    expr_tree build_tree(const std::vector<std::variant<double, std::string>>& tokens, std::span<const std::string_view> var_names)
+    {
+        if (var_names.size() > max_vars)
+        {
+            throw parse_error("too many variables");
+        }
+        std::vector<rpn_token> rpn;
+        for (const auto& tok : tokens)
+        {
+            if (const double* num_ptr = std::get_if<double>(&tok))
+            {
+                rpn.push_back({ rpn_kind::NUMBER, 0, *num_ptr });
+                continue;
+            }
+            const auto& str = std::get<std::string>(tok);
+            if (const auto var = std::ranges::find(var_names, str); var != var_names.end())
+            {
+                rpn.push_back({ rpn_kind::VAR, static_cast<uint16_t>(var - var_names.begin()) });
+            }
+            else if (is_binary_op(str))
+            {
+                rpn.push_back({ rpn_kind::OP, static_cast<uint16_t>(str[0]) });
+            }
+            else if (const int id = find_function(str); id >= 0)
+            {
+                rpn.push_back({ rpn_kind::FUNC, static_cast<uint16_t>(id) });
+            }
+            else
+            {
+                throw parse_error("unknown token: " + str);
+            }
+        }
+        return build_tree(rpn, var_names.size());
+    }
+
+    enum class opt_level
+    {
+        NONE,
+        FOLD, //fold constant subtrees, results are bit identical to NONE
+        FULL  //also apply algebraic identities, may change the last bits of a result
+    };
+
+    //node counts of the tree before and after optimize()
+    struct opt_stats
+    {
+        int nodes_before = 0;
+        int nodes_after = 0; //counting a shared subtree once per use
+        int nodes_unique = 0; //nodes left to evaluate once common subexpressions are shared
+    };
+
+    double apply_op(op_code op, double a, double b)
+    {
+        switch (op)
+        {
+        case op_code::ADD: return a + b;
+        case op_code::SUB: return a - b;
+        case op_code::MUL: return a * b;
+        case op_code::DIV: return a / b;
+        case op_code::POW: return std::pow(a, b);
+        default: return -a; //NEG
+        }
+    }
+
+    int optimize_node(const expr_tree& in, int idx, expr_tree& out, opt_level level, std::pmr::vector<int>& done);
+
+    //rewrites the node at idx into out, returns the index of the new subtree
+    int rewrite_node(const expr_tree& in, int idx, expr_tree& out, opt_level level, std::pmr::vector<int>& done)
+    {
+        expr_node node = in.nodes[idx];
+        if (node.lhs >= 0) node.lhs = optimize_node(in, node.lhs, out, level, done);
+        if (node.rhs >= 0) node.rhs = optimize_node(in, node.rhs, out, level, done);
+
+        //fold constant subtrees, this covers pi, e and calls like sqrt(2)
+        const bool lhs_const = node.lhs >= 0 && out.is_const(node.lhs);
+        const bool rhs_const = node.rhs < 0 || out.is_const(node.rhs);
+        if (lhs_const && rhs_const)
+        {
+            const double a = out.nodes[node.lhs].value;
+            const double value = node.op == op_code::CALL ? node.func(a) :
+                                 apply_op(node.op, a, node.rhs >= 0 ? out.nodes[node.rhs].value : 0.0);
+            return out.add({ op_code::PUSH_CONST, value });
+        }
+        if (level != opt_level::FULL)
+        {
+            return out.add(node);
+        }
+
+        //a / c -> a * (1 / c), multiplication is much cheaper than division
+        if (node.op == op_code::DIV && out.is_const(node.rhs) && out.nodes[node.rhs].value != 0.0 &&
+            std::isfinite(1.0 / out.nodes[node.rhs].value))
+        {
+            node.op = op_code::MUL;
+            node.rhs = out.add({ op_code::PUSH_CONST, 1.0 / out.nodes[node.rhs].value });
+        }
+        //keep constants on the right of + and * so the rules below only check one side
+        if ((node.op == op_code::ADD || node.op == op_code::MUL) && out.is_const(node.lhs))
+        {
+            std::swap(node.lhs, node.rhs);
+        }
+
+        const int lhs = node.lhs;
+        const int rhs = node.rhs;
+        switch (node.op)
+        {
+        case op_code::ADD:
+            if (out.is_const(rhs, 0.0)) return lhs;
+            //(a + c1) + c2 -> a + (c1 + c2)
+            if (out.is_const(rhs) && out.nodes[lhs].op == op_code::ADD && out.is_const(out.nodes[lhs].rhs))
+            {
+                node.lhs = out.nodes[lhs].lhs;
+                node.rhs = out.add({ op_code::PUSH_CONST, out.nodes[out.nodes[lhs].rhs].value + out.nodes[rhs].value });
+            }
+            break;
+        case op_code::SUB:
+            if (out.is_const(rhs, 0.0)) return lhs;
+            if (out.is_const(lhs, 0.0)) return out.add({ op_code::NEG, 0.0, nullptr, nullptr, rhs });
+            break;
+        case op_code::MUL:
+            if (out.is_const(rhs, 1.0)) return lhs;
+            //(a * c1) * c2 -> a * (c1 * c2)
+            if (out.is_const(rhs) && out.nodes[lhs].op == op_code::MUL && out.is_const(out.nodes[lhs].rhs))
+            {
+                node.lhs = out.nodes[lhs].lhs;
+                node.rhs = out.add({ op_code::PUSH_CONST, out.nodes[out.nodes[lhs].rhs].value * out.nodes[rhs].value });
+            }
+            break;
+        case op_code::DIV:
+            if (out.is_const(rhs, 1.0)) return lhs;
+            break;
+        case op_code::POW:
+            if (out.is_const(rhs, 0.0)) return out.add({ op_code::PUSH_CONST, 1.0 });
+            if (out.is_const(rhs, 1.0)) return lhs;
+            //the base is shared by both operands, so it is still only evaluated once
+            if (out.is_const(rhs, 2.0))
+            {
+                node.op = op_code::MUL;
+                node.rhs = lhs;
+            }
+            break;
+        case op_code::NEG:
+            if (out.nodes[lhs].op == op_code::NEG) return out.nodes[lhs].lhs;
+            break;
+        default:
+            break;
+        }
+        return out.add(node);
+    }
+
+    //rewrites the subtree at idx into out once, subtrees shared in the input
+    //(like the ones of a derivative) stay shared in the output
+    int optimize_node(const expr_tree& in, int idx, expr_tree& out, opt_level level, std::pmr::vector<int>& done)
+    {
+        if (done[idx] < 0)
+        {
+            done[idx] = rewrite_node(in, idx, out, level, done);
+        }
+        return done[idx];
+    }
+
+    //what makes two nodes compute the same value, given their operands are already shared
+    //constants compare by their bits, so 0.0 and -0.0 stay apart and equal nans merge
+    //a + b and b + a round the same, so the operands of + and * are kept in order
+    struct node_key
+    {
+        op_code op;
+        uint64_t value = 0;
+        double(*func)(double);
+        uint16_t var = 0;
+        int lhs;
+        int rhs;
+
+        explicit node_key(const expr_node& node) : op(node.op), func(node.func), lhs(node.lhs), rhs(node.rhs)
+        {
+            if (op == op_code::PUSH_CONST) value = std::bit_cast<uint64_t>(node.value);
+            if (op == op_code::PUSH_VAR) var = node.var;
+            if ((op == op_code::ADD || op == op_code::MUL) && lhs > rhs) std::swap(lhs, rhs);
+        }
+
+        bool operator==(const node_key&) const = default;
+
+        size_t hash() const
+        {
+            size_t h = std::hash<uint64_t>()(value);
+            const auto mix = [&h](size_t v) { h ^= v + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2); };
+            mix(static_cast<size_t>(op));
+            mix(std::hash<double(*)(double)>()(func));
+            mix(var);
+            mix(static_cast<size_t>(lhs));
+            mix(static_cast<size_t>(rhs));
+            return h;
+        }
+    };
+
+    //copies the subtree at idx into out, reusing the node out already has for the same value
+    //seen is an open addressed table of indices into out, -1 marks a free entry
+    int share_node(const expr_tree& in, int idx, expr_tree& out, std::pmr::vector<int>& copied, std::pmr::vector<int>& seen)
+    {
+        if (copied[idx] >= 0)
+        {
+            return copied[idx];
+        }
+        expr_node node = in.nodes[idx];
+        if (node.lhs >= 0) node.lhs = share_node(in, node.lhs, out, copied, seen);
+        if (node.rhs >= 0) node.rhs = share_node(in, node.rhs, out, copied, seen);
+
+        const node_key key(node);
+        const size_t mask = seen.size() - 1;
+        size_t i = key.hash() & mask;
+        while (seen[i] >= 0 && !(node_key(out.nodes[seen[i]]) == key))
+        {
+            i = (i + 1) & mask;
+        }
+        if (seen[i] < 0)
+        {
+            seen[i] = out.add(node);
+        }
+        return copied[idx] = seen[i];
+    }
+
+    //hash conses the tree into a dag in which every distinct subexpression is a single
+    //node, emit() evaluates those once and keeps the value for the other uses
+    //no arithmetic changes, so the results are bit identical
+    expr_tree share_subtrees(const expr_tree& tree)
+    {
+        auto* mem = tree.nodes.get_allocator().resource();
+        expr_tree res(mem);
+        res.nodes.reserve(tree.nodes.size());
+        std::pmr::vector<int> copied(tree.nodes.size(), -1, mem);
+        //at most half full, so probes stay short
+        std::pmr::vector<int> seen(std::bit_ceil(tree.nodes.size() * 2), -1, mem);
+        res.root = share_node(tree, tree.root, res, copied, seen);
+        return res;
+    }
+
+    //the result lives in the same memory resource as tree
+    expr_tree optimize(const expr_tree& tree, opt_level level, opt_stats* stats = nullptr)
+    {
+        expr_tree res(tree.nodes.get_allocator().resource());
+        if (level == opt_level::NONE)
+        {
+            res = tree;
+        }
+        else
+        {
+            std::pmr::vector<int> done(tree.nodes.size(), -1, tree.nodes.get_allocator().resource());
+            res.root = optimize_node(tree, tree.root, res, level, done);
+            res = share_subtrees(res);
+        }
+        if (stats)
+        {
+            stats->nodes_before = tree.count(tree.root);
+            stats->nodes_after = res.count(res.root);
+            stats->nodes_unique = level == opt_level::NONE ? stats->nodes_after : static_cast<int>(res.nodes.size());
+        }
+        return res;
+    }
+
+    //node of a call to the named function, digamma and trigamma are only
+    //reachable through derivatives and can't be parsed
+    int add_call(expr_tree& tree, std::string_view name, int arg)
+    {
+        expr_node node{ op_code::CALL };
+        if (name == "digamma")
+        {
+            node.func = digamma;
+            node.deriv = trigamma;
+        }
+        else if (name == "trigamma")
+        {
+            node.func = trigamma;
+        }
+        else
+        {
+            node.func = unary_func_tbl[name];
+            node.batch_func = simd::get_unary_kernel(name);
+            node.deriv = unary_deriv_tbl[name];
+            node.range = unary_interval_tbl[name];
+        }
+        node.lhs = arg;
+        return tree.add(node);
+    }
+
+    int differentiate_node(expr_tree& tree, int idx, int var, std::vector<int>& done);
+
+    //appends the derivative of the node at idx with respect to variable slot var
+    //the subtrees of tree are shared by the derivative instead of copied
+    //terms that are exactly 0 or 1 are dropped right away, optimize() folds the rest
+    int derive_node(expr_tree& tree, int idx, int var, std::vector<int>& done)
+    {
+        const expr_node node = tree.nodes[idx]; //a copy, add() can reallocate
+        const auto constant = [&](double value) { return tree.add({ op_code::PUSH_CONST, value }); };
+        const auto op = [&](op_code code, int lhs, int rhs = -1)
+        {
+            const bool lhs_zero = tree.is_const(lhs, 0.0);
+            const bool rhs_zero = rhs >= 0 && tree.is_const(rhs, 0.0);
+            switch (code)
+            {
+            case op_code::ADD:
+                if (lhs_zero) return rhs;
+                if (rhs_zero) return lhs;
+                break;
+            case op_code::SUB:
+                if (rhs_zero) return lhs;
+                if (lhs_zero) return tree.add({ op_code::NEG, 0.0, nullptr, nullptr, rhs });
+                break;
+            case op_code::MUL:
+                if (lhs_zero || rhs_zero) return constant(0.0);
+                if (tree.is_const(lhs, 1.0)) return rhs;
+                if (tree.is_const(rhs, 1.0)) return lhs;
+                break;
+            case op_code::DIV:
+                if (lhs_zero) return constant(0.0);
+                if (tree.is_const(rhs, 1.0)) return lhs;
+                break;
+            case op_code::NEG:
+                if (tree.is_const(lhs)) return constant(-tree.nodes[lhs].value);
+                break;
+            default:
+                break;
+            }
+            return tree.add({ code, 0.0, nullptr, nullptr, lhs, rhs });
+        };
+        const auto call = [&](std::string_view name, int arg) { return add_call(tree, name, arg); };
+        const auto square = [&](int u) { return op(op_code::MUL, u, u); };
+
+        switch (node.op)
+        {
+        case op_code::PUSH_CONST:
+            return constant(0.0);
+        case op_code::PUSH_VAR:
+            return constant(node.var == var ? 1.0 : 0.0);
+        case op_code::ADD:
+        case op_code::SUB:
+            return op(node.op, differentiate_node(tree, node.lhs, var, done), differentiate_node(tree, node.rhs, var, done));
+        case op_code::NEG:
+            return op(op_code::NEG, differentiate_node(tree, node.lhs, var, done));
+        case op_code::MUL:
+        {
+            const int da = differentiate_node(tree, node.lhs, var, done);
+            const int db = differentiate_node(tree, node.rhs, var, done);
+            return op(op_code::ADD, op(op_code::MUL, da, node.rhs), op(op_code::MUL, node.lhs, db));
+        }
+        case op_code::DIV:
+        {
+            const int da = differentiate_node(tree, node.lhs, var, done);
+            const int db = differentiate_node(tree, node.rhs, var, done);
+            return op(op_code::DIV, op(op_code::SUB, op(op_code::MUL, da, node.rhs), op(op_code::MUL, node.lhs, db)), square(node.rhs));
+        }
+        case op_code::POW:
+        {
+            const int a = node.lhs;
+            const int b = node.rhs;
+            const int da = differentiate_node(tree, a, var, done);
+            const int db = differentiate_node(tree, b, var, done);
+            //b a^(b - 1) a' + a^b log(a) b', as in pow_dual
+            const int base_term = op(op_code::MUL, op(op_code::MUL, b, op(op_code::POW, a, op(op_code::SUB, b, constant(1.0)))), da);
+            const int exp_term = tree.is_const(db, 0.0) ? db : op(op_code::MUL, op(op_code::MUL, idx, call("log", a)), db);
+            return op(op_code::ADD, base_term, exp_term);
+        }
+        case op_code::CALL:
+        {
+            const int u = node.lhs;
+            const int du = differentiate_node(tree, u, var, done);
+            if (tree.is_const(du, 0.0))
+            {
+                return du;
+            }
+            const auto is = [&](std::string_view name) { return node.func == unary_func_tbl[name]; };
+            const auto inv_sqrt = [&](int arg) { return op(op_code::DIV, constant(1.0), call("sqrt", arg)); };
+            int outer;
+            if (is("sin")) outer = call("cos", u);
+            else if (is("cos")) outer = op(op_code::NEG, call("sin", u));
+            else if (is("tan")) outer = op(op_code::ADD, constant(1.0), square(idx));
+            else if (is("sqrt")) outer = op(op_code::DIV, constant(0.5), idx);
+            else if (is("abs")) outer = op(op_code::DIV, u, idx);
+            else if (is("asin")) outer = inv_sqrt(op(op_code::SUB, constant(1.0), square(u)));
+            else if (is("acos")) outer = op(op_code::NEG, inv_sqrt(op(op_code::SUB, constant(1.0), square(u))));
+            else if (is("atan")) outer = op(op_code::DIV, constant(1.0), op(op_code::ADD, constant(1.0), square(u)));
+            else if (is("log")) outer = op(op_code::DIV, constant(1.0), u);
+            else if (is("log10")) outer = op(op_code::DIV, constant(1.0), op(op_code::MUL, u, constant(std::numbers::ln10)));
+            else if (is("sinh")) outer = call("cosh", u);
+            else if (is("cosh")) outer = call("sinh", u);
+            else if (is("tanh")) outer = op(op_code::SUB, constant(1.0), square(idx));
+            else if (is("exp")) outer = idx;
+            else if (is("cbrt")) outer = op(op_code::DIV, constant(1.0), op(op_code::MUL, constant(3.0), square(idx)));
+            else if (is("tgamma")) outer = op(op_code::MUL, idx, call("digamma", u));
+            else if (is("lgamma")) outer = call("digamma", u);
+            else if (is("ceil") || is("floor") || is("trunc")) outer = constant(0.0);
+            else if (is("acosh")) outer = inv_sqrt(op(op_code::SUB, square(u), constant(1.0)));
+            else if (is("asinh")) outer = inv_sqrt(op(op_code::ADD, square(u), constant(1.0)));
+            else if (is("atanh")) outer = op(op_code::DIV, constant(1.0), op(op_code::SUB, constant(1.0), square(u)));
+            else if (node.func == digamma) outer = call("trigamma", u);
+            else throw parse_error("no derivative for a function in the expression");
+            return op(op_code::MUL, outer, du);
+        }
+        default: //STORE and LOAD only exist in compiled code
+            break;
+        }
+        return constant(0.0);
+    }
+
+    //derivative of the subtree at idx, worked out once however often the subtree is used
+    int differentiate_node(expr_tree& tree, int idx, int var, std::vector<int>& done)
+    {
+        if (done[idx] < 0)
+        {
+            done[idx] = derive_node(tree, idx, var, done);
+        }
+        return done[idx];
+    }
+
+    //symbolic derivative of tree with respect to variable slot var
+    //the result shares subtrees with itself, optimize() it before compiling
+    expr_tree differentiate(const expr_tree& tree, int var = 0)
+    {
+        expr_tree res = tree;
+        std::vector<int> done(tree.nodes.size(), -1);
+        res.root = differentiate_node(res, tree.root, var, done);
+        return res;
+    }
+
+    //infix text of the subtree at idx with every operation in parentheses, so s_yard
+    //reads it back as the same tree, unless it calls digamma or trigamma
+    std::string to_string(const expr_tree& tree, std::span<const std::string_view> var_names, int idx = -1)
+    {
+        const auto& node = tree.nodes[idx < 0 ? tree.root : idx];
+        const auto sub = [&](int i) { return to_string(tree, var_names, i); };
+        switch (node.op)
+        {
+        case op_code::PUSH_CONST:
+        {
+            if (std::isnan(node.value)) return "(0/0)";
+            if (std::isinf(node.value)) return node.value > 0 ? "(1/0)" : "(0-1/0)";
+            //the lexer has no exponents and no signs in numbers
+            char buf[400];
+            const auto end = std::to_chars(buf, buf + sizeof(buf), std::abs(node.value), std::chars_format::fixed).ptr;
+            const std::string num(buf, end);
+            return std::signbit(node.value) ? "(0-" + num + ")" : num;
+        }
+        case op_code::PUSH_VAR: return std::string(var_names[node.var]);
+        case op_code::NEG: return "(0-" + sub(node.lhs) + ")";
+        case op_code::CALL:
+        {
+            std::string_view name = node.func == digamma ? "digamma" : "trigamma";
+            for (const auto& [func_name, func] : unary_func_tbl)
+            {
+                if (func == node.func)
+                {
+                    name = func_name;
+                }
+            }
+            return std::string(name) + "(" + sub(node.lhs) + ")";
+        }
+        default:
+        {
+            constexpr std::string_view ops[] = { "+", "-", "*", "/", "^" };
+            return "(" + sub(node.lhs) + std::string(ops[get_binary_kernel(node.op)]) + sub(node.rhs) + ")";
+        }
+        }
+    }
+
+    //bookkeeping of emit() for nodes used by more than one parent
+    struct emit_state
+    {
+        std::pmr::vector<int> uses; //references left to each node
+        std::pmr::vector<int> temp; //temporary holding the value of a node, -1 if none does
+        uint32_t taken = 0; //bit per temporary
+    };
+    static_assert(max_temps <= 32, "emit_state::taken has a bit per temporary");
+
+    //counts the parents of every node reachable from idx
+    void count_uses(const expr_tree& tree, int idx, std::pmr::vector<int>& uses)
+    {
+        if (uses[idx]++ > 0)
+        {
+            return;
+        }
+        if (tree.nodes[idx].lhs >= 0) count_uses(tree, tree.nodes[idx].lhs, uses);
+        if (tree.nodes[idx].rhs >= 0) count_uses(tree, tree.nodes[idx].rhs, uses);
+    }
+
+    //appends the subtree at idx in post order, returns the stack depth it needs
+    //a node with uses left is stored to a free temporary and loaded for the rest of them,
+    //so the order of the code is a schedule of the dag and temporaries are reused once
+    //their last load is emitted
+    int emit(const expr_tree& tree, int idx, compiled_func& res, emit_state& state)
+    {
+        const auto& node = tree.nodes[idx];
+        if (const int temp = state.temp[idx]; temp >= 0)
+        {
+            res.code.push_back({ op_code::LOAD, static_cast<uint16_t>(temp) });
+            if (--state.uses[idx] <= 0)
+            {
+                state.taken &= ~(1u << temp);
+                state.temp[idx] = -1;
+            }
+            return 1;
+        }
+        int depth = 1;
+        if (node.lhs >= 0) depth = emit(tree, node.lhs, res, state);
+        if (node.rhs >= 0) depth = std::max(depth, emit(tree, node.rhs, res, state) + 1);
+        res.code.push_back({ node.op, node.var, node.value, node.func, node.batch_func, node.deriv, node.range });
+        //leaves are as cheap to push again as to load
+        if (--state.uses[idx] > 0 && node.lhs >= 0 && state.taken != ~0u >> (32 - max_temps))
+        {
+            const int temp = std::countr_one(state.taken);
+            state.taken |= 1u << temp;
+            state.temp[idx] = temp;
+            res.num_temps = std::max(res.num_temps, temp + 1);
+            res.code.push_back({ op_code::STORE, static_cast<uint16_t>(temp) });
+        }
+        return depth;
+    }
+
+    //lowers tree into res, reusing the memory res already holds
+    void compile(const expr_tree& tree, int num_vars, compiled_func& res)
+    {
+        auto* mem = tree.nodes.get_allocator().resource();
+        emit_state state{ std::pmr::vector<int>(tree.nodes.size(), 0, mem), std::pmr::vector<int>(tree.nodes.size(), -1, mem) };
+        count_uses(tree, tree.root, state.uses);
+        res.code.clear();
+        res.native.reset();
+        res.num_vars = num_vars;
+        res.num_temps = 0;
+        PROFILE_SCOPE("compile");
+        res.math = simd::accuracy::EXACT;
+        res.power = static_cast<double(*)(double, double)>(std::pow);
+        res.batch_power = nullptr;
+        res.stack_depth = emit(tree, tree.root, res, state);
+        if (res.stack_depth > max_stack_depth)
+        {
+            throw parse_error("expression is nested too deeply");
+        }
+    }
+
+    compiled_func compile(const expr_tree& tree, int num_vars = 1)
+    {
+        compiled_func res;
+        compile(tree, num_vars, res);
+        return res;
+    }
+
+    //lowers the rpn vec to a compiled_func, optimizing it first if level isn't NONE
+    compiled_func compile(const std::vector<std::variant<double, std::string>>& tokens, std::span<const std::string_view> var_names,
+                          opt_level level = opt_level::NONE, opt_stats* stats = nullptr)
+    {
+        return compile(optimize(build_tree(tokens, var_names), level, stats), static_cast<int>(var_names.size()));
+    }
+
+    compiled_func compile(const std::vector<std::variant<double, std::string>>& tokens, std::string_view var_name,
+                          opt_level level = opt_level::NONE, opt_stats* stats = nullptr)
+    {
+        return compile(tokens, std::span(&var_name, 1), level, stats);
+    }
+
+    //compiles text without heap allocations once it has warmed up, one per thread
+    //the tokens, operator stack, rpn and trees of a parse live in an arena the next
+    //parse reuses, and the result is written into a compiled_func that keeps its memory
+    class compiler
+    {
+    public:
+        void compile(std::string_view str, std::span<const std::string_view> var_names, compiled_func& out,
+                     opt_level level = opt_level::FULL)
+        {
+            mem.reset();
+            const auto rpn = to_rpn(str, var_names, &mem);
+            const expr_tree tree = optimize(build_tree(rpn, var_names.size(), &mem), level);
+            parser::compile(tree, static_cast<int>(var_names.size()), out);
+        }
+
+        void compile(std::string_view str, std::string_view var_name, compiled_func& out, opt_level level = opt_level::FULL)
+        {
+            compile(str, std::span(&var_name, 1), out, level);
+        }
+
+        //bytes the arena holds on to between parses
+        size_t arena_size() const
+        {
+            return mem.capacity();
+        }
+
+    private:
+        arena mem;
+    };
+
+    //switches the calls and powers of func to the approximations of simd::approx, or back to
+    //libm for EXACT, the context that compiled func decides how exact it has to be
+    //derivatives and interval bounds keep using the exact functions
+    //any native code is dropped, jit::compile it again afterwards
+    void approximate(compiled_func& func, simd::accuracy math)
+    {
+        const auto& kernels = simd::kernels();
+        const int acc = static_cast<int>(math) - 1;
+        for (auto& ins : func.code)
+        {
+            if (ins.op != op_code::CALL)
+            {
+                continue;
+            }
+            for (const auto& f : get_functions())
+            {
+                const int kernel = simd::get_approx_kernel(f.name);
+                if (kernel < 0)
+                {
+                    continue;
+                }
+                const auto is = [&](simd::accuracy a) { return ins.func == simd::approx::get_scalar(static_cast<simd::approx_kernel>(kernel), a); };
+                if (ins.func == f.func || is(simd::accuracy::FAST) || is(simd::accuracy::COARSE))
+                {
+                    ins.func = math == simd::accuracy::EXACT ? f.func : simd::approx::get_scalar(static_cast<simd::approx_kernel>(kernel), math);
+                    ins.batch_func = math == simd::accuracy::EXACT ? f.batch_func : kernels.approx[acc][kernel];
+                    break;
+                }
+            }
+        }
+        func.math = math;
+        func.power = math == simd::accuracy::EXACT ? static_cast<double(*)(double, double)>(std::pow) :
+                     math == simd::accuracy::FAST ? simd::approx::pow<simd::accuracy::FAST> : simd::approx::pow<simd::accuracy::COARSE>;
+        func.batch_power = math == simd::accuracy::EXACT ? nullptr : kernels.pow[acc];
+        func.native.reset();
+    }
+
+    //lowers the derivative of the rpn vec with respect to the variable in slot var
+    compiled_func compile_derivative(const std::vector<std::variant<double, std::string>>& tokens, std::span<const std::string_view> var_names,
+                                     int var = 0, opt_level level = opt_level::FULL)
+    {
+        const expr_tree tree = optimize(build_tree(tokens, var_names), level);
+        return compile(optimize(differentiate(tree, var), level), static_cast<int>(var_names.size()));
+    }
+
+    compiled_func compile_derivative(const std::vector<std::variant<double, std::string>>& tokens, std::string_view var_name,
+                                     opt_level level = opt_level::FULL)
+    {
+        return compile_derivative(tokens, std::span(&var_name, 1), 0, level);
+    }
+
+    //creates function that fully represents the rpn vec that is passed
+    //compile() is the faster path, and folds things like 1 + 1 + 2 into 4
+    std::function<double(double)> build_func(const std::vector<std::variant<double, std::string>>& tokens, std::string var_name)
+    {
+        PROFILE_SCOPE("build_func");
+        std::stack<std::function<double(double)>> stack;
+        for (const auto& tok : tokens)
+        {
+            if (const double* num_ptr = std::get_if<double>(&tok))
+            {
+                stack.push([number = *num_ptr](double) {return number;});
+            }
+            else if (std::get<std::string>(tok) == var_name)
+            {
+                stack.push([](double var_value) {return var_value;});
+            }
+            else if (is_binary_op(std::get<std::string>(tok)))
+            {
+                auto right = stack.top();
+                stack.pop();
+                if (!stack.empty())
+                {
+                    auto left = stack.top();
+                    stack.pop();
+                    auto op = std::get<std::string>(tok);
+                    stack.push([left, right, op](double var_value) {return compute_binary_ops(left(var_value), right(var_value), op);});
+                }
+                //if unary minus
+                else if(std::get<std::string>(tok) == "-")
+                {
+                    stack.push([right](double var_value) {return -(right(var_value));});
+                }         
+            }
+            else if (is_func(std::get<std::string>(tok)))
+            {
+                auto operand = stack.top();
+                stack.pop();
+                auto func = unary_func_tbl[std::get<std::string>(tok)];
+                stack.push([operand, func](double var_value) {return func(operand(var_value));});
+            }
+        }
+        return stack.top();
+    }
+
+    //string literal usable as a template argument
+    template<size_t N>
+    struct fixed_string
+    {
+        char data[N]{};
+
+        constexpr fixed_string(const char (&str)[N])
+        {
+            std::copy_n(str, N, data);
+        }
+
+        constexpr std::string_view view() const { return { data, N - 1 }; }
+    };
+
+    //id of the named function in unary_funcs, -1 if there is none
+    constexpr int find_unary_func(std::string_view name)
+    {
+        for (size_t i = 0; i < std::size(unary_funcs); i++)
+        {
+            if (unary_funcs[i].first == name) return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    //to_rpn and build_tree run at compile time, a formula that doesn't parse fails to compile
+    //FUNC ids index unary_funcs, start holds the first token of the subtree ending at each token,
+    //binary tells a "-" with two operands from unary minus
+    template<size_t N>
+    struct static_rpn
+    {
+        rpn_token tokens[N]{};
+        int start[N]{};
+        bool binary[N]{};
+        int size = 0;
+        int num_vars = 0;
+    };
+
+    //var_names is comma separated like --var, the whole thing is one shunting yard pass
+    //over the same lexer rules, operator table and functions as tokenize and to_rpn
+    template<size_t N>
+    consteval static_rpn<N> parse_static(std::string_view str, std::string_view var_names)
+    {
+        static_rpn<N> res;
+        std::string_view vars[max_vars];
+        for (size_t begin = 0; !var_names.empty() && begin <= var_names.size();)
+        {
+            const size_t end = std::min(var_names.find(',', begin), var_names.size());
+            vars[res.num_vars++] = var_names.substr(begin, end - begin);
+            begin = end + 1;
+        }
+
+        struct pending
+        {
+            token_kind kind;
+            std::string_view text;
+        };
+        pending op_stack[N]{};
+        int op_size = 0;
+        const auto pop_op = [&]
+        {
+            const pending& top = op_stack[--op_size];
+            if (top.kind == token_kind::OPERATOR)
+            {
+                res.tokens[res.size++] = { rpn_kind::OP, static_cast<uint16_t>(top.text[0]) };
+            }
+            else
+            {
+                res.tokens[res.size++] = { rpn_kind::FUNC, static_cast<uint16_t>(find_unary_func(top.text)) };
+            }
+        };
+
+        int paren_depth = 0;
+        for (size_t i = 0; i < str.size();)
+        {
+            const char c = str[i];
+            const size_t begin = i;
+            if (c == ' ' || c == '\t')
+            {
+                ++i;
+            }
+            else if (is_digit(c))
+            {
+                //digits / 10^fraction is one correctly rounded division, the same double from_chars gives
+                uint64_t digits = 0;
+                int fraction = 0;
+                while (i < str.size() && is_digit(str[i])) digits = digits * 10 + (str[i++] - '0');
+                if (i + 1 < str.size() && str[i] == '.' && is_digit(str[i + 1]))
+                {
+                    ++i;
+                    while (i < str.size() && is_digit(str[i]))
+                    {
+                        digits = digits * 10 + (str[i++] - '0');
+                        ++fraction;
+                    }
+                }
+                if (digits > (uint64_t(1) << 53) || fraction > 22 || i - begin > 18)
+                {
+                    throw "numbers in a static_expr are limited to 15 significant digits";
+                }
+                double scale = 1.0;
+                for (int k = 0; k < fraction; k++) scale *= 10.0;
+                res.tokens[res.size++] = { rpn_kind::NUMBER, 0, static_cast<double>(digits) / scale };
+            }
+            else if (is_ident_start(c))
+            {
+                while (i < str.size() && is_ident_char(str[i])) ++i;
+                const std::string_view name = str.substr(begin, i - begin);
+                if (const auto var = std::ranges::find(vars, vars + res.num_vars, name); var != vars + res.num_vars)
+                {
+                    res.tokens[res.size++] = { rpn_kind::VAR, static_cast<uint16_t>(var - vars) };
+                }
+                else if (name == "pi")
+                {
+                    res.tokens[res.size++] = { rpn_kind::NUMBER, 0, std::numbers::pi };
+                }
+                else if (name == "e")
+                {
+                    res.tokens[res.size++] = { rpn_kind::NUMBER, 0, std::numbers::e_v<double> };
+                }
+                else if (find_unary_func(name) >= 0)
+                {
+                    op_stack[op_size++] = { token_kind::IDENTIFIER, name };
+                }
+                else
+                {
+                    throw "unknown token";
+                }
+            }
+            else if (is_binary_op(str.substr(i, 1)))
+            {
+                const std::string_view op = str.substr(i++, 1);
+                while (op_size > 0 && op_stack[op_size - 1].kind == token_kind::OPERATOR &&
+                      (get_assoc_prec(op_stack[op_size - 1].text).first > get_assoc_prec(op).first ||
+                      (get_assoc_prec(op_stack[op_size - 1].text).first == get_assoc_prec(op).first && is_left_assoc(op))))
+                {
+                    pop_op();
+                }
+                op_stack[op_size++] = { token_kind::OPERATOR, op };
+            }
+            else if (c == '(')
+            {
+                ++i;
+                ++paren_depth;
+                op_stack[op_size++] = { token_kind::LEFT_PAREN, "(" };
+            }
+            else if (c == ')')
+            {
+                ++i;
+                --paren_depth;
+                while (op_size > 0 && op_stack[op_size - 1].kind != token_kind::LEFT_PAREN)
+                {
+                    pop_op();
+                }
+                if (op_size == 0)
+                {
+                    throw "mismatched parentheses";
+                }
+                --op_size;
+                if (op_size > 0 && op_stack[op_size - 1].kind == token_kind::IDENTIFIER)
+                {
+                    pop_op();
+                }
+            }
+            else
+            {
+                throw "unknown token in input";
+            }
+        }
+        if (paren_depth != 0)
+        {
+            throw "parenthesis issue";
+        }
+        while (op_size > 0)
+        {
+            if (op_stack[op_size - 1].kind == token_kind::LEFT_PAREN)
+            {
+                throw "mismatched parentheses";
+            }
+            pop_op();
+        }
+
+        //the operand checks of build_tree, with subtree starts in place of node indices
+        int stack[N]{};
+        int depth = 0;
+        for (int i = 0; i < res.size; i++)
+        {
+            const rpn_token& tok = res.tokens[i];
+            if (tok.kind == rpn_kind::NUMBER || tok.kind == rpn_kind::VAR)
+            {
+                res.start[i] = i;
+                stack[depth++] = i;
+            }
+            else if (tok.kind == rpn_kind::OP && depth >= 2)
+            {
+                res.binary[i] = true;
+                res.start[i] = stack[--depth - 1];
+                stack[depth - 1] = res.start[i];
+            }
+            else if ((tok.kind == rpn_kind::OP && depth == 1 && tok.id == '-') || (tok.kind == rpn_kind::FUNC && depth >= 1))
+            {
+                res.start[i] = stack[depth - 1];
+            }
+            else
+            {
+                throw "missing operand";
+            }
+        }
+        if (depth != 1)
+        {
+            throw depth == 0 ? "empty expression" : "missing operator";
+        }
+        return res;
+    }
+
+    //value of the subtree of rpn that ends at token i, every token is its own instantiation
+    //so the whole formula inlines into straight line code
+    template<const auto& rpn, int i>
+    constexpr double eval_static(const double* vars)
+    {
+        constexpr rpn_token tok = rpn.tokens[i];
+        if constexpr (tok.kind == rpn_kind::NUMBER)
+        {
+            return tok.value;
+        }
+        else if constexpr (tok.kind == rpn_kind::VAR)
+        {
+            return vars[tok.id];
+        }
+        else if constexpr (tok.kind == rpn_kind::FUNC)
+        {
+            constexpr auto func = unary_funcs[tok.id].second;
+            return func(eval_static<rpn, i - 1>(vars));
+        }
+        else if constexpr (!rpn.binary[i])
+        {
+            return -eval_static<rpn, i - 1>(vars);
+        }
+        else
+        {
+            const double lhs = eval_static<rpn, rpn.start[i - 1] - 1>(vars);
+            const double rhs = eval_static<rpn, i - 1>(vars);
+            if constexpr (tok.id == '+') return lhs + rhs;
+            else if constexpr (tok.id == '-') return lhs - rhs;
+            else if constexpr (tok.id == '*') return lhs * rhs;
+            else if constexpr (tok.id == '/') return lhs / rhs;
+            else return std::pow(lhs, rhs);
+        }
+    }
+
+    //formula fixed at build time, parsed by the compiler and evaluated without s_yard, build_func
+    //or an interpreter, gives what build_func gives for the same text
+    //static_expr<"x^2 + sin(x)"> f; f(0.5)
+    //static_expr<"x*y - t", "x,y,t"> g; g(1.0, 2.0, 3.0)
+    template<fixed_string str, fixed_string var_names = "x">
+    class static_expr
+    {
+    public:
+        static constexpr auto rpn = parse_static<sizeof(str.data)>(str.view(), var_names.view());
+        static constexpr int num_vars = rpn.num_vars;
+
+        template<std::convertible_to<double>... Args>
+            requires (sizeof...(Args) == num_vars)
+        constexpr double operator()(Args... args) const
+        {
+            const std::array<double, sizeof...(Args)> vars{ static_cast<double>(args)... };
+            return eval_static<rpn, rpn.size - 1>(vars.data());
+        }
+
+        constexpr double operator()(std::span<const double> vars) const
+        {
+            return eval_static<rpn, rpn.size - 1>(vars.data());
+        }
+    };
+}
+
+namespace jit
+{
+#ifdef SIMD_X86
+    //x86-64 encoder for the handful of instructions the code generator needs
+    //every stack slot of the compiled_func lives at a fixed offset from rsp
+    class assembler
+    {
+    public:
+        std::vector<uint8_t> code;
+
+        void bytes(std::initializer_list<uint8_t> b) { code.insert(code.end(), b); }
+
+        void imm32(int32_t v)
+        {
+            for (int i = 0; i < 4; i++) code.push_back(static_cast<uint8_t>(v >> (i * 8)));
+        }
+
+        void imm64(uint64_t v)
+        {
+            for (int i = 0; i < 8; i++) code.push_back(static_cast<uint8_t>(v >> (i * 8)));
+        }
+
+        //<prefix> 0F <opcode> with a [rsp + disp32] memory operand, xmm is the register field
+        void sse_rsp(uint8_t prefix, uint8_t opcode, int xmm, int32_t disp)
+        {
+            bytes({ prefix, 0x0F, opcode, static_cast<uint8_t>(0x84 | (xmm << 3)), 0x24 });
+            imm32(disp);
+        }
+
+        void load(int xmm, int32_t disp) { sse_rsp(0xF2, 0x10, xmm, disp); }   //movsd xmm, [rsp + disp]
+        void store(int32_t disp, int xmm) { sse_rsp(0xF2, 0x11, xmm, disp); }  //movsd [rsp + disp], xmm
+
+        void mov_rax(uint64_t v) { bytes({ 0x48, 0xB8 }); imm64(v); }          //mov rax, imm64
+        void call_rax() { bytes({ 0xFF, 0xD0 }); }                             //call rax
+
+        void store_rax(int32_t disp)                                           //mov [rsp + disp], rax
+        {
+            bytes({ 0x48, 0x89, 0x84, 0x24 });
+            imm32(disp);
+        }
+
+        void call(const void* func)
+        {
+            mov_rax(reinterpret_cast<uint64_t>(func));
+            call_rax();
+        }
+
+        //rel32 of a jump whose offset field ends at code.size()
+        void patch_rel32(size_t field, size_t target)
+        {
+            const int32_t rel = static_cast<int32_t>(target) - static_cast<int32_t>(field + 4);
+            std::memcpy(code.data() + field, &rel, 4);
+        }
+    };
+
+    //the body of the expression, shared by the scalar and batch entry points
+    //with lanes == 4 every slot holds four inputs, arithmetic runs on packed
+    //pairs and calls are made once per lane so the four chains can overlap
+    //reads the variable from [rsp + var_disp] and leaves the result in the first slot
+    bool emit_body(assembler& as, const parser::compiled_func& func, int32_t var_disp, int32_t slot_disp, int lanes)
+    {
+        using parser::op_code;
+        const int32_t stride = lanes * 8;
+        const auto slot = [&](int i) { return slot_disp + i * stride; };
+        const auto sqrt_func = parser::unary_func_tbl["sqrt"];
+        const auto abs_func = parser::unary_func_tbl["abs"];
+        const auto pow_func = static_cast<double(*)(double, double)>(std::pow);
+        //scalar ops are F2 0F xx, the packed ones are 66 0F xx on 16 byte aligned slots
+        const uint8_t prefix = lanes == 1 ? 0xF2 : 0x66;
+        const uint8_t load_op = lanes == 1 ? 0x10 : 0x28;
+        const uint8_t store_op = lanes == 1 ? 0x11 : 0x29;
+        const int halves = lanes == 1 ? 1 : lanes / 2;
+
+        int sp = 0;
+        for (const auto& ins : func.code)
+        {
+            switch (ins.op)
+            {
+            case op_code::PUSH_CONST:
+                as.mov_rax(std::bit_cast<uint64_t>(ins.value));
+                as.bytes({ 0x66, 0x48, 0x0F, 0x6E, 0xC0 });     //movq xmm0, rax
+                as.bytes({ 0x66, 0x0F, 0x14, 0xC0 });           //unpcklpd xmm0, xmm0
+                for (int h = 0; h < halves; h++) as.sse_rsp(prefix, store_op, 0, slot(sp) + h * 16);
+                ++sp;
+                break;
+            case op_code::PUSH_VAR:
+                for (int h = 0; h < halves; h++)
+                {
+                    as.sse_rsp(prefix, load_op, 0, var_disp + h * 16);
+                    as.sse_rsp(prefix, store_op, 0, slot(sp) + h * 16);
+                }
+                ++sp;
+                break;
+            case op_code::ADD:
+            case op_code::SUB:
+            case op_code::MUL:
+            case op_code::DIV:
+            {
+                //add, sub, mul, div xmm0, [rsp + disp]
+                constexpr uint8_t opcodes[] = { 0x58, 0x5C, 0x59, 0x5E };
+                --sp;
+                for (int h = 0; h < halves; h++)
+                {
+                    as.sse_rsp(prefix, load_op, 0, slot(sp - 1) + h * 16);
+                    as.sse_rsp(prefix, opcodes[parser::get_binary_kernel(ins.op)], 0, slot(sp) + h * 16);
+                    as.sse_rsp(prefix, store_op, 0, slot(sp - 1) + h * 16);
+                }
+                break;
+            }
+            case op_code::POW:
+                --sp;
+                for (int l = 0; l < lanes; l++)
+                {
+                    as.load(0, slot(sp - 1) + l * 8);
+                    as.load(1, slot(sp) + l * 8);
+                    as.call(reinterpret_cast<const void*>(pow_func));
+                    as.store(slot(sp - 1) + l * 8, 0);
+                }
+                break;
+            case op_code::NEG:
+                as.mov_rax(0x8000000000000000ull);
+                as.bytes({ 0x66, 0x48, 0x0F, 0x6E, 0xC8 });     //movq xmm1, rax
+                as.bytes({ 0x66, 0x0F, 0x14, 0xC9 });           //unpcklpd xmm1, xmm1
+                for (int h = 0; h < halves; h++)
+                {
+                    as.sse_rsp(prefix, load_op, 0, slot(sp - 1) + h * 16);
+                    as.bytes({ 0x66, 0x0F, 0x57, 0xC1 });       //xorpd xmm0, xmm1
+                    as.sse_rsp(prefix, store_op, 0, slot(sp - 1) + h * 16);
+                }
+                break;
+            case op_code::CALL:
+                if (ins.func == abs_func)
+                {
+                    as.mov_rax(0x7FFFFFFFFFFFFFFFull);
+                    as.bytes({ 0x66, 0x48, 0x0F, 0x6E, 0xC8 }); //movq xmm1, rax
+                    as.bytes({ 0x66, 0x0F, 0x14, 0xC9 });       //unpcklpd xmm1, xmm1
+                    for (int h = 0; h < halves; h++)
+                    {
+                        as.sse_rsp(prefix, load_op, 0, slot(sp - 1) + h * 16);
+                        as.bytes({ 0x66, 0x0F, 0x54, 0xC1 });   //andpd xmm0, xmm1
+                        as.sse_rsp(prefix, store_op, 0, slot(sp - 1) + h * 16);
+                    }
+                    break;
+                }
+                if (ins.func == sqrt_func)
+                {
+                    for (int h = 0; h < halves; h++)
+                    {
+                        as.sse_rsp(prefix, 0x51, 0, slot(sp - 1) + h * 16); //sqrtsd/sqrtpd xmm0, [rsp + disp]
+                        as.sse_rsp(prefix, store_op, 0, slot(sp - 1) + h * 16);
+                    }
+                    break;
+                }
+                for (int l = 0; l < lanes; l++)
+                {
+                    as.load(0, slot(sp - 1) + l * 8);
+                    as.call(reinterpret_cast<const void*>(ins.func));
+                    as.store(slot(sp - 1) + l * 8, 0);
+                }
+                break;
+            //temporaries are the slots after the deepest stack slot
+            case op_code::STORE:
+                for (int h = 0; h < halves; h++)
+                {
+                    as.sse_rsp(prefix, load_op, 0, slot(sp - 1) + h * 16);
+                    as.sse_rsp(prefix, store_op, 0, slot(func.stack_depth + ins.var) + h * 16);
+                }
+                break;
+            case op_code::LOAD:
+                for (int h = 0; h < halves; h++)
+                {
+                    as.sse_rsp(prefix, load_op, 0, slot(func.stack_depth + ins.var) + h * 16);
+                    as.sse_rsp(prefix, store_op, 0, slot(sp) + h * 16);
+                }
+                ++sp;
+                break;
+            default:
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+
+    //translates func to x86-64 machine code, libm functions are called through their
+    //pointers in the instructions and every value lives in a stack slot in memory
+    //returns nullptr if there is no backend for this platform, the function takes more
+    //than one variable, it has approximated calls or powers or no executable memory could be
+    //had, callers keep using the interpreter
+    std::shared_ptr<const jit_func> compile(const parser::compiled_func& func)
+    {
+#ifdef SIMD_X86
+        if (func.num_vars != 1)
+        {
+            return nullptr;
+        }
+        //the interpreter runs those through the vector kernels a whole batch at a time,
+        //native code could only call them lane by lane, which is slower than libm
+        if (func.math != simd::accuracy::EXACT && std::ranges::any_of(func.code, [](const parser::instruction& ins)
+            {
+                return ins.op == parser::op_code::POW || (ins.op == parser::op_code::CALL && simd::approx::is_approx(ins.func));
+            }))
+        {
+            return nullptr;
+        }
+        //frame layout: [home space for win64 calls][variable][stack slots][temporaries]
+        constexpr int32_t shadow = 32;
+        constexpr int batch_lanes = 4;
+        const int32_t frame = (shadow + (1 + func.stack_depth + func.num_temps) * batch_lanes * 8 + 15) & ~15;
+        constexpr int32_t var_disp = shadow;
+        constexpr int32_t scalar_slot_disp = shadow + 16;
+        constexpr int32_t batch_slot_disp = shadow + batch_lanes * 8;
+
+        assembler as;
+
+        //double scalar(double x), x arrives in xmm0 on both abis
+        //one push keeps rsp 16 byte aligned for the calls
+        as.bytes({ 0x53 });                                     //push rbx
+        as.bytes({ 0x48, 0x81, 0xEC }); as.imm32(frame);        //sub rsp, frame
+        as.store(var_disp, 0);
+        if (!emit_body(as, func, var_disp, scalar_slot_disp, 1))
+        {
+            return nullptr;
+        }
+        as.load(0, scalar_slot_disp);
+        as.bytes({ 0x48, 0x81, 0xC4 }); as.imm32(frame);        //add rsp, frame
+        as.bytes({ 0x5B, 0xC3 });                               //pop rbx, ret
+
+        //void batch(const double* xs, double* out, size_t n)
+        //rbx = xs, r12 = out, r13 = n, all callee saved on both abis
+        //groups of four inputs go through the packed body, the rest through the scalar entry
+        const size_t batch_entry = as.code.size();
+        as.bytes({ 0x53, 0x41, 0x54, 0x41, 0x55 });             //push rbx, push r12, push r13
+        as.bytes({ 0x48, 0x81, 0xEC }); as.imm32(frame);        //sub rsp, frame
+#if defined(_WIN32)
+        as.bytes({ 0x48, 0x89, 0xCB, 0x49, 0x89, 0xD4, 0x4D, 0x89, 0xC5 }); //mov rbx, rcx; mov r12, rdx; mov r13, r8
+#else
+        as.bytes({ 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF4, 0x49, 0x89, 0xD5 }); //mov rbx, rdi; mov r12, rsi; mov r13, rdx
+#endif
+        as.bytes({ 0x49, 0x83, 0xFD, batch_lanes });            //cmp r13, 4
+        as.bytes({ 0x0F, 0x82 });                               //jb tail
+        const size_t tail_field = as.code.size();
+        as.imm32(0);
+
+        const size_t group_loop = as.code.size();
+        as.bytes({ 0x66, 0x0F, 0x10, 0x03 });                   //movupd xmm0, [rbx]
+        as.sse_rsp(0x66, 0x29, 0, var_disp);                    //movapd [rsp + var], xmm0
+        as.bytes({ 0x66, 0x0F, 0x10, 0x43, 0x10 });             //movupd xmm0, [rbx + 16]
+        as.sse_rsp(0x66, 0x29, 0, var_disp + 16);
+        emit_body(as, func, var_disp, batch_slot_disp, batch_lanes);
+        as.sse_rsp(0x66, 0x28, 0, batch_slot_disp);             //movapd xmm0, [rsp + slot 0]
+        as.bytes({ 0x66, 0x41, 0x0F, 0x11, 0x04, 0x24 });       //movupd [r12], xmm0
+        as.sse_rsp(0x66, 0x28, 0, batch_slot_disp + 16);
+        as.bytes({ 0x66, 0x41, 0x0F, 0x11, 0x44, 0x24, 0x10 }); //movupd [r12 + 16], xmm0
+        as.bytes({ 0x48, 0x83, 0xC3, batch_lanes * 8 });        //add rbx, 32
+        as.bytes({ 0x49, 0x83, 0xC4, batch_lanes * 8 });        //add r12, 32
+        as.bytes({ 0x49, 0x83, 0xED, batch_lanes });            //sub r13, 4
+        as.bytes({ 0x49, 0x83, 0xFD, batch_lanes });            //cmp r13, 4
+        as.bytes({ 0x0F, 0x83 });                               //jae group_loop
+        as.imm32(0);
+        as.patch_rel32(as.code.size() - 4, group_loop);
+
+        as.patch_rel32(tail_field, as.code.size());
+        as.bytes({ 0x4D, 0x85, 0xED });                         //test r13, r13
+        as.bytes({ 0x0F, 0x84 });                               //jz done
+        const size_t done_field = as.code.size();
+        as.imm32(0);
+        const size_t tail_loop = as.code.size();
+        as.bytes({ 0xF2, 0x0F, 0x10, 0x03 });                   //movsd xmm0, [rbx]
+        as.bytes({ 0xE8 });                                     //call scalar entry
+        as.imm32(0);
+        as.patch_rel32(as.code.size() - 4, 0);
+        as.bytes({ 0xF2, 0x41, 0x0F, 0x11, 0x04, 0x24 });       //movsd [r12], xmm0
+        as.bytes({ 0x48, 0x83, 0xC3, 0x08 });                   //add rbx, 8
+        as.bytes({ 0x49, 0x83, 0xC4, 0x08 });                   //add r12, 8
+        as.bytes({ 0x49, 0xFF, 0xCD });                         //dec r13
+        as.bytes({ 0x0F, 0x85 });                               //jnz tail_loop
+        as.imm32(0);
+        as.patch_rel32(as.code.size() - 4, tail_loop);
+
+        as.patch_rel32(done_field, as.code.size());
+        as.bytes({ 0x48, 0x81, 0xC4 }); as.imm32(frame);        //add rsp, frame
+        as.bytes({ 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });       //pop r13, pop r12, pop rbx, ret
+
+        return jit_func::create(as.code, batch_entry);
+#else
+        return nullptr;
+#endif
+    }
+}
+
+//thread safe lru cache from expression text to its compiled form, so
+//s_yard + compile only run once per distinct formula
+//keys are the text with whitespace removed plus the variable names and
+//the total size of keys and code is kept under max_bytes
+class expr_cache
+{
+public:
+    struct cache_stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    //the cached functions evaluate at accuracy math, see parser::approximate
+    explicit expr_cache(size_t max_bytes, simd::accuracy math = simd::accuracy::EXACT) : max_bytes(max_bytes), math(math) {}
+
+    //the tokens joined by spaces, so spacing between tokens doesn't matter but spacing that
+    //splits a token does, "co sx" and "cosx" or "2 3" and "23" stay apart
+    //text the lexer rejects is kept as it is, it never parses so it only has to match itself
+    static std::string normalize(std::string_view str, std::span<const std::string_view> var_names)
+    {
+        std::string key;
+        key.reserve(str.size() + 16);
+        try
+        {
+            for (const auto& tok : parser::tokenize(str, var_names))
+            {
+                key += key.empty() ? "" : " ";
+                key += tok.text;
+            }
+        }
+        catch (const parser::parse_error&)
+        {
+            key = str;
+        }
+        key += '\0';
+        for (size_t i = 0; i < var_names.size(); i++)
+        {
+            key += i == 0 ? "" : ",";
+            key += var_names[i];
+        }
+        return key;
+    }
+
+    static std::string normalize(std::string_view str, std::string_view var_name)
+    {
+        return normalize(str, std::span(&var_name, 1));
+    }
+
+    std::shared_ptr<const parser::compiled_func> get(std::string_view str, std::string_view var_name)
+    {
+        return get(str, std::span(&var_name, 1));
+    }
+
+    //returns the compiled expression, parsing and compiling it on a miss
+    //parse errors are thrown and nothing is cached for them
+    std::shared_ptr<const parser::compiled_func> get(std::string_view str, std::span<const std::string_view> var_names)
+    {
+        std::string key = normalize(str, var_names);
+        {
+            std::lock_guard lock(mtx);
+            if (const auto it = index.find(key); it != index.end())
+            {
+                ++stats.hits;
+                lru.splice(lru.begin(), lru, it->second);
+                return it->second->func;
+            }
+            ++stats.misses;
+        }
+
+        //compile without holding the lock, other threads can keep hitting the cache
+        thread_local parser::compiler comp;
+        parser::compiled_func compiled;
+        comp.compile(str, var_names, compiled, parser::opt_level::FULL);
+        if (math != simd::accuracy::EXACT)
+        {
+            parser::approximate(compiled, math);
+        }
+#ifdef JIT_ENABLED
+        compiled.native = jit::compile(compiled);
+#endif
+        auto func = std::make_shared<const parser::compiled_func>(std::move(compiled));
+
+        std::lock_guard lock(mtx);
+        //another thread may have compiled the same formula in the meantime
+        if (const auto it = index.find(key); it != index.end())
+        {
+            return it->second->func;
+        }
+        const size_t size = get_size(key, *func);
+        lru.push_front({ std::move(key), func, size });
+        index.emplace(lru.front().key, lru.begin());
+        stats.bytes += size;
+        //always keep the newest entry, even if it is over budget on its own
+        while (stats.bytes > max_bytes && lru.size() > 1)
+        {
+            stats.bytes -= lru.back().size;
+            index.erase(lru.back().key);
+            lru.pop_back();
+            ++stats.evictions;
+        }
+        return func;
+    }
+
+    bool contains(std::string_view str, std::string_view var_name) const
+    {
+        std::lock_guard lock(mtx);
+        return index.contains(normalize(str, var_name));
+    }
+
+    cache_stats get_stats() const
+    {
+        std::lock_guard lock(mtx);
+        cache_stats res = stats;
+        res.entries = lru.size();
+        return res;
+    }
+
+private:
+    struct entry
+    {
+        std::string key;
+        std::shared_ptr<const parser::compiled_func> func;
+        size_t size;
+    };
+
+    //native code counts with the whole pages it keeps mapped
+    static size_t get_size(const std::string& key, const parser::compiled_func& func)
+    {
+        return sizeof(entry) + key.size() + func.code.size() * sizeof(parser::instruction)
+               + (func.native ? func.native->mapped_size() : 0);
+    }
+
+    size_t max_bytes;
+    simd::accuracy math;
+    mutable std::mutex mtx;
+    std::list<entry> lru; //most recently used first
+    std::unordered_map<std::string_view, std::list<entry>::iterator> index; //views into entry::key
+    cache_stats stats;
+};
+
+//work stealing pool, every worker owns a deque of tasks, pops from its back
+//and steals from the front of the other deques when it runs dry
+class thread_pool
+{
+public:
+    explicit thread_pool(unsigned num_workers)
+    {
+        //the last queue is filled by callers of parallel_for
+        for (unsigned i = 0; i <= num_workers; i++)
+        {
+            queues.push_back(std::make_unique<task_queue>());
+        }
+        for (unsigned i = 0; i < num_workers; i++)
+        {
+            workers.emplace_back([this, i] { work(i); });
+        }
+    }
+
+    ~thread_pool()
+    {
+        {
+            std::lock_guard lock(wake_mtx);
+            stop = true;
+        }
+        wake_cv.notify_all();
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    //number of threads that run tasks during parallel_for, the caller included
+    size_t size() const
+    {
+        return workers.size() + 1;
+    }
+
+    //runs fn(i) for every i in [0, count) and returns once all of them are done
+    //the calling thread runs tasks too, so nesting parallel_for inside a task is fine
+    //if fn throws, the tasks that haven't started are skipped and the first exception is
+    //rethrown once every task is done, so none of them is left pointing at this frame
+    void parallel_for(size_t count, const std::function<void(size_t)>& fn)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        size_t remaining = count;
+        std::exception_ptr error; //guarded by done_mtx like remaining
+        std::atomic<bool> failed = false;
+        std::mutex done_mtx;
+        std::condition_variable done_cv;
+        for (size_t i = 0; i < count; i++)
+        {
+            push(i % queues.size(), [&, i]
+            {
+                try
+                {
+                    if (!failed.load(std::memory_order_relaxed))
+                    {
+                        fn(i);
+                    }
+                }
+                catch (...)
+                {
+                    std::lock_guard lock(done_mtx);
+                    if (!error)
+                    {
+                        error = std::current_exception();
+                    }
+                    failed = true;
+                }
+                std::lock_guard lock(done_mtx);
+                if (--remaining == 0)
+                {
+                    done_cv.notify_all();
+                }
+            });
+        }
+
+        std::function<void()> task;
+        while (try_pop(queues.size() - 1, task))
+        {
+            task();
+        }
+        std::unique_lock lock(done_mtx);
+        done_cv.wait(lock, [&] { return remaining == 0; });
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct task_queue
+    {
+        std::mutex mtx;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<task_queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex wake_mtx;
+    std::condition_variable wake_cv;
+    size_t pending = 0; //tasks pushed but not popped yet, guarded by wake_mtx
+    bool stop = false;
+
+    void push(size_t queue, std::function<void()> task)
+    {
+        {
+            std::lock_guard lock(queues[queue]->mtx);
+            queues[queue]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard lock(wake_mtx);
+            ++pending;
+        }
+        wake_cv.notify_one();
+    }
+
+    //own queue first (newest task), then steal the oldest task of the others
+    bool try_pop(size_t own, std::function<void()>& task)
+    {
+        for (size_t i = 0; i < queues.size(); i++)
+        {
+            auto& q = *queues[(own + i) % queues.size()];
+            std::lock_guard lock(q.mtx);
+            if (q.tasks.empty())
+            {
+                continue;
+            }
+            if (i == 0)
+            {
+                task = std::move(q.tasks.back());
+                q.tasks.pop_back();
+            }
+            else
+            {
+                task = std::move(q.tasks.front());
+                q.tasks.pop_front();
+            }
+            std::lock_guard wake_lock(wake_mtx);
+            --pending;
+            return true;
+        }
+        return false;
+    }
+
+    void work(size_t id)
+    {
+        std::function<void()> task;
+        for (;;)
+        {
+            if (try_pop(id, task))
+            {
+                task();
+                continue;
+            }
+            std::unique_lock lock(wake_mtx);
+            wake_cv.wait(lock, [&] { return stop || pending > 0; });
+            if (stop && pending == 0)
+            {
+                return;
+            }
+        }
+    }
+};
+
+thread_pool& get_thread_pool()
+{
+    static thread_pool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+#ifndef HEADLESS_ONLY
+SDL_Window* create_centered_window(uint32_t width, uint32_t height, const char* title)
+{
+    // Get current device's Display Mode to calculate window position
+    SDL_DisplayMode DM;
+    SDL_GetCurrentDisplayMode(0, &DM);
+
+    // Calculate where the upper-left corner of a centered window will be
+    const int32_t x = DM.w / 2 - width / 2;
+    const int32_t y = DM.h / 2 - height / 2;
+
+    // Create the SDL window
+    SDL_Window* pWindow = SDL_CreateWindow(title, x, y, screen_w, screen_h,
+        SDL_WINDOW_ALLOW_HIGHDPI);
+
+    return pWindow;
+}
+
+//free and terminate
+[[noreturn]] void shutdown(SDL_Window** ppWindow, SDL_Renderer** ppRenderer, SDL_Texture** ppTexture)
+{
+    if (ppTexture) { SDL_DestroyTexture(*ppTexture); }
+    if (ppRenderer) { SDL_DestroyRenderer(*ppRenderer); }
+    if (ppWindow) { SDL_DestroyWindow(*ppWindow); }
+    exit(0);
+}
+
+class SDL_error : public std::runtime_error
+{
+public:
+    explicit SDL_error(const std::string& what) : std::runtime_error(what) {}
+    explicit SDL_error(const char* what) : std::runtime_error(what) {}
+};
+#endif
+
+//from https://stackoverflow.com/a/27030598
+template<typename T>
+std::vector<double> linspace(T start_in, T end_in, int num_in)
+{
+    std::vector<double> linspaced;
+    linspaced.reserve(num_in);
+
+    double start = static_cast<double>(start_in);
+    double end = static_cast<double>(end_in);
+    double num = static_cast<double>(num_in);
+
+    if (num == 0) { return linspaced; }
+    if (num == 1)
+    {
+        linspaced.push_back(start);
+        return linspaced;
+    }
+
+    double delta = (end - start) / (num - 1);
+
+    for (int i = 0; i < num - 1; ++i)
+    {
+        linspaced.push_back(start + delta * i);
+    }
+    linspaced.push_back(end); // I want to ensure that start and end
+                              // are exactly the same as the input
+    return linspaced;
+}
+
+double dist_2d(pt_2d a, pt_2d b)
+{
+    return std::sqrt((b.x - a.x) * (b.x - a.x) + (b.y - a.y) * (b.y - a.y));
+}
+
+//creates the grid and axis, every pixel is written so no clearing is needed first
+//goes row by row, grid rows are one fill and the rest only touch the grid columns
+void create_canvas(pixel_buffer buf)
+{
+    PROFILE_SCOPE("create_canvas");
+    for (int y = 0; y < buf.h; y++)
+    {
+        uint32_t* row = buf.data + static_cast<size_t>(y) * buf.w;
+        if (y == buf.h / 2)
+        {
+            std::fill(row, row + buf.w, red); //x axis
+            continue;
+        }
+        if (y > 0 && y % grid_spacing == 0)
+        {
+            std::fill(row, row + buf.w, green);
+        }
+        else
+        {
+            std::fill(row, row + buf.w, black);
+            for (int x = grid_spacing; x < buf.w; x += grid_spacing)
+            {
+                row[x] = green;
+            }
+        }
+        row[buf.w / 2] = red; //y axis
+    }
+}
+
+//fills the gap between two points with a line
+//only rows in [row_begin, row_end) are written
+//replaced by draw_line, kept as the reference it is benchmarked against
+void fill_gaps(pixel_buffer buf, pt_2d a, pt_2d b, int max, int row_begin, int row_end)
+{
+    PROFILE_SCOPE("fill_gaps");
+    const double dist = dist_2d(a, b);
+    if (dist > 2 && dist < max)
+    {
+        std::vector<double> xvec = linspace(a.x, b.x, std::round(dist) + 1);
+        std::vector<double> yvec = linspace(a.y, b.y, std::round(dist) + 1);
+        for (int i = 0; i < xvec.size(); i++)
+        {
+            int ix = std::round(xvec[i]);
+            int iy = std::round(yvec[i]);
+            if (buf.inside(ix, iy) && iy >= row_begin && iy < row_end)
+            {
+                buf.data[ix + (iy * buf.w)] = yellow;
+            }
+        }
+    }
+}
+
+//cohen-sutherland, clips a-b to the pixels buf.inside() accepts, false if nothing is left
+bool clip_line(pixel_buffer buf, double& ax, double& ay, double& bx, double& by)
+{
+    enum { LEFT = 1, RIGHT = 2, TOP = 4, BOTTOM = 8 };
+    const double x_min = 1.0;
+    const double y_min = 1.0;
+    const double x_max = buf.w - 2.0;
+    const double y_max = buf.h - 2.0;
+    const auto outcode = [&](double x, double y)
+    {
+        int code = 0;
+        code |= x < x_min ? LEFT : x > x_max ? RIGHT : 0;
+        code |= y < y_min ? TOP : y > y_max ? BOTTOM : 0;
+        return code;
+    };
+
+    int code_a = outcode(ax, ay);
+    int code_b = outcode(bx, by);
+    //each end crosses at most two edges, more rounds only happen when rounding
+    //keeps a point a hair outside a corner and then nothing visible is lost
+    for (int round = 0; round < 4; round++)
+    {
+        if (!(code_a | code_b))
+        {
+            return true;
+        }
+        if (code_a & code_b)
+        {
+            return false;
+        }
+        //move the outside end onto the edge it is past
+        const int code = code_a ? code_a : code_b;
+        double x, y;
+        if (code & TOP)
+        {
+            x = ax + (bx - ax) * (y_min - ay) / (by - ay);
+            y = y_min;
+        }
+        else if (code & BOTTOM)
+        {
+            x = ax + (bx - ax) * (y_max - ay) / (by - ay);
+            y = y_max;
+        }
+        else if (code & RIGHT)
+        {
+            y = ay + (by - ay) * (x_max - ax) / (bx - ax);
+            x = x_max;
+        }
+        else
+        {
+            y = ay + (by - ay) * (x_min - ax) / (bx - ax);
+            x = x_min;
+        }
+        if (code == code_a)
+        {
+            ax = x;
+            ay = y;
+            code_a = outcode(ax, ay);
+        }
+        else
+        {
+            bx = x;
+            by = y;
+            code_b = outcode(bx, by);
+        }
+    }
+    return !(code_a | code_b);
+}
+
+//draws a-b with color into the rows [row_begin, row_end) of buf without allocating
+//the line is clipped to the drawable area and then every row gets its run of pixels
+//from a closed form of the bresenham steps, so a band only visits its own rows and
+//drawing a line band by band gives exactly the pixels of drawing it in one go
+void draw_line(pixel_buffer buf, pt_2d a, pt_2d b, uint32_t color, int row_begin, int row_end)
+{
+    double ax = a.x, ay = a.y, bx = b.x, by = b.y;
+    if (!clip_line(buf, ax, ay, bx, by))
+    {
+        return;
+    }
+    //step along y, so rows come in increasing order
+    if (ay > by)
+    {
+        std::swap(ax, bx);
+        std::swap(ay, by);
+    }
+    const int x0 = static_cast<int>(std::round(ax));
+    const int y0 = static_cast<int>(std::round(ay));
+    const int x1 = static_cast<int>(std::round(bx));
+    const int y1 = static_cast<int>(std::round(by));
+    const int sx = x1 < x0 ? -1 : 1;
+    const int64_t adx = std::abs(x1 - x0);
+    const int64_t ady = y1 - y0;
+    const int first = std::max(y0, row_begin);
+    const int last = std::min(y1, row_end - 1);
+
+    if (adx <= ady)
+    {
+        //one pixel per row, x rounded to the nearest column
+        const int64_t den = 2 * std::max<int64_t>(ady, 1); //a single point has ady 0
+        for (int y = first; y <= last; y++)
+        {
+            const int64_t k = y - y0;
+            const int x = x0 + sx * static_cast<int>((2 * k * adx + ady) / den);
+            buf.data[x + static_cast<size_t>(y) * buf.w] = color;
+        }
+        return;
+    }
+    //first step along x that lands on row y0 + m
+    const auto row_start = [&](int64_t m) -> int64_t
+    {
+        if (m <= 0)
+        {
+            return 0;
+        }
+        if (m > ady)
+        {
+            return adx + 1;
+        }
+        return ((2 * m - 1) * adx + 2 * ady - 1) / (2 * ady);
+    };
+    for (int y = first; y <= last; y++)
+    {
+        const int64_t begin = row_start(y - y0);
+        const int64_t end = row_start(y - y0 + 1);
+        const int xa = x0 + sx * static_cast<int>(begin);
+        const int xb = x0 + sx * static_cast<int>(end - 1);
+        uint32_t* row = buf.data + static_cast<size_t>(y) * buf.w;
+        std::fill(row + std::min(xa, xb), row + std::max(xa, xb) + 1, color);
+    }
+}
+
+//mixes color over dst, coverage from 0 to 1
+//alpha is mixed like the other channels, so on a transparent layer the
+//result is the color premultiplied by its coverage
+void blend(uint32_t& dst, uint32_t color, double coverage)
+{
+    const uint32_t alpha = static_cast<uint32_t>(coverage * 256.0);
+    const uint32_t rb = ((color & 0xFF00FF) * alpha + (dst & 0xFF00FF) * (256 - alpha)) >> 8;
+    const uint32_t ag = ((color >> 8 & 0xFF00FF) * alpha + (dst >> 8 & 0xFF00FF) * (256 - alpha));
+    dst = (ag & 0xFF00FF00) | (rb & 0xFF00FF);
+}
+
+//premultiplied src over dst
+uint32_t over(uint32_t src, uint32_t dst)
+{
+    const uint32_t a = src >> 24;
+    const uint32_t keep = 256 - (a + (a >> 7)); //255 - a scaled to 256 - 0
+    const uint32_t rb = ((dst & 0xFF00FF) * keep >> 8) & 0xFF00FF;
+    const uint32_t ag = ((dst >> 8 & 0xFF00FF) * keep) & 0xFF00FF00;
+    return src + (rb | ag);
+}
+
+//xiaolin wu's anti-aliased line from a to b blended into the rows [row_begin, row_end)
+//each step along the major axis splits the color between the two pixels the line
+//passes between, the end at b isn't drawn so joined segments don't blend a pixel twice
+//unless clipping moved it, then nothing else draws that pixel
+void draw_line_aa(pixel_buffer buf, double ax, double ay, double bx, double by, uint32_t color, int row_begin, int row_end)
+{
+    const double unclipped_bx = bx;
+    const double unclipped_by = by;
+    if (!clip_line(buf, ax, ay, bx, by))
+    {
+        return;
+    }
+    const bool clipped_end = bx != unclipped_bx || by != unclipped_by;
+    const bool steep = std::abs(by - ay) > std::abs(bx - ax);
+    //plot in (major, minor) coordinates, swapped back for steep lines
+    const auto plot = [&](int major, int minor, double coverage)
+    {
+        const int x = steep ? minor : major;
+        const int y = steep ? major : minor;
+        if (buf.inside(x, y) && y >= row_begin && y < row_end)
+        {
+            blend(buf.data[x + static_cast<size_t>(y) * buf.w], color, coverage);
+        }
+    };
+    if (steep)
+    {
+        std::swap(ax, ay);
+        std::swap(bx, by);
+    }
+    const int step = bx < ax ? -1 : 1;
+    const double gradient = bx == ax ? 0.0 : (by - ay) / (bx - ax);
+    const int begin = static_cast<int>(std::round(ax));
+    const int end = static_cast<int>(std::round(bx)) + (clipped_end ? step : 0);
+
+    //only visit the steps that can land in the rows of this band
+    int lo = std::min(begin, end);
+    int hi = std::max(begin, end);
+    if (steep)
+    {
+        lo = std::max(lo, row_begin);
+        hi = std::min(hi, row_end - 1);
+    }
+    else if (gradient != 0.0)
+    {
+        const double xa = ax + (row_begin - 1 - ay) / gradient;
+        const double xb = ax + (row_end - ay) / gradient;
+        lo = std::max(lo, static_cast<int>(std::floor(std::min(xa, xb))) - 1);
+        hi = std::min(hi, static_cast<int>(std::ceil(std::max(xa, xb))) + 1);
+    }
+    const int from = step > 0 ? std::max(begin, lo) : std::min(begin, hi);
+    const int to = step > 0 ? std::min(end, hi + 1) : std::max(end, lo - 1);
+    for (int major = from; (to - major) * step > 0; major += step)
+    {
+        const double minor = ay + gradient * (major - ax);
+        const double base = std::floor(minor);
+        const double frac = minor - base;
+        plot(major, static_cast<int>(base), 1.0 - frac);
+        plot(major, static_cast<int>(base) + 1, frac);
+    }
+}
+
+//maps a point of the graph to a pixel, huge and nan values end up off screen
+//the x range spans the width and y uses the same scale
+pt_2d to_screen(pixel_buffer buf, double tx, double ty, int range_upper)
+{
+    tx *= (buf.w / static_cast<double>(range_upper));
+    ty *= (buf.w / static_cast<double>(range_upper));
+    if (!(std::abs(ty) < 1e6))
+    {
+        ty = std::copysign(1e6, ty);
+    }
+
+    int ix = -std::round(tx / 2.0);
+    int iy = std::round(ty / 2.0);
+
+    ix += buf.w / 2;
+    iy += buf.h / 2;
+    return { ix, iy };
+}
+
+//sample of a curve with its position on screen in (sub)pixels
+struct curve_sample
+{
+    double x, y;
+    double sx, sy;
+    bool connected; //draw a line from the previous sample to this one
+};
+
+//one line or point to draw, pixel is the sample itself and
+//a-b is the connecting line already clipped to the screen rows
+struct plot_segment
+{
+    pt_2d pixel;
+    double ax, ay, bx, by;
+    bool line;
+};
+
+//evaluated points of one expression sorted by x, kept across plots so that overlapping
+//ranges and finer levels of the dyadic sample grid only evaluate what is new
+//lookups can run on several threads at once, adding samples can't run alongside them
+class sample_store
+{
+public:
+    struct store_stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit sample_store(size_t max_bytes = 1 << 20) : max_bytes(max_bytes) {}
+
+    //fills ys[i] for every xs[i] in the store, the indices of the others go to missing
+    void lookup(std::span<const double> xs, std::span<double> ys, std::vector<size_t>& missing) const
+    {
+        missing.clear();
+        //callers ask in ascending x, so every search starts where the last one ended
+        auto it = points.begin();
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            if (it != points.begin() && std::prev(it)->first >= xs[i])
+            {
+                it = points.begin();
+            }
+            it = std::lower_bound(it, points.end(), xs[i], [](const point& p, double x) { return p.first < x; });
+            if (it != points.end() && it->first == xs[i])
+            {
+                ys[i] = it->second;
+            }
+            else
+            {
+                missing.push_back(i);
+            }
+        }
+        hits.fetch_add(xs.size() - missing.size(), std::memory_order_relaxed);
+        misses.fetch_add(missing.size(), std::memory_order_relaxed);
+    }
+
+    //merges the samples of a plot over [lower, upper], then drops the points farthest
+    //from the middle of that range until the store fits into max_bytes
+    void add(std::span<const curve_sample> samples, double lower, double upper)
+    {
+        std::vector<point> merged;
+        merged.reserve(points.size() + samples.size());
+        size_t i = 0;
+        for (const auto& sample : samples)
+        {
+            for (; i < points.size() && points[i].first < sample.x; i++)
+            {
+                merged.push_back(points[i]);
+            }
+            if (i < points.size() && points[i].first == sample.x)
+            {
+                ++i;
+            }
+            if (merged.empty() || merged.back().first < sample.x)
+            {
+                merged.emplace_back(sample.x, sample.y);
+            }
+        }
+        merged.insert(merged.end(), points.begin() + i, points.end());
+        points = std::move(merged);
+
+        const size_t capacity = std::max<size_t>(max_bytes / sizeof(point), 1);
+        if (points.size() > capacity)
+        {
+            const double middle = (lower + upper) / 2.0;
+            const auto center = std::lower_bound(points.begin(), points.end(), middle,
+                                                 [](const point& p, double x) { return p.first < x; });
+            const size_t first = std::min(static_cast<size_t>(std::max<ptrdiff_t>(center - points.begin() - capacity / 2, 0)),
+                                          points.size() - capacity);
+            evictions += points.size() - capacity;
+            points.erase(points.begin() + first + capacity, points.end());
+            points.erase(points.begin(), points.begin() + first);
+        }
+    }
+
+    void clear()
+    {
+        points.clear();
+    }
+
+    store_stats get_stats() const
+    {
+        return { hits.load(std::memory_order_relaxed), misses.load(std::memory_order_relaxed), evictions,
+                 points.size(), points.size() * sizeof(point) };
+    }
+
+private:
+    using point = std::pair<double, double>;
+
+    size_t max_bytes;
+    std::vector<point> points;
+    size_t evictions = 0;
+    mutable std::atomic<size_t> hits = 0;
+    mutable std::atomic<size_t> misses = 0;
+};
+
+//clips the line a-b to the rows of the buffer, false if nothing is left
+bool clip_rows(pixel_buffer buf, double& ax, double& ay, double& bx, double& by)
+{
+    const double top = -1.0;
+    const double bottom = buf.h;
+    if ((ay < top && by < top) || (ay > bottom && by > bottom))
+    {
+        return false;
+    }
+    const auto clip = [&](double& px, double& py, double qx, double qy)
+    {
+        const double edge = py < top ? top : bottom;
+        if (py < top || py > bottom)
+        {
+            px += (qx - px) * (edge - py) / (qy - py);
+            py = edge;
+        }
+    };
+    clip(ax, ay, bx, by);
+    clip(bx, by, ax, ay);
+    return true;
+}
+
+//refines the curve between the samples in [x_begin, x_end] until every
+//line between neighbouring samples is within plot_tolerance pixels of the curve
+//each round evaluates all new midpoints in one batch, intervals that still
+//bend after max_subdivisions rounds are treated as jumps and not connected
+//every x found in the store is taken from there instead of evaluated, which pays off
+//because all sample positions are dyadic and come back exactly at every range and level
+//interval bounds of the function decide which coarse intervals are off screen or undefined
+//and left out, and which are flat enough to need no midpoint at all
+//returns the samples in x order, the number of evaluations is added to evals
+//fewer subdivisions give a rougher curve sooner, the jump test then runs at the last of them
+std::vector<curve_sample> sample_adaptive(pixel_buffer buf, const parser::compiled_func& func, double x_begin, double step,
+                                          size_t num_intervals, int range_upper, size_t& evals,
+                                          const sample_store* store = nullptr, int subdivisions = max_subdivisions)
+{
+    const double scale = buf.w / static_cast<double>(range_upper) / 2.0; //pixels per unit
+    const auto make_sample = [&](double x, double y)
+    {
+        return curve_sample{ x, y, -x * scale + buf.w / 2, y * scale + buf.h / 2, false };
+    };
+    //what the interval bounds of the function between xa and xb guarantee, hidden if it
+    //is undefined throughout or past the same edge of the screen, flat if it is continuous
+    //and less than plot_tolerance pixels high, so a line between the ends is close enough
+    struct bounds
+    {
+        bool hidden;
+        bool flat;
+    };
+    const auto check = [&](double xa, double xb)
+    {
+        const parser::interval y = func.evaluate_interval(parser::interval{ std::min(xa, xb), std::max(xa, xb) });
+        const bool hidden = y.empty() || y.hi * scale + buf.h / 2 < -1.0 || y.lo * scale + buf.h / 2 > buf.h;
+        return bounds{ hidden, !hidden && y.continuous && (y.hi - y.lo) * scale <= plot_tolerance };
+    };
+    //two undefined samples or two samples past the same edge usually have nothing between
+    //them, the bounds make sure, so a spike that comes back into view isn't missed
+    const auto skip = [&](const curve_sample& a, const curve_sample& b)
+    {
+        const bool likely = (std::isnan(a.y) && std::isnan(b.y)) || (a.sy < -1.0 && b.sy < -1.0) || (a.sy > buf.h && b.sy > buf.h);
+        return likely && check(a.x, b.x).hidden;
+    };
+
+    std::vector<double> missing_xs;
+    std::vector<double> missing_ys;
+    std::vector<size_t> missing;
+    const auto evaluate = [&](std::span<const double> xs, std::span<double> ys)
+    {
+        if (!store)
+        {
+            func.evaluate(xs, ys);
+            evals += xs.size();
+            return;
+        }
+        store->lookup(xs, ys, missing);
+        missing_xs.clear();
+        for (const size_t i : missing)
+        {
+            missing_xs.push_back(xs[i]);
+        }
+        missing_ys.resize(missing_xs.size());
+        func.evaluate(missing_xs, missing_ys);
+        evals += missing_xs.size();
+        for (size_t i = 0; i < missing.size(); i++)
+        {
+            ys[missing[i]] = missing_ys[i];
+        }
+    };
+
+    //the bounds of the whole range are usually enough, a curve that is off screen
+    //or flat throughout needs no bounds per coarse interval
+    const bounds whole = check(x_begin, x_begin + step * num_intervals);
+    if (whole.hidden)
+    {
+        return {};
+    }
+    std::vector<bounds> coarse(num_intervals, whole);
+    if (!whole.flat)
+    {
+        for (size_t i = 0; i < num_intervals; i++)
+        {
+            coarse[i] = check(x_begin + step * i, x_begin + step * (i + 1));
+        }
+    }
+
+    //only the ends of coarse intervals that may show are evaluated
+    std::vector<double> xs;
+    std::vector<size_t> index; //coarse index of each of xs
+    for (size_t i = 0; i <= num_intervals; i++)
+    {
+        if ((i > 0 && !coarse[i - 1].hidden) || (i < num_intervals && !coarse[i].hidden))
+        {
+            xs.push_back(x_begin + step * i);
+            index.push_back(i);
+        }
+    }
+    std::vector<double> ys(xs.size());
+    evaluate(xs, ys);
+
+    std::vector<curve_sample> samples;
+    std::vector<uint8_t> pending; //pending[i], the interval ending at samples[i] needs a midpoint
+    for (size_t k = 0; k < xs.size(); k++)
+    {
+        const size_t i = index[k];
+        const bool joined = k > 0 && index[k - 1] + 1 == i && !coarse[i - 1].hidden;
+        samples.push_back(make_sample(xs[k], ys[k]));
+        const bool finite = joined && std::isfinite(ys[k]) && std::isfinite(ys[k - 1]);
+        samples.back().connected = finite;
+        pending.push_back(joined && !(finite && coarse[i - 1].flat));
+    }
+
+    for (int depth = 0; depth < subdivisions; depth++)
+    {
+        xs.clear();
+        for (size_t i = 1; i < samples.size(); i++)
+        {
+            if (pending[i])
+            {
+                xs.push_back((samples[i - 1].x + samples[i].x) / 2.0);
+            }
+        }
+        if (xs.empty())
+        {
+            break;
+        }
+        ys.resize(xs.size());
+        evaluate(xs, ys);
+
+        const bool last = depth + 1 == subdivisions;
+        std::vector<curve_sample> next;
+        std::vector<uint8_t> next_pending;
+        next.reserve(samples.size() + xs.size());
+        size_t m = 0;
+        for (size_t i = 0; i < samples.size(); i++)
+        {
+            if (!pending[i])
+            {
+                next.push_back(samples[i]);
+                next_pending.push_back(0);
+                continue;
+            }
+            const curve_sample& a = samples[i - 1];
+            curve_sample b = samples[i];
+            curve_sample mid = make_sample(xs[m], ys[m]);
+            ++m;
+
+            const bool finite = std::isfinite(a.y) && std::isfinite(mid.y) && std::isfinite(b.y);
+            const double error = std::abs(mid.sy - (a.sy + b.sy) / 2.0);
+            const bool done = finite && error <= plot_tolerance;
+            if (done || !last)
+            {
+                mid.connected = std::isfinite(a.y) && std::isfinite(mid.y);
+                b.connected = std::isfinite(mid.y) && std::isfinite(b.y);
+            }
+            else
+            {
+                //still bending at the finest step, a continuous curve splits its rise
+                //between both halves while a jump keeps nearly all of it in one
+                const double total = std::abs(b.sy - a.sy);
+                mid.connected = std::isfinite(a.y) && std::isfinite(mid.y) && std::abs(mid.sy - a.sy) < 0.9 * total;
+                b.connected = std::isfinite(mid.y) && std::isfinite(b.y) && std::abs(b.sy - mid.sy) < 0.9 * total;
+            }
+            next.push_back(mid);
+            next_pending.push_back(!done && !last && !skip(a, mid));
+            next.push_back(b);
+            next_pending.push_back(!done && !last && !skip(mid, b));
+        }
+        samples = std::move(next);
+        pending = std::move(next_pending);
+    }
+    return samples;
+}
+
+//coarse intervals each plotting task refines
+constexpr size_t plot_chunk_intervals = 16;
+
+//one curve for plot_jobs, drawn in color into target
+struct plot_job
+{
+    const parser::compiled_func* func;
+    pixel_buffer target;
+    uint32_t color = yellow;
+    const sample_store* store = nullptr; //earlier samples of the function, see sample_adaptive
+    std::vector<curve_sample>* samples = nullptr; //if set, receives every sample in x order
+    int subdivisions = max_subdivisions;
+
+    //filled in by plot_jobs
+    size_t evals = 0;
+    int row_begin = 0; //rows that may have been drawn on
+    int row_end = 0;
+};
+
+//lets whoever asked for a plot call it off, the work is stale once latest
+//has moved past the generation it was started for
+struct cancel_token
+{
+    const std::atomic<uint64_t>* latest = nullptr; //nullptr never cancels
+    uint64_t generation = 0;
+
+    bool cancelled() const
+    {
+        return latest && latest->load(std::memory_order_relaxed) != generation;
+    }
+};
+
+//plot every job across the range lower to upper, returns the number of evaluations
+//once cancel fires the remaining chunks and bands are skipped, what was drawn until then stays
+//each curve is split into chunks of coarse intervals that are refined in parallel by
+//sample_adaptive, then each horizontal band of the screen is drawn by one task, so no
+//two tasks ever write the same pixel and the result doesn't depend on scheduling
+//all targets need the same size
+size_t plot_jobs(std::span<plot_job> jobs, int range_lower, int range_upper, thread_pool& pool = get_thread_pool(),
+                 const cancel_token& cancel = {})
+{
+    if (jobs.empty())
+    {
+        return 0;
+    }
+    const pixel_buffer buf = jobs[0].target;
+    const int num_bands = static_cast<int>(pool.size());
+    const int band_h = (buf.h + num_bands - 1) / num_bands;
+
+    //power of two spacing, so midpoints at every level are exact in binary
+    const double px_per_unit = buf.w / static_cast<double>(range_upper) / 2.0;
+    const double step = std::exp2(std::floor(std::log2(coarse_step_px / px_per_unit)));
+    const double x_first = std::floor(range_lower / step) * step;
+    const size_t num_intervals = static_cast<size_t>(std::ceil((range_upper - x_first) / step));
+
+    struct chunk
+    {
+        size_t job;
+        size_t begin; //first coarse interval
+        size_t count;
+        size_t first = 0; //samples before this one belong to the previous chunk
+        size_t evals = 0;
+        int row_begin = std::numeric_limits<int>::max();
+        int row_end = 0;
+        std::vector<curve_sample> samples{}; //only kept if the job wants them
+        std::vector<plot_segment> segments{};
+        std::vector<std::vector<uint32_t>> bands{}; //segments that touch each band
+    };
+    std::vector<chunk> chunks;
+    for (size_t job = 0; job < jobs.size(); job++)
+    {
+        for (size_t begin = 0; begin < num_intervals; begin += plot_chunk_intervals)
+        {
+            chunks.push_back({ job, begin, std::min(plot_chunk_intervals, num_intervals - begin) });
+        }
+    }
+
+    pool.parallel_for(chunks.size(), [&](size_t c)
+    {
+        auto& ch = chunks[c];
+        ch.bands.resize(num_bands);
+        if (cancel.cancelled())
+        {
+            return;
+        }
+        PROFILE_SCOPE_COUNT("plot", ch.evals);
+        const plot_job& job = jobs[ch.job];
+        //neighbouring chunks share their boundary sample, only the first one draws it
+        //unless sample_adaptive left the boundary out
+        const double x_begin = x_first + ch.begin * step;
+        auto samples = sample_adaptive(buf, *job.func, x_begin, step, ch.count, range_upper, ch.evals, job.store, job.subdivisions);
+        ch.first = ch.begin != 0 && !samples.empty() && samples[0].x == x_begin ? 1 : 0;
+        for (size_t i = ch.first; i < samples.size(); i++)
+        {
+            const auto& cur = samples[i];
+            plot_segment seg{ to_screen(buf, cur.x, cur.y, range_upper), 0.0, 0.0, 0.0, 0.0, false };
+            int lo = seg.pixel.y;
+            int hi = seg.pixel.y;
+            if (cur.connected)
+            {
+                double ax = samples[i - 1].sx, ay = samples[i - 1].sy, bx = cur.sx, by = cur.sy;
+                if (clip_rows(buf, ax, ay, bx, by))
+                {
+                    seg = { seg.pixel, ax, ay, bx, by, true };
+                    lo = std::min(lo, static_cast<int>(std::floor(std::min(ay, by))));
+                    hi = std::max(hi, static_cast<int>(std::ceil(std::max(ay, by))) + 1);
+                }
+            }
+            lo = std::max(lo, 0);
+            hi = std::min(hi, buf.h - 1);
+            if (lo <= hi)
+            {
+                ch.row_begin = std::min(ch.row_begin, lo);
+                ch.row_end = std::max(ch.row_end, hi + 1);
+            }
+            for (int band = lo / band_h; lo <= hi && band <= hi / band_h; band++)
+            {
+                ch.bands[band].push_back(static_cast<uint32_t>(ch.segments.size()));
+            }
+            ch.segments.push_back(seg);
+        }
+        if (job.samples)
+        {
+            ch.samples = std::move(samples);
+        }
+    });
+
+    pool.parallel_for(num_bands, [&](size_t band)
+    {
+        if (cancel.cancelled())
+        {
+            return;
+        }
+        PROFILE_SCOPE("draw");
+        const int row_begin = static_cast<int>(band) * band_h;
+        const int row_end = std::min(buf.h, row_begin + band_h);
+        for (const auto& ch : chunks)
+        {
+            const pixel_buffer target = jobs[ch.job].target;
+            const uint32_t color = jobs[ch.job].color;
+            for (const uint32_t i : ch.bands[band])
+            {
+                const auto& seg = ch.segments[i];
+                const pt_2d p = seg.pixel;
+#ifdef ANTIALIASED_PLOTTING_ENABLED
+                //the line starting at the sample covers it, a solid pixel would stand out
+                if (seg.line)
+                {
+                    draw_line_aa(target, seg.ax, seg.ay, seg.bx, seg.by, color, row_begin, row_end);
+                    continue;
+                }
+#endif
+                if (target.inside(p.x, p.y) && p.y >= row_begin && p.y < row_end)
+                {
+                    target.data[p.x + (p.y * target.w)] = color;
+                }
+                if (seg.line)
+                {
+                    const pt_2d a = { static_cast<int>(std::round(seg.ax)), static_cast<int>(std::round(seg.ay)) };
+                    const pt_2d b = { static_cast<int>(std::round(seg.bx)), static_cast<int>(std::round(seg.by)) };
+                    draw_line(target, a, b, color, row_begin, row_end);
+                }
+            }
+        }
+    });
+
+    size_t evals = 0;
+    for (auto& job : jobs)
+    {
+        job.evals = 0;
+        job.row_begin = buf.h;
+        job.row_end = 0;
+        if (job.samples)
+        {
+            job.samples->clear();
+        }
+    }
+    for (auto& ch : chunks)
+    {
+        plot_job& job = jobs[ch.job];
+        job.evals += ch.evals;
+        job.row_begin = std::min(job.row_begin, ch.row_begin);
+        job.row_end = std::max(job.row_end, ch.row_end);
+        if (job.samples)
+        {
+            job.samples->insert(job.samples->end(), ch.samples.begin() + ch.first, ch.samples.end());
+        }
+        evals += ch.evals;
+    }
+    return evals;
+}
+
+//plot every function in yellow across the range lower to upper, returns the number of evaluations
+size_t plot_all(pixel_buffer buf, int range_lower, int range_upper, std::span<const parser::compiled_func* const> funcs,
+                thread_pool& pool = get_thread_pool())
+{
+    std::vector<plot_job> jobs;
+    for (const auto* func : funcs)
+    {
+        jobs.push_back({ func, buf });
+    }
+    return plot_jobs(jobs, range_lower, range_upper, pool);
+}
+
+//plot the function across the range lower to upper, returns the number of evaluations
+size_t plot(pixel_buffer buf, int range_lower, int range_upper, const parser::compiled_func& func)
+{
+    const parser::compiled_func* funcs[] = { &func };
+    return plot_all(buf, range_lower, range_upper, funcs);
+}
+
+//side of the square tiles a field is evaluated in, three columns of
+//field_tile^2 doubles (x, y and the result) stay within the l2 cache
+constexpr int field_tile = 64;
+
+//heatmaps are blended over the canvas so the grid still shows through
+constexpr uint32_t heatmap_alpha = 0xC0;
+
+enum class field_mode
+{
+    HEATMAP,  //every pixel colored by the value of f(x, y)
+    IMPLICIT  //the curve f(x, y) = 0
+};
+
+//t from 0 to 1 on a dark blue, blue, cyan, yellow, red ramp, premultiplied with heatmap_alpha
+uint32_t heatmap_color(double t)
+{
+    static const std::array<uint32_t, 256> table = []
+    {
+        constexpr uint32_t stops[] = { 0x000020, 0x0040FF, 0x00FFFF, 0xFFFF00, 0xFF0000 };
+        constexpr int segments = std::size(stops) - 1;
+        std::array<uint32_t, 256> res{};
+        for (int i = 0; i < 256; i++)
+        {
+            const double pos = i / 255.0 * segments;
+            const int seg = std::min(static_cast<int>(pos), segments - 1);
+            const double f = pos - seg;
+            uint32_t color = heatmap_alpha << 24;
+            for (int shift = 0; shift < 24; shift += 8)
+            {
+                const double a = stops[seg] >> shift & 0xFF;
+                const double b = stops[seg + 1] >> shift & 0xFF;
+                color |= static_cast<uint32_t>(std::lround((a + (b - a) * f) * heatmap_alpha / 255.0)) << shift;
+            }
+            res[i] = color;
+        }
+        return res;
+    }();
+    return table[static_cast<int>(std::clamp(t, 0.0, 1.0) * 255.0 + 0.5)];
+}
+
+//evaluates the function of x and y (in that slot order) at every pixel of
+//a w by h grid, with the same axes as to_screen, into values (row major)
+//square tiles are evaluated as struct of arrays batches in parallel, so one
+//tile's columns stay in cache while every instruction runs over them
+//returns the lowest and highest finite value, or NaN if there are none
+//tiles left once cancel fires aren't evaluated, values and the range are garbage then
+std::pair<double, double> evaluate_field(int w, int h, int range_upper, const parser::compiled_func& func,
+                                         std::vector<double>& values, thread_pool& pool = get_thread_pool(),
+                                         const cancel_token& cancel = {})
+{
+    values.resize(static_cast<size_t>(w) * h);
+    const double scale = w / static_cast<double>(range_upper) / 2.0; //pixels per unit
+    const int tiles_x = (w + field_tile - 1) / field_tile;
+    const int tiles_y = (h + field_tile - 1) / field_tile;
+    std::vector<std::pair<double, double>> ranges(static_cast<size_t>(tiles_x) * tiles_y);
+
+    pool.parallel_for(ranges.size(), [&](size_t tile)
+    {
+        if (cancel.cancelled())
+        {
+            return;
+        }
+        const int x0 = static_cast<int>(tile % tiles_x) * field_tile;
+        const int y0 = static_cast<int>(tile / tiles_x) * field_tile;
+        const int tw = std::min(field_tile, w - x0);
+        const int th = std::min(field_tile, h - y0);
+        std::vector<double> xs(static_cast<size_t>(tw) * th);
+        std::vector<double> ys(xs.size());
+        std::vector<double> out(xs.size());
+        for (int y = 0; y < th; y++)
+        {
+            for (int x = 0; x < tw; x++)
+            {
+                xs[y * tw + x] = (w / 2 - (x0 + x)) / scale;
+                ys[y * tw + x] = (y0 + y - h / 2) / scale;
+            }
+        }
+        const double* columns[] = { xs.data(), ys.data() };
+        func.evaluate(columns, xs.size(), out);
+
+        double lo = std::numeric_limits<double>::infinity();
+        double hi = -lo;
+        for (int y = 0; y < th; y++)
+        {
+            const double* row = out.data() + y * tw;
+            std::memcpy(values.data() + static_cast<size_t>(y0 + y) * w + x0, row, tw * sizeof(double));
+            for (int x = 0; x < tw; x++)
+            {
+                if (std::isfinite(row[x]))
+                {
+                    lo = std::min(lo, row[x]);
+                    hi = std::max(hi, row[x]);
+                }
+            }
+        }
+        ranges[tile] = { lo, hi };
+    });
+
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -lo;
+    for (const auto& [tile_lo, tile_hi] : ranges)
+    {
+        lo = std::min(lo, tile_lo);
+        hi = std::max(hi, tile_hi);
+    }
+    if (lo > hi)
+    {
+        return { std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN() };
+    }
+    return { lo, hi };
+}
+
+//plots the function of x and y over the whole buffer, returns the number of evaluations
+//a heatmap is blended over every pixel where the function is finite, lowest value blue
+//and highest red, an implicit curve is traced by marching squares through the cells
+//between neighbouring pixels and drawn in color
+//both passes split the buffer into bands of tile rows, an implicit band also
+//traces the cell row above it, so every band only draws into its own rows
+//a cancelled field is left half drawn
+size_t plot_field(pixel_buffer buf, int range_upper, const parser::compiled_func& func, field_mode mode,
+                  uint32_t color = yellow, thread_pool& pool = get_thread_pool(), const cancel_token& cancel = {})
+{
+    const size_t evals = static_cast<size_t>(buf.w) * buf.h; //evaluate_field does every pixel
+    PROFILE_SCOPE_COUNT("plot_field", evals);
+    std::vector<double> values;
+    const auto [lo, hi] = evaluate_field(buf.w, buf.h, range_upper, func, values, pool, cancel);
+    const int num_bands = (buf.h + field_tile - 1) / field_tile;
+    if (cancel.cancelled())
+    {
+        return evals;
+    }
+
+    if (mode == field_mode::HEATMAP)
+    {
+        const double inv_range = hi > lo ? 1.0 / (hi - lo) : 0.0;
+        pool.parallel_for(num_bands, [&](size_t band)
+        {
+            const size_t begin = band * field_tile * static_cast<size_t>(buf.w);
+            const size_t end = std::min<size_t>(begin + field_tile * static_cast<size_t>(buf.w), values.size());
+            for (size_t i = begin; i < end; i++)
+            {
+                if (std::isfinite(values[i]))
+                {
+                    buf.data[i] = over(heatmap_color((values[i] - lo) * inv_range), buf.data[i]);
+                }
+            }
+        });
+        return evals;
+    }
+
+    pool.parallel_for(num_bands, [&](size_t band)
+    {
+        if (cancel.cancelled())
+        {
+            return;
+        }
+        const int row_begin = static_cast<int>(band) * field_tile;
+        const int row_end = std::min(buf.h, row_begin + field_tile);
+        const auto value = [&](int x, int y) { return values[static_cast<size_t>(y) * buf.w + x]; };
+        const auto line = [&](double ax, double ay, double bx, double by)
+        {
+#ifdef ANTIALIASED_PLOTTING_ENABLED
+            draw_line_aa(buf, ax, ay, bx, by, color, row_begin, row_end);
+#else
+            draw_line(buf, { static_cast<int>(std::round(ax)), static_cast<int>(std::round(ay)) },
+                      { static_cast<int>(std::round(bx)), static_cast<int>(std::round(by)) }, color, row_begin, row_end);
+#endif
+        };
+        //cell (x, y) has the pixels (x, y) to (x + 1, y + 1) as corners
+        for (int y = std::max(row_begin - 1, 0); y < std::min(row_end, buf.h - 1); y++)
+        {
+            for (int x = 0; x + 1 < buf.w; x++)
+            {
+                const double v[4] = { value(x, y), value(x + 1, y), value(x + 1, y + 1), value(x, y + 1) };
+                if (!std::isfinite(v[0]) || !std::isfinite(v[1]) || !std::isfinite(v[2]) || !std::isfinite(v[3]))
+                {
+                    continue;
+                }
+                const int cell = (v[0] > 0) | (v[1] > 0) << 1 | (v[2] > 0) << 2 | (v[3] > 0) << 3;
+                if (cell == 0 || cell == 15)
+                {
+                    continue;
+                }
+                //where the zero crosses edge e, which runs from corner e to corner e + 1
+                const auto cross = [&](int e, double& px, double& py)
+                {
+                    constexpr int dx[] = { 0, 1, 1, 0 };
+                    constexpr int dy[] = { 0, 0, 1, 1 };
+                    const int a = e;
+                    const int b = (e + 1) & 3;
+                    const double t = v[a] / (v[a] - v[b]);
+                    px = x + dx[a] + (dx[b] - dx[a]) * t;
+                    py = y + dy[a] + (dy[b] - dy[a]) * t;
+                };
+                //edges a crossing goes between, for each of the 16 corner signs
+                //in the saddles 5 and 10 a positive centre joins the positive corners
+                static constexpr int8_t edges[16][4] = {
+                    { -1, -1, -1, -1 }, { 3, 0, -1, -1 }, { 0, 1, -1, -1 }, { 3, 1, -1, -1 },
+                    { 1, 2, -1, -1 }, { 3, 0, 1, 2 }, { 0, 2, -1, -1 }, { 3, 2, -1, -1 },
+                    { 2, 3, -1, -1 }, { 0, 2, -1, -1 }, { 0, 1, 2, 3 }, { 1, 2, -1, -1 },
+                    { 1, 3, -1, -1 }, { 0, 1, -1, -1 }, { 3, 0, -1, -1 }, { -1, -1, -1, -1 } };
+                int8_t e[4] = { edges[cell][0], edges[cell][1], edges[cell][2], edges[cell][3] };
+                if ((cell == 5 || cell == 10) && v[0] + v[1] + v[2] + v[3] > 0)
+                {
+                    std::swap(e[1], e[3]);
+                }
+                for (int k = 0; k < 4 && e[k] >= 0; k += 2)
+                {
+                    double ax, ay, bx, by;
+                    cross(e[k], ax, ay);
+                    cross(e[k + 1], bx, by);
+                    line(ax, ay, bx, by);
+                }
+            }
+        }
+    });
+    return evals;
+}
+
+//color with its alpha and channels scaled by coverage, premultiplied
+uint32_t tint(uint32_t color, uint32_t coverage)
+{
+    const uint32_t scale = coverage + (coverage >> 7); //0-255 to 0-256
+    const uint32_t rb = ((color & 0xFF00FF) * scale >> 8) & 0xFF00FF;
+    const uint32_t ag = ((color >> 8 & 0xFF00FF) * scale) & 0xFF00FF00;
+    return rb | ag;
+}
+
+//how thoroughly layered_canvas::update plots
+enum class plot_pass
+{
+    PREVIEW, //graphs with few subdivisions, to show something right away
+    FULL
+};
+
+//a curve kept on screen with what it took to draw it
+//the raster is drawn in white so its alpha is the coverage, the color is only applied
+//when composing, and pixels lists the covered pixels so composing skips everything else
+struct curve_layer
+{
+    std::shared_ptr<const parser::compiled_func> func;
+    uint32_t color = yellow;
+    bool visible = true;
+    bool dirty = true; //has to be plotted again for the current viewport
+    bool current = false; //raster shows the current viewport, if only as a preview
+    std::shared_ptr<sample_store> store{}; //every sample plotted so far, reused by the next plot
+    std::optional<field_mode> field{}; //set for functions of x and y, which are drawn by plot_field
+    std::vector<uint32_t> raster{}; //a heatmap keeps its colors here and is composed from it whole
+    int row_begin = 0; //rows of raster that may be drawn on
+    int row_end = 0;
+    std::vector<std::pair<uint32_t, uint8_t>> pixels{}; //index and coverage
+};
+
+//the picture in the window is stacked from layers
+//background holds the grid and axes and is only drawn when the viewport or size changes,
+//every curve and field has its own layer that is only plotted again when the viewport changes
+//(a curve reusing the samples in its store) and the overlay starts out transparent (0)
+//background + visible curves is kept composed, so a frame where only the overlay
+//changed is one copy plus the overlay and hiding, recoloring or removing a
+//curve composes again without evaluating anything
+class layered_canvas
+{
+public:
+    layered_canvas(int w, int h)
+    {
+        resize(w, h);
+    }
+
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        background_pixels.assign(static_cast<size_t>(w) * h, black);
+        base_pixels.assign(background_pixels.size(), black);
+        overlay_pixels.assign(background_pixels.size(), 0);
+        for (auto& curve : curve_layers)
+        {
+            curve.raster.clear();
+            curve.dirty = true;
+            curve.current = false;
+        }
+        background_valid = false;
+        base_valid = false;
+    }
+
+    //the background is only redrawn and the curves plotted again when the range changes
+    void set_viewport(int range_lower, int range_upper)
+    {
+        if (range_lower != lower || range_upper != upper)
+        {
+            lower = range_lower;
+            upper = range_upper;
+            background_valid = false;
+            base_valid = false;
+            for (auto& curve : curve_layers)
+            {
+                curve.dirty = true;
+                curve.current = false;
+            }
+        }
+    }
+
+    //returns the index of the new field, it is plotted by the next compose
+    //func takes x and y, color only applies to implicit curves
+    size_t add_field(std::shared_ptr<const parser::compiled_func> func, field_mode mode, uint32_t color)
+    {
+        curve_layers.push_back({ std::move(func), color });
+        curve_layers.back().field = mode;
+        base_valid = false;
+        return curve_layers.size() - 1;
+    }
+
+    //switches a field between heatmap and implicit curve, it is plotted again by the next compose
+    void set_field_mode(size_t i, field_mode mode)
+    {
+        curve_layers[i].field = mode;
+        curve_layers[i].dirty = true;
+        curve_layers[i].current = false;
+        base_valid = false;
+    }
+
+    //returns the index of the new curve, it is plotted by the next compose
+    //a store the function was plotted with before can be passed to be reused
+    size_t add_curve(std::shared_ptr<const parser::compiled_func> func, uint32_t color,
+                     std::shared_ptr<sample_store> store = nullptr)
+    {
+        curve_layers.push_back({ std::move(func), color });
+        curve_layers.back().store = store ? std::move(store) : std::make_shared<sample_store>();
+        base_valid = false;
+        return curve_layers.size() - 1;
+    }
+
+    void remove_curve(size_t i)
+    {
+        curve_layers.erase(curve_layers.begin() + i);
+        base_valid = false;
+    }
+
+    void clear_curves()
+    {
+        curve_layers.clear();
+        base_valid = false;
+    }
+
+    void set_visible(size_t i, bool visible)
+    {
+        curve_layers[i].visible = visible;
+        base_valid = false;
+    }
+
+    void set_color(size_t i, uint32_t color)
+    {
+        curve_layers[i].color = color;
+        base_valid = false;
+    }
+
+    size_t curve_count() const
+    {
+        return curve_layers.size();
+    }
+
+    const curve_layer& curve(size_t i) const
+    {
+        return curve_layers[i];
+    }
+
+    //the stores of all curves added up
+    sample_store::store_stats get_sample_stats() const
+    {
+        sample_store::store_stats res;
+        for (const auto& curve : curve_layers)
+        {
+            const auto stats = curve.store->get_stats();
+            res.hits += stats.hits;
+            res.misses += stats.misses;
+            res.evictions += stats.evictions;
+            res.entries += stats.entries;
+            res.bytes += stats.bytes;
+        }
+        return res;
+    }
+
+    //handing out the overlay counts as drawing on it
+    pixel_buffer overlay()
+    {
+        overlay_used = true;
+        return { overlay_pixels.data(), width, height };
+    }
+
+    void clear_overlay()
+    {
+        std::fill(overlay_pixels.begin(), overlay_pixels.end(), 0);
+        overlay_used = false;
+    }
+
+    //true if update has something to plot
+    bool needs_update() const
+    {
+        return std::ranges::any_of(curve_layers, &curve_layer::dirty);
+    }
+
+    //plots the curves that aren't current for the viewport, all graphs in one go
+    //a PREVIEW pass plots the graphs with preview_subdivisions and leaves them dirty for the
+    //FULL pass, fields are only plotted by that and aren't drawn until then
+    //once cancel fires the layers plotted so far are left out of drawing and stay dirty
+    //returns the number of evaluations
+    size_t update(thread_pool& pool = get_thread_pool(), plot_pass pass = plot_pass::FULL, const cancel_token& cancel = {})
+    {
+        PROFILE_SCOPE("update");
+        const bool preview = pass == plot_pass::PREVIEW;
+        std::vector<size_t> replotted;
+        for (size_t i = 0; i < curve_layers.size(); i++)
+        {
+            if (curve_layers[i].dirty && !(preview && curve_layers[i].field))
+            {
+                replotted.push_back(i);
+            }
+        }
+        if (replotted.empty())
+        {
+            return 0;
+        }
+
+        size_t evals = 0;
+        std::vector<plot_job> jobs;
+        std::vector<size_t> graphs; //curve of every job
+        std::vector<std::vector<curve_sample>> samples(replotted.size());
+        for (const size_t i : replotted)
+        {
+            auto& curve = curve_layers[i];
+            if (curve.raster.empty())
+            {
+                curve.raster.assign(static_cast<size_t>(width) * height, 0);
+            }
+            else
+            {
+                std::fill(curve.raster.begin() + static_cast<size_t>(curve.row_begin) * width,
+                          curve.raster.begin() + static_cast<size_t>(curve.row_end) * width, 0);
+            }
+            const pixel_buffer target{ curve.raster.data(), width, height };
+            if (curve.field)
+            {
+                //fields evaluate every pixel in parallel themselves
+                evals += plot_field(target, upper, *curve.func, *curve.field, white, pool, cancel);
+                curve.row_begin = 0;
+                curve.row_end = height;
+            }
+            else
+            {
+                jobs.push_back({ curve.func.get(), target, white, curve.store.get(), preview ? nullptr : &samples[graphs.size()],
+                                 preview ? preview_subdivisions : max_subdivisions });
+                graphs.push_back(i);
+            }
+        }
+        evals += plot_jobs(jobs, lower, upper, pool, cancel);
+        if (cancel.cancelled())
+        {
+            for (const size_t i : replotted)
+            {
+                auto& curve = curve_layers[i];
+                curve.current = false;
+                curve.row_begin = 0; //no telling what was drawn, all of it is cleared next time
+                curve.row_end = height;
+            }
+            base_valid = false;
+            return evals;
+        }
+        for (size_t k = 0; k < graphs.size(); k++)
+        {
+            auto& curve = curve_layers[graphs[k]];
+            if (!preview)
+            {
+                curve.store->add(samples[k], lower, upper);
+            }
+            curve.row_begin = std::min(jobs[k].row_begin, jobs[k].row_end);
+            curve.row_end = jobs[k].row_end;
+        }
+
+        for (const size_t i : replotted)
+        {
+            auto& curve = curve_layers[i];
+            curve.pixels.clear();
+            curve.dirty = preview;
+            curve.current = true;
+            if (curve.field == field_mode::HEATMAP)
+            {
+                continue;
+            }
+            for (size_t p = static_cast<size_t>(curve.row_begin) * width; p < static_cast<size_t>(curve.row_end) * width; p++)
+            {
+                if (curve.raster[p])
+                {
+                    curve.pixels.emplace_back(static_cast<uint32_t>(p), static_cast<uint8_t>(curve.raster[p] >> 24));
+                }
+            }
+        }
+        base_valid = false;
+        return evals;
+    }
+
+    //plots what is out of date and writes background, curves and overlay into out,
+    //which has to be the same size
+    void compose(pixel_buffer out, thread_pool& pool = get_thread_pool())
+    {
+        update(pool);
+        draw(out);
+    }
+
+    //compose without plotting, layers that aren't current for the viewport are left out
+    void draw(pixel_buffer out)
+    {
+        PROFILE_SCOPE("compose");
+        if (!background_valid)
+        {
+            create_canvas({ background_pixels.data(), width, height });
+            background_valid = true;
+            ++background_builds;
+        }
+        if (!base_valid)
+        {
+            base_pixels = background_pixels;
+            for (const auto& curve : curve_layers)
+            {
+                if (!curve.visible || !curve.current)
+                {
+                    continue;
+                }
+                if (curve.field == field_mode::HEATMAP)
+                {
+                    composite(curve.raster.data(), base_pixels.data(), base_pixels.size());
+                    continue;
+                }
+                for (const auto& [i, coverage] : curve.pixels)
+                {
+                    base_pixels[i] = over(tint(curve.color, coverage), base_pixels[i]);
+                }
+            }
+            base_valid = true;
+        }
+        memcpy(out.data, base_pixels.data(), base_pixels.size() * sizeof(uint32_t));
+        if (overlay_used)
+        {
+            composite(overlay_pixels.data(), out.data, overlay_pixels.size());
+        }
+    }
+
+    //how often the background was drawn, for tests and benchmarks
+    size_t get_background_builds() const
+    {
+        return background_builds;
+    }
+
+private:
+    int width = 0;
+    int height = 0;
+    int lower = 0;
+    int upper = 0;
+    bool background_valid = false;
+    bool base_valid = false; //base_pixels is background + visible curves
+    bool overlay_used = false;
+    size_t background_builds = 0;
+    std::vector<uint32_t> background_pixels;
+    std::vector<uint32_t> base_pixels;
+    std::vector<uint32_t> overlay_pixels;
+    std::vector<curve_layer> curve_layers;
+
+    //src over dst, layers are mostly transparent so 8 pixels are skipped at a time
+    static void composite(const uint32_t* src, uint32_t* dst, size_t count)
+    {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            uint64_t block[4];
+            memcpy(block, src + i, sizeof(block));
+            if ((block[0] | block[1] | block[2] | block[3]) == 0)
+            {
+                continue;
+            }
+            for (size_t k = i; k < i + 8; k++)
+            {
+                if (src[k])
+                {
+                    dst[k] = over(src[k], dst[k]);
+                }
+            }
+        }
+        for (; i < count; i++)
+        {
+            if (src[i])
+            {
+                dst[i] = over(src[i], dst[i]);
+            }
+        }
+    }
+};
+
+//what came with a frame from async_renderer
+struct frame_info
+{
+    uint64_t generation; //of the last change that is in the frame
+    bool refined; //false for the preview that comes first
+    size_t evals; //for this generation so far
+    double plot_seconds; //spent plotting this generation so far
+    double seconds; //since the worker started on this generation
+};
+
+//plots and composes frames on a thread of its own, so the event loop never waits for a plot
+//the canvas belongs to that thread, every change is queued with edit and bumps the generation,
+//which cancels the frame in progress, and all changes queued meanwhile are drawn as one frame
+//every generation is shown as a preview first and refined after
+//ready is called from the worker whenever take_frame has something new, frames are handed
+//over by swapping buffers so nothing is copied
+class async_renderer
+{
+public:
+    async_renderer(int w, int h, std::function<void()> ready, thread_pool& pool = get_thread_pool())
+        : width(w), height(h), layers(w, h), back(static_cast<size_t>(w) * h), finished(back.size()), ready(std::move(ready)), pool(pool),
+          worker([this] { work(); })
+    {
+    }
+
+    ~async_renderer()
+    {
+        stop();
+    }
+
+    async_renderer(const async_renderer&) = delete;
+    async_renderer& operator=(const async_renderer&) = delete;
+
+    //change is applied to the canvas before the next frame, an empty one only asks for a frame
+    //returns the generation the frame showing the change will have
+    uint64_t edit(std::function<void(layered_canvas&)> change = nullptr)
+    {
+        uint64_t generation;
+        {
+            std::lock_guard lock(mtx);
+            changes.push_back(std::move(change));
+            generation = ++latest;
+        }
+        cv.notify_one();
+        return generation;
+    }
+
+    //swaps the newest finished frame into out, nothing if there wasn't one since the last call
+    std::optional<frame_info> take_frame(std::vector<uint32_t>& out)
+    {
+        std::lock_guard lock(mtx);
+        if (!has_frame)
+        {
+            return std::nullopt;
+        }
+        out.swap(finished);
+        finished.resize(out.size());
+        has_frame = false;
+        return info;
+    }
+
+    //cancels what is being plotted and waits for the worker, no frames come after this
+    void stop()
+    {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+            ++latest;
+        }
+        cv.notify_one();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+    }
+
+    struct render_stats
+    {
+        size_t frames; //previews and refined ones
+        size_t cancelled; //generations dropped partway because a newer one came
+    };
+
+    render_stats get_stats() const
+    {
+        std::lock_guard lock(mtx);
+        return { frames, cancelled };
+    }
+
+private:
+    int width;
+    int height;
+    layered_canvas layers;
+    std::vector<uint32_t> back; //being composed, only touched by the worker
+    std::vector<uint32_t> finished; //waiting for take_frame
+    std::function<void()> ready;
+    thread_pool& pool;
+
+    mutable std::mutex mtx; //guards everything below
+    std::condition_variable cv;
+    std::vector<std::function<void(layered_canvas&)>> changes;
+    std::atomic<uint64_t> latest = 0; //written under mtx, read without it to cancel
+    bool stopping = false;
+    bool has_frame = false;
+    frame_info info{};
+    size_t frames = 0;
+    size_t cancelled = 0;
+
+    std::thread worker; //last, it uses everything above
+
+    void work()
+    {
+        std::vector<std::function<void(layered_canvas&)>> todo;
+        for (;;)
+        {
+            uint64_t generation;
+            {
+                std::unique_lock lock(mtx);
+                cv.wait(lock, [&] { return stopping || !changes.empty(); });
+                if (stopping)
+                {
+                    return;
+                }
+                todo.swap(changes);
+                generation = latest;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            for (auto& change : todo)
+            {
+                if (change)
+                {
+                    change(layers);
+                }
+            }
+            todo.clear();
+
+            const cancel_token cancel{ &latest, generation };
+            size_t evals = 0;
+            double plot_seconds = 0.0;
+            //nothing to plot means nothing to preview
+            const bool preview = layers.needs_update();
+            bool dropped = false;
+            for (const plot_pass pass : { plot_pass::PREVIEW, plot_pass::FULL })
+            {
+                if (pass == plot_pass::PREVIEW && !preview)
+                {
+                    continue;
+                }
+                const auto plot_start = std::chrono::steady_clock::now();
+                evals += layers.update(pool, pass, cancel);
+                plot_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - plot_start).count();
+                if (cancel.cancelled())
+                {
+                    dropped = true;
+                    break;
+                }
+                layers.draw({ back.data(), width, height });
+                {
+                    std::lock_guard lock(mtx);
+                    if (cancel.cancelled())
+                    {
+                        dropped = true;
+                        break;
+                    }
+                    back.swap(finished);
+                    has_frame = true;
+                    ++frames;
+                    info = { generation, pass == plot_pass::FULL, evals, plot_seconds,
+                             std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+                }
+                ready();
+            }
+            if (dropped)
+            {
+                std::lock_guard lock(mtx);
+                ++cancelled;
+            }
+        }
+    }
+};
+
+#ifdef PROFILING_ENABLED
+//3x5 pixel glyphs, one row per entry with the leftmost pixel in bit 2
+//only what the profile overlay writes, other characters are left blank
+constexpr std::pair<char, std::array<uint8_t, 5>> glyphs[] = {
+    { '0', { 7, 5, 5, 5, 7 } }, { '1', { 2, 6, 2, 2, 7 } }, { '2', { 7, 1, 7, 4, 7 } }, { '3', { 7, 1, 7, 1, 7 } },
+    { '4', { 5, 5, 7, 1, 1 } }, { '5', { 7, 4, 7, 1, 7 } }, { '6', { 7, 4, 7, 5, 7 } }, { '7', { 7, 1, 1, 1, 1 } },
+    { '8', { 7, 5, 7, 5, 7 } }, { '9', { 7, 5, 7, 1, 7 } }, { '.', { 0, 0, 0, 0, 2 } }, { '/', { 1, 1, 2, 4, 4 } },
+    { 'a', { 0, 3, 5, 5, 3 } }, { 'e', { 0, 3, 7, 4, 3 } }, { 'f', { 3, 4, 6, 4, 4 } }, { 'k', { 4, 5, 6, 5, 5 } },
+    { 'l', { 6, 2, 2, 2, 7 } }, { 'm', { 0, 6, 7, 5, 5 } }, { 'r', { 0, 5, 6, 4, 4 } }, { 's', { 0, 3, 6, 1, 6 } },
+    { 'v', { 0, 5, 5, 5, 2 } }, { 'G', { 3, 4, 5, 5, 3 } }, { 'M', { 5, 7, 7, 5, 5 } } };
+
+constexpr int glyph_w = 3;
+constexpr int glyph_h = 5;
+
+//writes text with its top left corner at x, y, every glyph pixel becomes a scale x scale square
+//returns the x the next character would go to
+int draw_text(pixel_buffer buf, int x, int y, std::string_view text, uint32_t color, int scale = 2)
+{
+    for (const char c : text)
+    {
+        const auto it = std::ranges::find(glyphs, c, &std::pair<char, std::array<uint8_t, 5>>::first);
+        for (int row = 0; it != std::end(glyphs) && row < glyph_h * scale; row++)
+        {
+            for (int col = 0; col < glyph_w * scale; col++)
+            {
+                if (it->second[row / scale] >> (glyph_w - 1 - col / scale) & 1 && buf.inside(x + col, y + row))
+                {
+                    buf.data[x + col + (y + row) * buf.w] = color;
+                }
+            }
+        }
+        x += (glyph_w + 1) * scale;
+    }
+    return x;
+}
+
+//frame time and evaluation rate in the top left corner, on a dark box so the grid doesn't get in the way
+void draw_profile_overlay(pixel_buffer buf, const profiler::frame_meter& meter)
+{
+    constexpr int scale = 2;
+    constexpr int margin = 4;
+    constexpr uint32_t shade = 0xC0000000; //premultiplied black at 3/4 alpha
+    double rate = meter.get_evals_per_second();
+    const char* unit = "";
+    for (const char* u : { "k", "M", "G" })
+    {
+        if (rate < 1000.0)
+        {
+            break;
+        }
+        rate /= 1000.0;
+        unit = u;
+    }
+    char lines[2][32];
+    std::snprintf(lines[0], sizeof(lines[0]), "frame %.2f ms", meter.get_frame_ms());
+    std::snprintf(lines[1], sizeof(lines[1]), "%.1f %s evals/s", rate, unit);
+
+    const int line_h = (glyph_h + 2) * scale;
+    const int box_w = std::min(buf.w, 2 * margin + static_cast<int>(std::max(std::strlen(lines[0]), std::strlen(lines[1]))) * (glyph_w + 1) * scale);
+    const int box_h = std::min(buf.h, 2 * margin + 2 * line_h);
+    for (int y = 0; y < box_h; y++)
+    {
+        std::fill(buf.data + static_cast<size_t>(y) * buf.w, buf.data + static_cast<size_t>(y) * buf.w + box_w, shade);
+    }
+    draw_text(buf, margin, margin, lines[0], white, scale);
+    draw_text(buf, margin, margin + line_h, lines[1], white, scale);
+}
+#endif
+
+//png and ppm encoders for exporting plots without a window
+//both drop the alpha channel and write 8 bit rgb
+namespace image
+{
+    constexpr std::array<uint32_t, 256> make_crc_table()
+    {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr auto crc_table = make_crc_table();
+
+    uint32_t crc32(std::span<const uint8_t> bytes, uint32_t crc = 0)
+    {
+        crc = ~crc;
+        for (const uint8_t b : bytes)
+        {
+            crc = crc_table[(crc ^ b) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    uint32_t adler32(std::span<const uint8_t> bytes)
+    {
+        uint32_t a = 1;
+        uint32_t b = 0;
+        //5552 is the largest block that can't overflow b before the modulo
+        for (size_t i = 0; i < bytes.size(); i += 5552)
+        {
+            const size_t end = std::min(bytes.size(), i + 5552);
+            size_t k = i;
+            //16 bytes of the serial a += x, b += a at once, b gains 16 * a plus
+            //every byte weighted by how many of the 16 sums it is part of
+            for (; k + 16 <= end; k += 16)
+            {
+                //filtered plots are mostly zeros, which leave a alone
+                uint64_t lo, hi;
+                memcpy(&lo, &bytes[k], 8);
+                memcpy(&hi, &bytes[k + 8], 8);
+                if ((lo | hi) == 0)
+                {
+                    b += 16 * a;
+                    continue;
+                }
+                uint32_t sum = 0;
+                uint32_t weighted = 0;
+                for (int j = 0; j < 16; j++)
+                {
+                    sum += bytes[k + j];
+                    weighted += (16 - j) * bytes[k + j];
+                }
+                b += 16 * a + weighted;
+                a += sum;
+            }
+            for (; k < end; k++)
+            {
+                a += bytes[k];
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    //writes bits lsb first the way deflate wants them
+    class bit_writer
+    {
+    public:
+        explicit bit_writer(std::vector<uint8_t>& out) : out(out) {}
+
+        void put(uint32_t bits, int count)
+        {
+            acc |= static_cast<uint64_t>(bits) << used;
+            used += count;
+            while (used >= 8)
+            {
+                out.push_back(static_cast<uint8_t>(acc));
+                acc >>= 8;
+                used -= 8;
+            }
+        }
+
+        void flush()
+        {
+            if (used > 0)
+            {
+                out.push_back(static_cast<uint8_t>(acc));
+            }
+            acc = 0;
+            used = 0;
+        }
+
+    private:
+        std::vector<uint8_t>& out;
+        uint64_t acc = 0;
+        int used = 0;
+    };
+
+    //one code of the fixed huffman tables, already bit reversed
+    struct huff_code
+    {
+        uint16_t bits;
+        uint8_t len;
+    };
+
+    constexpr uint16_t reverse_bits(uint16_t code, int len)
+    {
+        uint16_t r = 0;
+        for (int i = 0; i < len; i++)
+        {
+            r = static_cast<uint16_t>((r << 1) | ((code >> i) & 1));
+        }
+        return r;
+    }
+
+    constexpr std::array<huff_code, 288> make_fixed_codes()
+    {
+        std::array<huff_code, 288> codes{};
+        for (int sym = 0; sym < 288; sym++)
+        {
+            if (sym < 144)
+            {
+                codes[sym] = { reverse_bits(static_cast<uint16_t>(0x30 + sym), 8), 8 };
+            }
+            else if (sym < 256)
+            {
+                codes[sym] = { reverse_bits(static_cast<uint16_t>(0x190 + sym - 144), 9), 9 };
+            }
+            else if (sym < 280)
+            {
+                codes[sym] = { reverse_bits(static_cast<uint16_t>(sym - 256), 7), 7 };
+            }
+            else
+            {
+                codes[sym] = { reverse_bits(static_cast<uint16_t>(0xC0 + sym - 280), 8), 8 };
+            }
+        }
+        return codes;
+    }
+
+    constexpr auto fixed_codes = make_fixed_codes();
+    constexpr uint16_t length_base[] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                         35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    constexpr uint8_t length_extra[] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                         3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+
+    //deflate with the fixed huffman tables where the only matches repeat the previous
+    //pixel, plots are mostly flat colour and grid lines so after the up filter this
+    //gets most of what zlib would at a fraction of the time
+    void deflate_runs(std::span<const uint8_t> in, std::vector<uint8_t>& out)
+    {
+        constexpr size_t dist = 3; //one rgb pixel back
+        out.reserve(out.size() + in.size() / 8);
+        bit_writer bw(out);
+        bw.put(1, 1); //last block
+        bw.put(1, 2); //fixed huffman
+        size_t i = 0;
+        while (i < in.size())
+        {
+            size_t run = 0;
+            if (i >= dist)
+            {
+                const size_t max_run = std::min<size_t>(258, in.size() - i);
+                //8 bytes at a time through the long runs of zeros, the loads may overlap
+                while (run + 8 <= max_run)
+                {
+                    uint64_t a, b;
+                    memcpy(&a, &in[i + run], 8);
+                    memcpy(&b, &in[i + run - dist], 8);
+                    if (a != b)
+                    {
+                        break;
+                    }
+                    run += 8;
+                }
+                while (run < max_run && in[i + run] == in[i + run - dist])
+                {
+                    ++run;
+                }
+            }
+            if (run >= 3)
+            {
+                size_t k = std::upper_bound(std::begin(length_base), std::end(length_base), run) - std::begin(length_base) - 1;
+                const huff_code& code = fixed_codes[257 + k];
+                bw.put(code.bits, code.len);
+                bw.put(static_cast<uint32_t>(run - length_base[k]), length_extra[k]);
+                bw.put(reverse_bits(dist - 1, 5), 5); //distance codes 0 to 3 are the distances 1 to 4
+                i += run;
+            }
+            else
+            {
+                const huff_code& code = fixed_codes[in[i]];
+                bw.put(code.bits, code.len);
+                ++i;
+            }
+        }
+        const huff_code& end = fixed_codes[256];
+        bw.put(end.bits, end.len);
+        bw.flush();
+    }
+
+    void put_be32(std::vector<uint8_t>& out, uint32_t v)
+    {
+        out.push_back(static_cast<uint8_t>(v >> 24));
+        out.push_back(static_cast<uint8_t>(v >> 16));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    void put_chunk(std::vector<uint8_t>& out, const char* type, std::span<const uint8_t> payload)
+    {
+        put_be32(out, static_cast<uint32_t>(payload.size()));
+        const size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), payload.begin(), payload.end());
+        put_be32(out, crc32(std::span(out).subspan(start)));
+    }
+
+    std::vector<uint8_t> encode_ppm(pixel_buffer buf)
+    {
+        const std::string header = "P6\n" + std::to_string(buf.w) + ' ' + std::to_string(buf.h) + "\n255\n";
+        std::vector<uint8_t> out(header.size() + static_cast<size_t>(buf.w) * buf.h * 3);
+        memcpy(out.data(), header.data(), header.size());
+        uint8_t* rgb = out.data() + header.size();
+        for (size_t i = 0; i < static_cast<size_t>(buf.w) * buf.h; i++)
+        {
+            rgb[i * 3] = static_cast<uint8_t>(buf.data[i] >> 16);
+            rgb[i * 3 + 1] = static_cast<uint8_t>(buf.data[i] >> 8);
+            rgb[i * 3 + 2] = static_cast<uint8_t>(buf.data[i]);
+        }
+        return out;
+    }
+
+    std::vector<uint8_t> encode_png(pixel_buffer buf)
+    {
+        //every row gets the up filter, rows that only differ from the one above
+        //where a curve crosses turn into long runs of zeros
+        const size_t row_bytes = 1 + static_cast<size_t>(buf.w) * 3;
+        std::vector<uint8_t> filtered(row_bytes * buf.h);
+        const std::vector<uint32_t> zero_row(buf.w, 0);
+        for (int y = 0; y < buf.h; y++)
+        {
+            uint8_t* row = &filtered[y * row_bytes];
+            row[0] = 2;
+            const uint32_t* cur = buf.data + static_cast<size_t>(y) * buf.w;
+            const uint32_t* above = y > 0 ? cur - buf.w : zero_row.data();
+            for (int x = 0; x < buf.w; x++)
+            {
+                row[1 + x * 3] = static_cast<uint8_t>((cur[x] >> 16) - (above[x] >> 16));
+                row[2 + x * 3] = static_cast<uint8_t>((cur[x] >> 8) - (above[x] >> 8));
+                row[3 + x * 3] = static_cast<uint8_t>(cur[x] - above[x]);
+            }
+        }
+
+        std::vector<uint8_t> out = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        std::vector<uint8_t> ihdr;
+        put_be32(ihdr, buf.w);
+        put_be32(ihdr, buf.h);
+        ihdr.insert(ihdr.end(), { 8, 2, 0, 0, 0 }); //8 bit rgb, deflate, no interlace
+        put_chunk(out, "IHDR", ihdr);
+
+        std::vector<uint8_t> idat = { 0x78, 0x01 };
+        deflate_runs(filtered, idat);
+        put_be32(idat, adler32(filtered));
+        put_chunk(out, "IDAT", idat);
+        put_chunk(out, "IEND", {});
+        return out;
+    }
+
+    //false if the file couldn't be written
+    bool write_file(const std::filesystem::path& path, std::span<const uint8_t> bytes)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        return static_cast<bool>(file);
+    }
+}
+
+#ifndef HEADLESS_ONLY
+/* 
+  Renders Pixel Buffer
+  params:
+  sdl window
+  sdl renderer
+  sdl texture
+  uint32 1d pixel buffer
+*/
+void render(SDL_Window* pWindow, SDL_Renderer* pRenderer, SDL_Texture* pTexture, uint32_t* data)
+{
+    PROFILE_SCOPE("render");
+    int32_t pitch = 0;
+    uint32_t* pPixelBuffer = nullptr;
+    if (!SDL_LockTexture(pTexture, nullptr, (void**)(&pPixelBuffer), &pitch))
+    {
+        {
+            PROFILE_SCOPE("upload");
+            pitch /= sizeof(uint32_t);
+            memcpy(pPixelBuffer, data, screen_h * static_cast<size_t>(pitch) * sizeof(uint32_t));
+            SDL_UnlockTexture(pTexture);
+        }
+        SDL_RenderCopy(pRenderer, pTexture, nullptr, nullptr);
+        SDL_RenderPresent(pRenderer);
+    }
+}
+#endif
+
+bool equality(double a, double b)
+{
+    return (std::abs(a - b) < std::numeric_limits<double>::epsilon());
+}
+
+//settings of exported images, filled from the command line
+struct export_options
+{
+    int w = screen_w;
+    int h = screen_h;
+    int range = 5; //x goes from -range to range
+    std::string var_name = "x";
+    std::string format = "png";
+    std::filesystem::path out_dir = ".";
+};
+
+//draws the canvas and func into pixels (resized to fit) and encodes the result
+std::vector<uint8_t> export_image(const parser::compiled_func& func, const export_options& opts,
+                                  std::vector<uint32_t>& pixels, thread_pool& pool)
+{
+    pixels.assign(static_cast<size_t>(opts.w) * opts.h, black);
+    const pixel_buffer buf{ pixels.data(), opts.w, opts.h };
+    const parser::compiled_func* funcs[] = { &func };
+    create_canvas(buf);
+    plot_all(buf, -opts.range, opts.range, funcs, pool);
+    return opts.format == "ppm" ? image::encode_ppm(buf) : image::encode_png(buf);
+}
+
+//renders every line of the file to out_dir/<line number>.<format>
+//whole images are spread over the pool, each one is plotted on the thread that picked it up
+//returns the exit code, non zero if any line failed
+int run_batch(const std::filesystem::path& list, const export_options& opts)
+{
+    std::ifstream file(list);
+    if (!file)
+    {
+        std::cerr << "can't open " << list.string() << '\n';
+        return 1;
+    }
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(file, line);)
+    {
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        lines.push_back(std::move(line));
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(opts.out_dir, ec);
+
+    expr_cache cache(16 << 20, simd::accuracy::FAST);
+    std::vector<std::string> errors(lines.size());
+    std::atomic<size_t> written = 0;
+    const auto start = std::chrono::steady_clock::now();
+    get_thread_pool().parallel_for(lines.size(), [&](size_t i)
+    {
+        if (lines[i].find_first_not_of(" \t") == std::string::npos)
+        {
+            return;
+        }
+        thread_local std::vector<uint32_t> pixels;
+        try
+        {
+            const auto func = cache.get(lines[i], opts.var_name);
+            thread_pool serial(0);
+            const auto bytes = export_image(*func, opts, pixels, serial);
+            const auto path = opts.out_dir / (std::to_string(i + 1) + '.' + opts.format);
+            if (image::write_file(path, bytes))
+            {
+                ++written;
+            }
+            else
+            {
+                errors[i] = "can't write " + path.string();
+            }
+        }
+        //parse errors, and running out of memory or executable pages, only fail this line
+        catch (const std::exception& exc)
+        {
+            errors[i] = exc.what();
+        }
+    });
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    bool failed = false;
+    for (size_t i = 0; i < errors.size(); i++)
+    {
+        if (!errors[i].empty())
+        {
+            std::cerr << "line " << i + 1 << ": " << errors[i] << '\n';
+            failed = true;
+        }
+    }
+    std::cout << written << " images in " << elapsed.count() * 1000.0 << "ms, " << written / elapsed.count() << " images/s\n";
+    return failed ? 1 : 0;
+}
+
+//bytes of a file or of stdin, read front to back in constant memory
+//regular files are mapped and handed out in place, on posix the pages behind
+//the reader are dropped again so resident memory stays small for files of any size
+//anything else is read into a buffer that only grows past read_size for a longer row
+class input_source
+{
+public:
+    static constexpr size_t read_size = 1 << 20;
+
+    //reads an open file, which stays owned by the caller
+    explicit input_source(std::FILE* file) : file(file) {}
+
+    explicit input_source(const std::filesystem::path& path)
+    {
+#if defined(_WIN32)
+        const HANDLE handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        LARGE_INTEGER size{};
+        if (handle != INVALID_HANDLE_VALUE && GetFileType(handle) == FILE_TYPE_DISK && GetFileSizeEx(handle, &size) && size.QuadPart > 0)
+        {
+            const HANDLE mapping = CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (mapping)
+            {
+                mapped = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                map_size = mapped ? static_cast<size_t>(size.QuadPart) : 0;
+                CloseHandle(mapping);
+            }
+        }
+        if (handle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(handle);
+        }
+        if (!mapped)
+        {
+            file = _wfopen(path.c_str(), L"rb");
+            owns_file = true;
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st{};
+        if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mem != MAP_FAILED)
+            {
+                mapped = static_cast<const char*>(mem);
+                map_size = st.st_size;
+                madvise(mem, map_size, MADV_SEQUENTIAL);
+            }
+        }
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        if (!mapped)
+        {
+            file = std::fopen(path.c_str(), "rb");
+            owns_file = true;
+        }
+#endif
+    }
+
+    ~input_source()
+    {
+        if (mapped)
+        {
+#if defined(_WIN32)
+            UnmapViewOfFile(mapped);
+#else
+            munmap(const_cast<char*>(mapped), map_size);
+#endif
+        }
+        if (owns_file && file)
+        {
+            std::fclose(file);
+        }
+    }
+
+    input_source(const input_source&) = delete;
+    input_source& operator=(const input_source&) = delete;
+
+    bool ok() const { return mapped || file; }
+
+    //the bytes not consumed yet, at least min of them unless the input ends first
+    std::span<const char> data(size_t min = read_size)
+    {
+        if (mapped)
+        {
+            return { mapped + pos, map_size - pos };
+        }
+        if (end - begin < min && !eof)
+        {
+            std::memmove(buf.data(), buf.data() + begin, end - begin);
+            end -= begin;
+            begin = 0;
+            buf.resize(std::max({ buf.size(), min, read_size }));
+            while (end < min && !eof)
+            {
+                const size_t n = std::fread(buf.data() + end, 1, buf.size() - end, file);
+                end += n;
+                eof = n == 0;
+            }
+            if (std::ferror(file))
+            {
+                throw std::runtime_error("can't read input");
+            }
+        }
+        return { buf.data() + begin, end - begin };
+    }
+
+    //true if data() reaches the end of the input
+    bool at_end() const { return mapped || eof; }
+
+    //drops the first n bytes of data()
+    void consume(size_t n)
+    {
+        if (!mapped)
+        {
+            begin += n;
+            return;
+        }
+        pos += n;
+#if !defined(_WIN32)
+        //read ahead keeps the pages in front coming, the ones behind are given back in big steps
+        constexpr size_t release_size = 16 << 20;
+        static const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        if (pos - released >= release_size)
+        {
+            const size_t until = pos / page * page;
+            madvise(const_cast<char*>(mapped) + released, until - released, MADV_DONTNEED);
+            released = until;
+        }
+#endif
+    }
+
+private:
+    const char* mapped = nullptr;
+    size_t map_size = 0;
+    size_t pos = 0;
+    size_t released = 0;
+
+    std::FILE* file = nullptr;
+    bool owns_file = false;
+    bool eof = false;
+    std::vector<char> buf;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+//rows evaluated at once by evaluate_stream
+constexpr size_t stream_block_rows = 1 << 16;
+
+//evaluates func on every row of in and writes one result per row to out, returns the number of rows
+//text rows hold func.num_vars numbers split by spaces, tabs or commas, blank lines are skipped
+//binary rows are func.num_vars native doubles, results are written the same way
+//rows are gathered into columns of stream_block_rows, evaluated in one batch and
+//written with one call, so memory use doesn't depend on the size of the input
+//bad input throws std::runtime_error with the line or row it was found in
+size_t evaluate_stream(const parser::compiled_func& func, input_source& in, std::FILE* out, bool binary_in, bool binary_out)
+{
+    const size_t num_vars = func.num_vars;
+    std::vector<std::vector<double>> columns(num_vars, std::vector<double>(stream_block_rows));
+    std::vector<const double*> column_ptrs;
+    for (const auto& col : columns)
+    {
+        column_ptrs.push_back(col.data());
+    }
+    std::vector<double> results(stream_block_rows);
+    std::vector<char> text(stream_block_rows * 32);
+    size_t total = 0;
+    size_t lines = 0;
+    size_t rows = 0;
+
+    const auto flush = [&]
+    {
+        if (rows == 0)
+        {
+            return;
+        }
+        const std::span<double> res(results.data(), rows);
+        if (num_vars == 1)
+        {
+            func.evaluate(std::span(columns[0].data(), rows), res);
+        }
+        else
+        {
+            func.evaluate(column_ptrs, rows, res);
+        }
+        size_t written;
+        size_t expected = rows;
+        if (binary_out)
+        {
+            written = std::fwrite(res.data(), sizeof(double), rows, out);
+        }
+        else
+        {
+            char* ptr = text.data();
+            for (const double y : res)
+            {
+                ptr = std::to_chars(ptr, text.data() + text.size(), y).ptr;
+                *ptr++ = '\n';
+            }
+            expected = ptr - text.data();
+            written = std::fwrite(text.data(), 1, expected, out);
+        }
+        if (written != expected)
+        {
+            throw std::runtime_error("can't write output");
+        }
+        total += rows;
+        rows = 0;
+    };
+    const auto line_error = [&](std::string_view what)
+    {
+        return std::runtime_error("line " + std::to_string(lines) + ": " + std::string(what));
+    };
+
+    //parses whole rows from the front of view until the block is full, returns the bytes used
+    const auto parse_text = [&](std::span<const char> view)
+    {
+        const char* p = view.data();
+        const char* const end = p + view.size();
+        const auto is_separator = [](char c) { return c == ' ' || c == '\t' || c == ',' || c == '\r'; };
+        while (rows < stream_block_rows && p != end)
+        {
+            const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            if (!nl && !in.at_end())
+            {
+                //the row may go on past the end of view
+                break;
+            }
+            const char* const line_end = nl ? nl : end;
+            ++lines;
+            size_t col = 0;
+            for (const char* q = p;;)
+            {
+                while (q != line_end && is_separator(*q)) ++q;
+                if (q == line_end)
+                {
+                    break;
+                }
+                if (col == num_vars)
+                {
+                    throw line_error("more than " + std::to_string(num_vars) + " values");
+                }
+                const auto [ptr, ec] = std::from_chars(q, line_end, columns[col][rows]);
+                if (ec != std::errc() || (ptr != line_end && !is_separator(*ptr)))
+                {
+                    throw line_error("not a number: " + std::string(q, std::find_if(q, line_end, is_separator)));
+                }
+                ++col;
+                q = ptr;
+            }
+            if (col != 0 && col != num_vars)
+            {
+                throw line_error("expected " + std::to_string(num_vars) + " values");
+            }
+            rows += col != 0;
+            p = nl ? nl + 1 : end;
+        }
+        return static_cast<size_t>(p - view.data());
+    };
+
+    //copies whole rows from the front of view into the columns until the block is full
+    const auto parse_binary = [&](std::span<const char> view)
+    {
+        const size_t row_bytes = num_vars * sizeof(double);
+        const size_t n = std::min(view.size() / row_bytes, stream_block_rows - rows);
+        if (num_vars == 1)
+        {
+            std::memcpy(columns[0].data() + rows, view.data(), n * sizeof(double));
+        }
+        else
+        {
+            for (size_t i = 0; i < n; i++)
+            {
+                for (size_t col = 0; col < num_vars; col++)
+                {
+                    std::memcpy(&columns[col][rows + i], view.data() + i * row_bytes + col * sizeof(double), sizeof(double));
+                }
+            }
+        }
+        rows += n;
+        return n * row_bytes;
+    };
+
+    size_t want = input_source::read_size;
+    for (;;)
+    {
+        const auto view = in.data(want);
+        if (view.empty())
+        {
+            break;
+        }
+        const size_t used = binary_in ? parse_binary(view) : parse_text(view);
+        in.consume(used);
+        if (rows == stream_block_rows)
+        {
+            flush();
+        }
+        else if (used == 0)
+        {
+            if (in.at_end())
+            {
+                throw std::runtime_error("input ends in the middle of row " + std::to_string(total + rows + 1));
+            }
+            //a row longer than what has been read so far, doubling keeps a long row from being read a byte at a time
+            want = view.size() * 2;
+            continue;
+        }
+        want = input_source::read_size;
+    }
+    flush();
+    if (std::fflush(out) != 0)
+    {
+        throw std::runtime_error("can't write output");
+    }
+    return total;
+}
+
+//settings of streamed evaluation, filled from the command line
+struct stream_options
+{
+    std::string expr;
+    std::vector<std::string> var_names{ "x" };
+    std::filesystem::path input; //empty or - reads stdin
+    std::filesystem::path output; //empty or - writes stdout
+    bool binary_in = false;
+    bool binary_out = false;
+};
+
+//evaluates opts.expr over the input, the rows per second go to stderr so they don't mix with the results
+//returns the exit code
+int run_stream(const stream_options& opts)
+{
+    const bool use_stdin = opts.input.empty() || opts.input == "-";
+    const bool use_stdout = opts.output.empty() || opts.output == "-";
+#if defined(_WIN32)
+    if (use_stdin) _setmode(_fileno(stdin), _O_BINARY);
+    if (use_stdout) _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    std::FILE* out = use_stdout ? stdout : nullptr;
+    try
+    {
+        const std::vector<std::string_view> names(opts.var_names.begin(), opts.var_names.end());
+        auto func = parser::compile(parser::s_yard(opts.expr, names), names, parser::opt_level::FULL);
+#ifdef JIT_ENABLED
+        func.native = jit::compile(func);
+#endif
+        auto in = use_stdin ? std::make_unique<input_source>(stdin) : std::make_unique<input_source>(opts.input);
+        if (!in->ok())
+        {
+            std::cerr << "can't open " << opts.input.string() << '\n';
+            return 1;
+        }
+        if (!out && !(out = std::fopen(opts.output.string().c_str(), "wb")))
+        {
+            std::cerr << "can't open " << opts.output.string() << '\n';
+            return 1;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const size_t rows = evaluate_stream(func, *in, out, opts.binary_in, opts.binary_out);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cerr << rows << " rows in " << elapsed.count() * 1000.0 << "ms, " << rows / elapsed.count() << " rows/s\n";
+    }
+    catch (const std::exception& exc)
+    {
+        std::cerr << exc.what() << '\n';
+        if (out && out != stdout) std::fclose(out);
+        return 1;
+    }
+    return out == stdout || std::fclose(out) == 0 ? 0 : 1;
+}
+
+//expressions exercised by tests() and benchmarks()
+std::vector<std::string> test_expressions()
+{
+    std::vector<std::string> res{ "x+2+5 + 6 + 10", "cos( sin(tan(x)) )", "x+ 10 *(5 +2)", "-x + 1 - (3 + 2)" };
+    for (const auto& name : std::views::keys(parser::unary_func_tbl))
+    {
+        res.push_back(static_cast<std::string>(name) + "(x-0.001*(2 - 1))");
+    }
+    return res;
+}
+
+void tests()
+{
+    const std::string a = "x+2+5 + 6 + 10";
+    const std::string b = "cos( sin(tan(x)) )";
+    const std::string c = "x+ 10 *(5 +2)";
+    const std::string d = "-x + 1 - (3 + 2)";
+
+    double real = 1.0 + 2.0 + 5.0 + 6.0 + 10.0;
+    auto rpn = parser::s_yard(a, "x");
+    auto func = parser::build_func(rpn, "x");
+    if (!equality(real, func(1.0))) 
+        std::cout << "test on: " << a << " failed... " << real << " " << func(1.0) << '\n'; 
+    else
+        std::cout << "test on: " << a << " passed... " << real << " " << func(1.0) << '\n';
+
+    real = std::cos(std::sin(std::tan(1.0)));
+    rpn = parser::s_yard(b, "x");
+    func = parser::build_func(rpn, "x");
+    if (!equality(real, func(1.0))) 
+        std::cout << "test on: " << b << " failed... " << real << " " << func(1.0) << '\n'; 
+    else 
+        std::cout << "test on: " << b << " passed... " << real << " " << func(1.0) << '\n';
+
+    real = 1.0 + 10.0 * (5.0 + 2.0);
+    rpn = parser::s_yard(c, "x");
+    func = parser::build_func(rpn, "x");
+    if (!equality(real, func(1.0))) 
+        std::cout << "test on: " << c << " failed... " << real << " " << func(1.0) << '\n'; 
+    else  
+        std::cout << "test on: " << c << " passed... " << real << " " << func(1.0) << '\n'; 
+
+    real = -1.0 + 1.0 - (3.0 + 2.0);
+    rpn = parser::s_yard(d, "x");
+    func = parser::build_func(rpn, "x"); 
+    if (!equality(real, func(1.0)))
+        std::cout << "test on: " << d << " failed... " << real << " " << func(1.0) << '\n'; 
+    else  
+        std::cout << "test on: " << d << " passed... " << real << " " << func(1.0) << '\n'; 
+
+    //testing all funcs from the table, mostly uneeded
+    for (const auto& [k, v] : parser::unary_func_tbl)
+    {
+        double test_val = 1.0;
+        //make sure the function is well defined at the input value
+        if (k == "atanh")
+        {
+            test_val = -0.5;
+        }
+      
+        const std::string s = static_cast<std::string>(k) + "(x)";
+        real = v(test_val);
+        rpn = parser::s_yard(s, "x");
+        func = parser::build_func(rpn, "x");
+        if (!equality(real, func(test_val)))
+            std::cout << "test on: " << s << " failed... " << real << " " << func(test_val) << '\n';
+        else 
+            std::cout << "test on " << s << " passed... " << real << " " << func(test_val) << '\n'; 
+    }
+
+    for (const auto& [k, v] : parser::unary_func_tbl)
+    {
+        double test_val = 1.0;
+        
+        if (k == "atanh")
+        {
+            test_val = -0.5;
+        }
+        else if (k == "acosh")
+        {
+            test_val = 2.0;
+        }
+        const std::string s = static_cast<std::string>(k) + "(x-0.001*(2 - 1))";
+        real = v(test_val - 0.001 * (2 - 1));
+        rpn = parser::s_yard(s, "x");
+        func = parser::build_func(rpn, "x");
+        if (!equality(real, func(test_val)))
+            std::cout << "test on: " << s << " failed... " << real << " " << func(test_val) << '\n';
+        else 
+            std::cout << "test on " << s << " passed... " << real << " " << func(test_val) << '\n'; 
+    }
+
+    //precedence and parentheses handling
+    const std::pair<std::string, double> prec_cases[] = {
+        { "1-2^3*4", 1.0 - std::pow(2.0, 3.0) * 4.0 },
+        { "(1+2*3-4)", 1.0 + 2.0 * 3.0 - 4.0 },
+        { "2^3^2", std::pow(2.0, std::pow(3.0, 2.0)) },
+        { "x + (1)", 2.0 },
+        { "10/2/5", 10.0 / 2.0 / 5.0 },
+        { "2*sqrt(x*4)+pi", 2.0 * std::sqrt(4.0) + std::numbers::pi } };
+    for (const auto& [s, expected] : prec_cases)
+    {
+        const auto compiled = parser::compile(parser::s_yard(s, "x"), "x");
+        if (!equality(expected, compiled(1.0)))
+            std::cout << "test on: " << s << " failed... " << expected << " " << compiled(1.0) << '\n';
+        else
+            std::cout << "test on: " << s << " passed... " << expected << " " << compiled(1.0) << '\n';
+    }
+
+    //optimized expressions must agree with unoptimized ones
+    const std::pair<std::string, int> opt_cases[] = {
+        { "1 + 1 + 2", 1 },
+        { "x*1 + 0", 1 },
+        { "x^2", 3 },
+        { "sqrt(2) * x / 4", 3 },
+        { "-(-x)", 1 },
+        { "x + 2 + 5 + pi", 3 } };
+    for (const auto& [s, expected_nodes] : opt_cases)
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        parser::opt_stats stats;
+        const auto plain = parser::compile(rpn, "x");
+        const auto optimized = parser::compile(rpn, "x", parser::opt_level::FULL, &stats);
+        const double real = plain(1.5);
+        if (std::abs(real - optimized(1.5)) > 1e-12 || stats.nodes_after != expected_nodes)
+            std::cout << "opt test on: " << s << " failed... " << real << " " << optimized(1.5) << " nodes " << stats.nodes_after << '\n';
+        else
+            std::cout << "opt test on: " << s << " passed... " << real << " " << optimized(1.5) << " nodes " << stats.nodes_after << '\n';
+    }
+
+    //shared subexpressions are evaluated once, in every evaluator, with bit identical results
+    const std::pair<std::string, int> cse_cases[] = {
+        { "sin(x)*sin(x) + cos(sin(x))", 5 },
+        { "(x+1)*(1+x)", 4 },
+        { "(sin(x)+1)*(sin(x)+1)", 5 },
+        { "exp(x/2)*exp(x/2) - exp(x/2)/(1+exp(x/2))", 9 },
+        { "x*2 + x*3", 6 } };
+    for (const auto& [s, expected_nodes] : cse_cases)
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        parser::opt_stats stats;
+        const auto plain = parser::compile(rpn, "x");
+        const auto shared = parser::compile(rpn, "x", parser::opt_level::FOLD, &stats);
+        const double xs[] = { -2.5, -0.5, 0.0, 0.75, 3.0 };
+        double plain_ys[std::size(xs)];
+        double shared_ys[std::size(xs)];
+        double derivs[std::size(xs)];
+        plain.evaluate(xs, plain_ys);
+        shared.evaluate(xs, shared_ys);
+        shared.evaluate_dual(xs, shared_ys, derivs);
+        bool passed = stats.nodes_unique == expected_nodes;
+        for (size_t i = 0; i < std::size(xs); i++)
+        {
+            const auto same = [](double a, double b) { return a == b || (std::isnan(a) && std::isnan(b)); };
+            const auto a = plain.evaluate_dual(xs[i]);
+            const auto b = shared.evaluate_dual(xs[i]);
+            const auto ia = plain.evaluate_interval({ xs[i] - 0.25, xs[i] + 0.25 });
+            const auto ib = shared.evaluate_interval({ xs[i] - 0.25, xs[i] + 0.25 });
+            passed = passed && same(plain(xs[i]), shared(xs[i])) && same(plain_ys[i], shared_ys[i]) && same(a.value, b.value) &&
+                     same(a.deriv, b.deriv) && same(b.deriv, derivs[i]) && same(ia.lo, ib.lo) && same(ia.hi, ib.hi);
+        }
+        if (const auto native = jit::compile(shared))
+        {
+            native->batch()(xs, shared_ys, std::size(xs));
+            for (size_t i = 0; i < std::size(xs); i++)
+            {
+                passed = passed && equality(plain_ys[i], shared_ys[i]) && equality(plain_ys[i], native->scalar()(xs[i]));
+            }
+        }
+        if (!passed)
+            std::cout << "cse test on: " << s << " failed... nodes " << stats.nodes_after << " -> " << stats.nodes_unique << '\n';
+        else
+            std::cout << "cse test on: " << s << " passed... nodes " << stats.nodes_after << " -> " << stats.nodes_unique
+                      << ", temporaries " << shared.num_temps << '\n';
+    }
+
+    //compiled bytecode must agree with the closure tree
+    for (const auto& s : test_expressions())
+    {
+        rpn = parser::s_yard(s, "x");
+        func = parser::build_func(rpn, "x");
+        const auto compiled = parser::compile(rpn, "x");
+        const double test_val = 0.75;
+        real = func(test_val);
+        if (!equality(real, compiled(test_val)) && !(std::isnan(real) && std::isnan(compiled(test_val))))
+            std::cout << "compiled test on: " << s << " failed... " << real << " " << compiled(test_val) << '\n';
+        else
+            std::cout << "compiled test on: " << s << " passed... " << real << " " << compiled(test_val) << '\n';
+    }
+}
+
+//batch evaluation must agree with single point evaluation
+void batch_tests()
+{
+    std::vector<double> xs(1000);
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+        xs[i] = -5.0 + i * 0.01;
+    }
+    std::vector<double> ys(xs.size());
+    std::cout << "batch kernels: " << simd::kernels().name << '\n';
+    for (const auto& s : test_expressions())
+    {
+        const auto func = parser::compile(parser::s_yard(s, "x"), "x");
+        func.evaluate(xs, ys);
+        bool passed = true;
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            const double real = func(xs[i]);
+            if (!equality(real, ys[i]) && !(std::isnan(real) && std::isnan(ys[i])))
+            {
+                passed = false;
+            }
+        }
+        std::cout << "batch test on: " << s << (passed ? " passed" : " failed") << '\n';
+    }
+
+    //a long sum is as deep as it is long, up to max_tree_depth it compiles along with its
+    //derivative, past it every path has to throw before a recursive pass runs out of stack
+    const auto sum = [](int terms)
+    {
+        std::string res = "x";
+        for (int i = 1; i < terms; i++)
+        {
+            res += "+x";
+        }
+        return res;
+    };
+    const auto deepest = parser::s_yard(sum(parser::max_tree_depth), "x");
+    const auto func = parser::compile(deepest, "x", parser::opt_level::FULL);
+    const auto derivative = parser::compile_derivative(deepest, "x");
+    bool deep = func(0.5) == parser::max_tree_depth * 0.5 && derivative(0.5) == parser::max_tree_depth;
+    const std::string too_deep = sum(200000);
+    parser::compiler comp;
+    expr_cache cache(1 << 16);
+    for (int path = 0; path < 3; path++)
+    {
+        try
+        {
+            parser::compiled_func res;
+            path == 0 ? static_cast<void>(parser::compile(parser::s_yard(too_deep, "x"), "x"))
+                : path == 1 ? comp.compile(too_deep, "x", res) : static_cast<void>(cache.get(too_deep, "x"));
+            deep = false;
+        }
+        catch (const parser::parse_error&)
+        {
+        }
+    }
+    std::cout << "batch test on: nesting limit" << (deep ? " passed" : " failed") << '\n';
+}
+
+//expressions over several variables against the same formulas written in c++,
+//one row at a time and as columns of a struct of arrays batch
+void var_tests()
+{
+    const std::string_view names[] = { "x", "y", "t" };
+    const std::pair<std::string, std::function<double(double, double, double)>> cases[] = {
+        { "x*y + t", [](double x, double y, double t) { return x * y + t; } },
+        { "sin(x)*y - t^2/x", [](double x, double y, double t) { return std::sin(x) * y - std::pow(t, 2) / x; } },
+        { "sqrt(abs(y - t)) + x^2", [](double x, double y, double t) { return std::sqrt(std::abs(y - t)) + x * x; } },
+        { "t*(x + 1) + 3", [](double x, double, double t) { return t * (x + 1.0) + 3.0; } },
+    };
+
+    constexpr size_t rows = 1000; //not a multiple of the batch size
+    std::vector<double> xs(rows), ys(rows), ts(rows), out(rows);
+    for (size_t i = 0; i < rows; i++)
+    {
+        xs[i] = 2.0 + i * 0.01;
+        ys[i] = -3.0 + i * 0.007;
+        ts[i] = 1.0 - i * 0.002;
+    }
+    const double* columns[] = { xs.data(), ys.data(), ts.data() };
+    for (const auto& [s, real] : cases)
+    {
+        const auto func = parser::compile(parser::s_yard(s, names), names, parser::opt_level::FULL);
+        func.evaluate(columns, rows, out);
+        bool passed = func.num_vars == 3;
+        for (size_t i = 0; i < rows; i++)
+        {
+            const double vars[] = { xs[i], ys[i], ts[i] };
+            const double expected = real(xs[i], ys[i], ts[i]);
+            passed &= equality(expected, func(vars)) && equality(expected, out[i]);
+        }
+        std::cout << "var test on: " << s << (passed ? " passed" : " failed") << '\n';
+    }
+
+    //slots follow the order of the names, not the order in the text
+    const std::string_view swapped[] = { "y", "x" };
+    const auto func = parser::compile(parser::s_yard("x - y", swapped), swapped);
+    const double vars[] = { 1.0, 3.0 };
+    bool unknown = false;
+    try
+    {
+        parser::s_yard("x + z", swapped);
+    }
+    catch (const parser::parse_error&)
+    {
+        unknown = true;
+    }
+    std::cout << "var test on: slot order" << (func(vars) == 2.0 && unknown ? " passed" : " failed") << '\n';
+
+    //a function name glued to a variable is split off, unless the whole name is a variable
+    const std::string_view glued_names[] = { "x", "cost" };
+    const double glued_vars[] = { 0.5, 2.0 };
+    const auto glued = [&](std::string_view str)
+    {
+        try
+        {
+            return parser::compile(parser::s_yard(str, glued_names), glued_names)(glued_vars);
+        }
+        catch (const parser::parse_error&)
+        {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+    };
+    const bool split = glued("sinx") == std::sin(0.5) && glued("sqrtcost") == std::sqrt(2.0) && glued("cost") == 2.0
+                       && glued("sincosx") == std::sin(std::cos(0.5)) && std::isnan(glued("sinq")) && std::isnan(glued("sin2"));
+    std::cout << "var test on: glued function names" << (split ? " passed" : " failed") << '\n';
+
+    //the native backend only handles one variable, the cache falls back to the interpreter
+    expr_cache cache(4096);
+    const auto cached = cache.get("x - y", swapped);
+    const auto other = cache.get("x - y", std::span(names, 2));
+    std::cout << "var test on: cache and jit fallback" << (!jit::compile(*cached) && !cached->native && (*cached)(vars) == 2.0 &&
+                                                          (*other)(vars) == -2.0 ? " passed" : " failed") << '\n';
+}
+
+//derivatives from dual numbers and from the symbolic derivative against central
+//differences, for every function in the table and the binary operators
+void deriv_tests()
+{
+    const auto close = [](double a, double b, double tol)
+    {
+        return std::abs(a - b) <= tol * std::max(1.0, std::abs(b));
+    };
+    std::vector<std::string> exprs;
+    for (const auto& [name, func] : parser::unary_func_tbl)
+    {
+        //inside the domain of every function, away from the steps of floor and co
+        exprs.push_back(std::string(name) + (name == "acosh" ? "(x+1.2)" : "(x*0.5+0.1)"));
+    }
+    std::sort(exprs.begin(), exprs.end());
+    exprs.insert(exprs.end(), { "x^3 - 2*x/(x+1)", "2^x + x^x", "sin(x)^2 * exp(0-x)", "tgamma(x+3)*lgamma(x+3)", "(0-x)^2" });
+
+    const double xs[] = { 0.3, 0.55, 0.71, 1.3 };
+    std::vector<double> values(std::size(xs));
+    std::vector<double> derivs(std::size(xs));
+    for (const auto& s : exprs)
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        const auto func = parser::compile(rpn, "x", parser::opt_level::FULL);
+        const auto derivative = parser::compile_derivative(rpn, "x");
+        func.evaluate_dual(xs, values, derivs);
+        bool passed = true;
+        for (size_t i = 0; i < std::size(xs); i++)
+        {
+            constexpr double h = 1e-5;
+            const double numeric = (func(xs[i] + h) - func(xs[i] - h)) / (2 * h);
+            const auto [value, deriv] = func.evaluate_dual(xs[i]);
+            passed &= close(value, func(xs[i]), 1e-15) && close(deriv, numeric, 1e-6);
+            passed &= values[i] == value && close(derivs[i], deriv, 1e-15);
+            passed &= close(derivative(xs[i]), deriv, 1e-12);
+        }
+        std::cout << "derivative test on: " << s << (passed ? " passed" : " failed") << "... " << func.evaluate_dual(xs[0]).deriv
+                  << " " << derivative(xs[0]) << '\n';
+    }
+
+    //the symbolic derivative printed and parsed again, partial derivatives of two variables
+    const std::string_view names[] = { "x", "y" };
+    const auto tree = parser::optimize(parser::build_tree(parser::s_yard("sin(x*y) + x^2/y", names), names), parser::opt_level::FULL);
+    bool partials = true;
+    for (int var = 0; var < 2; var++)
+    {
+        const auto derivative = parser::optimize(parser::differentiate(tree, var), parser::opt_level::FULL);
+        const std::string text = parser::to_string(derivative, names);
+        const auto reparsed = parser::compile(parser::s_yard(text, names), names);
+        const auto func = parser::compile(tree, 2);
+        const double vars[] = { 0.7, 1.9 };
+        const double expected = var == 0 ? 1.9 * std::cos(0.7 * 1.9) + 2 * 0.7 / 1.9 : 0.7 * std::cos(0.7 * 1.9) - 0.49 / (1.9 * 1.9);
+        partials &= close(reparsed(vars), expected, 1e-14) && close(func.evaluate_dual(vars, var).deriv, expected, 1e-14);
+    }
+    std::cout << "derivative test on: partials and to_string" << (partials ? " passed" : " failed") << '\n';
+
+    //newton's method on cos(x) = x with value and slope from one pass
+    const auto kepler = parser::compile(parser::s_yard("cos(x) - x", "x"), "x");
+    double x = 1.0;
+    int steps = 0;
+    for (; steps < 20; steps++)
+    {
+        const auto [value, slope] = kepler.evaluate_dual(x);
+        if (std::abs(value) < 1e-15)
+        {
+            break;
+        }
+        x -= value / slope;
+    }
+    std::cout << "derivative test on: newton" << (std::abs(x - 0.7390851332151607) < 1e-15 && steps < 8 ? " passed" : " failed")
+              << "... " << steps << " steps\n";
+}
+
+//distance between a and b in ulp, 0 if both are nan
+double ulp_distance(double a, double b)
+{
+    if (a == b || (std::isnan(a) && std::isnan(b)))
+    {
+        return 0.0;
+    }
+    if (std::isnan(a) || std::isnan(b))
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+    //doubles ordered like integers, -0 and +0 next to each other
+    const auto ordered = [](double d)
+    {
+        const int64_t i = std::bit_cast<int64_t>(d);
+        return i < 0 ? std::numeric_limits<int64_t>::min() - i : i;
+    };
+    return std::abs(static_cast<double>(ordered(a) - ordered(b)));
+}
+
+//accuracy harness for simd::approx: max ulp error against libm over the domain of each function,
+//the vector kernels against the scalar ones, and approximate() on compiled expressions
+void approx_tests()
+{
+    using simd::accuracy;
+    using simd::approx_kernel;
+    std::mt19937_64 rng(99);
+    const auto uniform = [&](double lo, double hi) { return std::uniform_real_distribution<double>(lo, hi)(rng); };
+    //every magnitude from 1e-300 to 1e300 is as likely
+    const auto magnitude = [&] { return std::exp(uniform(-690.0, 690.0)); };
+
+    const char* names[] = { "exp", "log", "sin", "cos", "tan" };
+    double(* const exact[])(double) = { std::exp, std::log, std::sin, std::cos, std::tan };
+    const double domain[] = { 710.0, 0.0, 1.1e6, 1.1e6, 1.1e6 }; //a bit past where the reductions stop
+    const double special[] = { 0.0, -0.0, std::numeric_limits<double>::denorm_min(), -std::numeric_limits<double>::min(), 1e300, -1e300,
+                               std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+                               std::numeric_limits<double>::quiet_NaN(), 1e6, -1e6, 708.0, -708.0, 709.7, -745.0 };
+
+    std::vector<double> xs(200'003); //not a multiple of four so the scalar tail runs too
+    std::vector<double> ys(xs.size());
+    for (int k = 0; k < static_cast<int>(approx_kernel::COUNT); k++)
+    {
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            if (i < std::size(special)) xs[i] = special[i];
+            else if (k == static_cast<int>(approx_kernel::LOG)) xs[i] = magnitude();
+            else if (i % 3 == 0) xs[i] = uniform(-10.0, 10.0);
+            else if (i % 3 == 1) xs[i] = uniform(-domain[k], domain[k]);
+            else xs[i] = std::copysign(std::min(magnitude(), domain[k]), uniform(-1.0, 1.0));
+        }
+        for (const auto acc : { accuracy::FAST, accuracy::COARSE })
+        {
+            const auto kernel = static_cast<approx_kernel>(k);
+            const auto f = simd::approx::get_scalar(kernel, acc);
+            ys = xs;
+            simd::kernels().approx[static_cast<int>(acc) - 1][k](ys.data(), ys.size());
+            double worst = 0.0;
+            double worst_x = 0.0;
+            bool same = true;
+            for (size_t i = 0; i < xs.size(); i++)
+            {
+                const double ulp = ulp_distance(f(xs[i]), exact[k](xs[i]));
+                if (ulp > worst)
+                {
+                    worst = ulp;
+                    worst_x = xs[i];
+                }
+                same &= std::bit_cast<uint64_t>(ys[i]) == std::bit_cast<uint64_t>(f(xs[i])) || (std::isnan(ys[i]) && std::isnan(f(xs[i])));
+            }
+            const bool passed = worst <= simd::approx::max_ulp(kernel, acc) && same;
+            std::cout << "approx test on: " << names[k] << (acc == accuracy::FAST ? " fast" : " coarse") << (passed ? " passed" : " failed")
+                      << "... max " << worst << " ulp at " << worst_x << (same ? "" : ", batch differs") << '\n';
+        }
+    }
+
+    //pow over both signs of a, whole and fractional b, negative bases with a fractional b and the far ends go to libm
+    std::vector<double> bs(xs.size());
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+        xs[i] = i % 4 == 0 || i % 4 == 3 ? -uniform(0.0, 10.0) : i % 4 == 1 ? magnitude() : std::exp(uniform(-20.0, 20.0));
+        bs[i] = i % 2 ? uniform(-10.0, 10.0) : std::round(uniform(-10.0, 10.0));
+    }
+    for (const auto acc : { accuracy::FAST, accuracy::COARSE })
+    {
+        const auto pow = acc == accuracy::FAST ? simd::approx::pow<accuracy::FAST> : simd::approx::pow<accuracy::COARSE>;
+        ys = xs;
+        simd::kernels().pow[static_cast<int>(acc) - 1](ys.data(), bs.data(), ys.size());
+        double worst = 0.0;
+        bool same = true;
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            const double value = pow(xs[i], bs[i]);
+            worst = std::max(worst, ulp_distance(value, std::pow(xs[i], bs[i])));
+            same &= std::bit_cast<uint64_t>(ys[i]) == std::bit_cast<uint64_t>(value) || (std::isnan(ys[i]) && std::isnan(value));
+        }
+        const bool passed = worst <= simd::approx::max_pow_ulp(acc) && same;
+        std::cout << "approx test on: pow" << (acc == accuracy::FAST ? " fast" : " coarse") << (passed ? " passed" : " failed")
+                  << "... max " << worst << " ulp" << (same ? "" : ", batch differs") << '\n';
+    }
+
+    //compiled expressions switched back and forth, the batch path agrees with the scalar one
+    std::vector<double> grid(1001);
+    for (size_t i = 0; i < grid.size(); i++)
+    {
+        grid[i] = -10.0 + 20.0 * static_cast<double>(i) / static_cast<double>(grid.size() - 1);
+    }
+    for (const auto& s : { "sin(x)+cos(x)*tan(x/3)", "exp(x/4)*log(abs(x)+1)", "x^2.5 + 2^x - abs(x)^0.3", "sin(exp(cos(x)))^3" })
+    {
+        const auto exact_func = parser::compile(parser::s_yard(s, "x"), "x");
+        auto func = exact_func;
+        parser::approximate(func, accuracy::FAST);
+        std::vector<double> batch(grid.size());
+        func.evaluate(grid, batch);
+        //these stay with the interpreter, see jit::compile
+        bool passed = func.math == accuracy::FAST && !jit::compile(func);
+        for (size_t i = 0; i < grid.size(); i++)
+        {
+            const double fast = func(grid[i]);
+            const double real = exact_func(grid[i]);
+            passed &= std::abs(fast - real) <= 1e-13 * std::max(1.0, std::abs(real)) || (std::isnan(fast) && std::isnan(real));
+            passed &= ulp_distance(batch[i], fast) == 0.0;
+        }
+        parser::approximate(func, accuracy::EXACT);
+        for (size_t i = 0; i < func.code.size(); i++)
+        {
+            passed &= func.code[i].func == exact_func.code[i].func && func.code[i].batch_func == exact_func.code[i].batch_func;
+        }
+        passed &= func.power == exact_func.power && func.batch_power == nullptr;
+        std::cout << "approx test on: " << s << (passed ? " passed" : " failed") << '\n';
+    }
+}
+
+//differential test of the native backend against build_func over random inputs
+void jit_tests()
+{
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> dist(-10.0, 10.0);
+    std::vector<double> xs(10'003); //not a multiple of four so the scalar tail runs too
+    for (auto& x : xs)
+    {
+        x = dist(rng);
+    }
+    std::vector<double> ys(xs.size());
+
+    auto exprs = test_expressions();
+    exprs.insert(exprs.end(), { "1-2^3*4", "x^x - 2*x", "sqrt(abs(x))*x/3 + exp(0-x^2)" });
+    for (const auto& s : exprs)
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        const auto tree = parser::build_func(rpn, "x");
+        const auto native = jit::compile(parser::compile(rpn, "x"));
+        if (!native)
+        {
+            std::cout << "jit test on: " << s << " skipped, no native backend\n";
+            continue;
+        }
+        native->batch()(xs.data(), ys.data(), xs.size());
+        bool passed = true;
+        for (size_t i = 0; i < xs.size(); i++)
+        {
+            const double real = tree(xs[i]);
+            const double scalar = native->scalar()(xs[i]);
+            const bool nan = std::isnan(real);
+            if ((nan != std::isnan(scalar) || nan != std::isnan(ys[i])) ||
+                (!nan && (!equality(real, scalar) || !equality(real, ys[i])) && !(real == scalar && real == ys[i])))
+            {
+                passed = false;
+            }
+        }
+        std::cout << "jit test on: " << s << (passed ? " passed" : " failed") << '\n';
+    }
+
+    //memory that can't be mapped or made executable is a fallback to the interpreter, not an exception
+    std::cout << "jit test on: empty code" << (!jit::jit_func::create({}, 0) ? " passed" : " failed") << '\n';
+    const std::vector<uint8_t> ret = { 0xc3 };
+    const bool refused = !jit::jit_func::create(ret, 0, [](void*, size_t) { return false; });
+    const bool allowed = jit::jit_func::create(ret, 0) != nullptr;
+    std::cout << "jit test on: executable mapping refused" << (refused && allowed ? " passed" : " failed") << '\n';
+}
+
+//one formula as a static_expr against build_func, which it has to match bit for bit, and compile
+template<parser::fixed_string str>
+void static_test(std::span<const double> xs)
+{
+    const parser::static_expr<str> fixed;
+    const auto rpn = parser::s_yard(str.view(), "x");
+    const auto tree = parser::build_func(rpn, "x");
+    const auto compiled = parser::compile(rpn, "x", parser::opt_level::FULL);
+    bool passed = true;
+    for (const double x : xs)
+    {
+        const double value = fixed(x);
+        passed &= ulp_distance(value, tree(x)) == 0.0;
+        passed &= std::abs(value - compiled(x)) <= 1e-12 * std::max(1.0, std::abs(value)) || (std::isnan(value) && std::isnan(compiled(x)));
+    }
+    std::cout << "static test on: " << str.view() << (passed ? " passed" : " failed") << "... " << fixed(xs[0]) << " " << tree(xs[0]) << '\n';
+}
+
+void static_tests()
+{
+    std::vector<double> xs(1001);
+    for (size_t i = 0; i < xs.size(); i++)
+    {
+        xs[i] = -5.0 + 10.0 * static_cast<double>(i) / static_cast<double>(xs.size() - 1);
+    }
+    static_test<"x+2+5 + 6 + 10">(xs);
+    static_test<"cos( sin(tan(x)) )">(xs);
+    static_test<"x+ 10 *(5 +2)">(xs);
+    static_test<"-x + 1 - (3 + 2)">(xs);
+    static_test<"x^2 + sin(x)*3.5 - -1">(xs); //the second minus is unary minus of everything before it, as in build_tree
+    static_test<"2^3^2 - x/2/3 + x*pi/e">(xs);
+    static_test<"0.1 + 0.7*x - 3.14159265358979 + 12345.678901">(xs);
+    static_test<"sqrt(abs(x)) + cbrt(x) - exp(x/4)*log(abs(x)+1) + log10(abs(x)+2)">(xs);
+    static_test<"asin(sin(x))+acos(cos(x))+atan(tan(x))">(xs);
+    static_test<"sinh(x/5)*cosh(x/5)-tanh(x) + asinh(x)+acosh(abs(x)+1)+atanh(x/(abs(x)+1))">(xs);
+    static_test<"tgamma(abs(x)/2+0.5)+lgamma(abs(x)+1) + floor(x)+ceil(x)-trunc(x)">(xs);
+    static_test<"x/(1+x/(2+x/(3+x/(4+x/5))))">(xs);
+
+    //more variables, and no variables at all, which is a constant expression
+    const parser::static_expr<"sin(x*y) + x^2/y - t", "x,y,t"> multi;
+    const std::string_view names[] = { "x", "y", "t" };
+    const auto compiled = parser::compile(parser::s_yard("sin(x*y) + x^2/y - t", names), names);
+    const double vars[] = { 0.7, 1.9, -0.3 };
+    static_assert(parser::static_expr<"(1+2)*3 - 4/8", "">{}() == 8.5);
+    static_assert(decltype(multi)::num_vars == 3);
+    const bool passed = multi(0.7, 1.9, -0.3) == multi(vars) && std::abs(multi(vars) - compiled(vars)) < 1e-15;
+    std::cout << "static test on: three variables" << (passed ? " passed" : " failed") << "... " << multi(vars) << " " << compiled(vars) << '\n';
+}
+
+void cache_tests()
+{
+    const size_t budget = 16 * jit::jit_func::page_size(); //native code takes a page per entry
+    expr_cache cache(budget);
+    const auto a = cache.get("pi + 1", "x");
+    const auto b = cache.get(" pi+1 ", "x");
+    const auto c = cache.get("pi+1", "t"); //same text, different variable
+    auto stats = cache.get_stats();
+    if (a != b || a == c || stats.hits != 1 || stats.misses != 2)
+        std::cout << "cache test on: normalized keys failed... hits " << stats.hits << " misses " << stats.misses << '\n';
+    else
+        std::cout << "cache test on: normalized keys passed\n";
+
+    //spaces inside what would be one token change the tokens, so they have to change the key
+    for (const auto& [spaced, joined] : { std::pair{ "co sx", "cosx" }, std::pair{ "log 10(x)", "log10(x)" }, std::pair{ "2 3", "23" } })
+    {
+        bool apart = expr_cache::normalize(spaced, "x") != expr_cache::normalize(joined, "x");
+        //each one has to parse or fail the same as it does on its own, whichever came first
+        const auto parses = [](expr_cache& c, const char* str)
+        {
+            try
+            {
+                c.get(str, "x");
+                return true;
+            }
+            catch (const parser::parse_error&)
+            {
+                return false;
+            }
+        };
+        for (const auto* str : { spaced, joined })
+        {
+            expr_cache alone(4096);
+            apart &= parses(cache, str) == parses(alone, str);
+        }
+        std::cout << "cache test on: " << spaced << " vs " << joined << (apart ? " passed" : " failed") << '\n';
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        cache.get("x*" + std::to_string(i), "x");
+    }
+    stats = cache.get_stats();
+    if (stats.bytes > budget || stats.evictions == 0 || !cache.contains("x*999", "x") || cache.contains("pi+1", "x"))
+        std::cout << "cache test on: eviction failed... bytes " << stats.bytes << " evictions " << stats.evictions << '\n';
+    else
+        std::cout << "cache test on: eviction passed... entries " << stats.entries << " evictions " << stats.evictions << '\n';
+
+    expr_cache single(1 << 20);
+    const auto func = single.get("x*2", "x");
+    const size_t native = func->native ? func->native->mapped_size() : 0;
+    const bool counted = single.get_stats().bytes > native + func->code.size() * sizeof(parser::instruction)
+                         && native % jit::jit_func::page_size() == 0;
+    std::cout << "cache test on: native code size" << (counted ? " passed... " : " failed... ") << native << " bytes mapped\n";
+}
+
+//once warmed up the arena compiler must parse without touching the heap,
+//and compile to the same code as the string based path
+void alloc_tests()
+{
+    arena mem(64);
+    void* first = mem.allocate(48, 8);
+    const void* aligned = mem.allocate(100, 64);
+    mem.reset(); //merges the two blocks into one
+    static_cast<void>(mem.allocate(48, 8));
+    static_cast<void>(mem.allocate(100, 64));
+    const size_t merged = mem.capacity();
+    mem.reset();
+    if (reinterpret_cast<uintptr_t>(aligned) % 64 || mem.allocate(48, 8) == first || mem.capacity() != merged)
+        std::cout << "alloc test on: arena reset failed\n";
+    else
+        std::cout << "alloc test on: arena reset passed\n";
+
+    std::vector<std::string> exprs = test_expressions();
+    exprs.push_back("1 + x + x^2/2 + x^3/6 + x^4/24 + x^5/120 + x^6/720 + x^7/5040 + x^8/40320 + x^9/362880");
+    exprs.push_back("1+(2+(3+(4+(5+(6+(7+(8+(9+(10+(11+(12+(13+(14+(15+(16+x)))))))))))))))");
+    exprs.push_back("sin(cos(tan(sin(cos(tan(sin(cos(tan(x)))))))))");
+    exprs.push_back("log(abs(sin(x))+1)*sqrt(abs(cos(x)))+atan(x^3)");
+
+    parser::compiler comp;
+    parser::compiled_func func;
+    for (const auto& s : exprs)
+    {
+        comp.compile(s, "x", func);
+        const auto expected = parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL);
+        bool passed = func.code.size() == expected.code.size() && func.stack_depth == expected.stack_depth;
+        for (const double x : { -2.5, -0.5, 0.0, 0.75, 3.0 })
+        {
+            const double a = func(x);
+            const double b = expected(x);
+            passed = passed && (a == b || (std::isnan(a) && std::isnan(b)));
+        }
+        if (!passed)
+            std::cout << "alloc test on: " << s << " failed... differs from the string based compile\n";
+    }
+
+#ifdef ALLOCATION_COUNTING_ENABLED
+    const size_t before = heap_allocations;
+    for (int round = 0; round < 3; round++)
+    {
+        for (const auto& s : exprs)
+        {
+            comp.compile(s, "x", func);
+        }
+    }
+    const size_t allocations = heap_allocations - before;
+
+    const std::string_view names[] = { "x", "y", "t" };
+    comp.compile("x*y + sin(t) - y^x", names, func);
+    const size_t before_vars = heap_allocations;
+    comp.compile("x*y + sin(t) - y^x", names, func);
+    const size_t var_allocations = heap_allocations - before_vars;
+
+    if (allocations || var_allocations)
+        std::cout << "alloc test on: warm parses failed... " << allocations + var_allocations << " heap allocations\n";
+    else
+        std::cout << "alloc test on: warm parses passed... 0 heap allocations over " << 3 * exprs.size() + 1 << " parses, arena "
+                  << comp.arena_size() << " bytes\n";
+#else
+    std::cout << "alloc test on: warm parses skipped, ALLOCATION_COUNTING_ENABLED is off\n";
+#endif
+}
+
+//plots func by drawing a point for every one of samples_per_unit uniform samples
+//so dense that it serves as the reference adaptive sampling is measured against
+std::vector<uint32_t> plot_reference(const parser::compiled_func& func, int range_lower, int range_upper, int samples_per_unit)
+{
+    std::vector<uint32_t> data(screen_w * screen_h, black);
+    const pixel_buffer buf{ data.data(), screen_w, screen_h };
+    for (long long x = static_cast<long long>(range_lower) * samples_per_unit; x < static_cast<long long>(range_upper) * samples_per_unit; x++)
+    {
+        const double tx = x / static_cast<double>(samples_per_unit);
+        const pt_2d p = to_screen(buf, tx, func(tx), range_upper);
+        if (buf.inside(p.x, p.y))
+        {
+            data[p.x + p.y * screen_w] = yellow;
+        }
+    }
+    return data;
+}
+
+//fraction of the reference pixels that are set in data, counting a pixel
+//as covered if data has one within a pixel of it, blended pixels count as set
+double plot_coverage(const std::vector<uint32_t>& data, const std::vector<uint32_t>& reference)
+{
+    size_t total = 0;
+    size_t covered = 0;
+    for (int y = 1; y < screen_h - 1; y++)
+    {
+        for (int x = 1; x < screen_w - 1; x++)
+        {
+            if (reference[x + y * screen_w] != yellow)
+            {
+                continue;
+            }
+            ++total;
+            bool found = false;
+            for (int dy = -1; dy <= 1 && !found; dy++)
+            {
+                for (int dx = -1; dx <= 1 && !found; dx++)
+                {
+                    found = data[(x + dx) + (y + dy) * screen_w] != black;
+                }
+            }
+            covered += found;
+        }
+    }
+    return total ? covered / static_cast<double>(total) : 1.0;
+}
+
+//the parallel plot must not depend on the pool size, and must cover the dense reference
+void plot_tests()
+{
+    const std::vector<std::string> exprs = { "sin(x)", "x^2/4", "tan(x)", "1/x", "sqrt(x)*2" };
+    std::vector<parser::compiled_func> funcs;
+    std::vector<const parser::compiled_func*> func_ptrs;
+    for (const auto& s : exprs)
+    {
+        funcs.push_back(parser::compile(parser::s_yard(s, "x"), "x"));
+    }
+    for (const auto& func : funcs)
+    {
+        func_ptrs.push_back(&func);
+    }
+
+    std::vector<uint32_t> expected(screen_w * screen_h, black);
+    thread_pool serial(0);
+    plot_all({ expected.data(), screen_w, screen_h }, -5, 5, func_ptrs, serial);
+    for (const unsigned workers : { 1u, 3u, 7u })
+    {
+        thread_pool pool(workers);
+        std::vector<uint32_t> data(screen_w * screen_h, black);
+        plot_all({ data.data(), screen_w, screen_h }, -5, 5, func_ptrs, pool);
+        std::cout << "plot test with " << workers << " workers" << (data == expected ? " passed" : " failed") << '\n';
+    }
+
+    //a throwing task reaches the caller once the rest are done, whichever thread ran it
+    for (const unsigned workers : { 0u, 3u })
+    {
+        thread_pool pool(workers);
+        std::atomic<size_t> ran = 0;
+        std::string what;
+        try
+        {
+            pool.parallel_for(64, [&](size_t i)
+            {
+                ++ran;
+                if (i % 7 == 3)
+                {
+                    throw std::runtime_error("task " + std::to_string(i));
+                }
+            });
+        }
+        catch (const std::runtime_error& exc)
+        {
+            what = exc.what();
+        }
+        size_t after = 0;
+        pool.parallel_for(8, [&](size_t) { ++after; }); //still usable
+        std::cout << "pool test with " << workers << " workers: exceptions" << (what.starts_with("task ") && ran >= 1 && after == 8 ? " passed" : " failed")
+                  << "... " << ran << " of 64 tasks ran\n";
+    }
+
+    for (const auto& func : funcs)
+    {
+        std::vector<uint32_t> data(screen_w * screen_h, black);
+        plot_all({ data.data(), screen_w, screen_h }, -5, 5, std::span(&func_ptrs[&func - funcs.data()], 1), serial);
+        const double coverage = plot_coverage(data, plot_reference(func, -5, 5, 100'000));
+        std::cout << "plot coverage test on: " << exprs[&func - funcs.data()] << (coverage > 0.99 ? " passed... " : " failed... ") << coverage << '\n';
+    }
+}
+
+//interval evaluation against point values inside each interval, the poles, and plots culled by it
+void interval_tests()
+{
+    std::vector<std::string> exprs;
+    for (const auto& name : std::views::keys(parser::unary_func_tbl))
+    {
+        exprs.push_back(std::string(name) + "(x)");
+    }
+    std::sort(exprs.begin(), exprs.end());
+    exprs.insert(exprs.end(), { "x^2 - x", "x/(x-1)", "x^3", "x^4", "x^(0-3)", "2^x", "x^0.5", "x^x", "sin(x)*cos(x)*x", "tgamma(x)/lgamma(x+5)" });
+
+    const std::pair<double, double> ranges[] = { { -3.7, -3.2 }, { -2.5, -2.1 }, { -1.9, -1.1 }, { -1.0, 1.0 }, { -0.5, 0.5 }, { 0.2, 1.9 },
+                                                 { 1.0, 2.0 }, { 0.9, 0.95 }, { -10.0, 10.0 }, { 100.0, 101.0 }, { 3.0, 3.0 } };
+    for (const auto& s : exprs)
+    {
+        const auto func = parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL);
+        bool passed = true;
+        for (const auto& [lo, hi] : ranges)
+        {
+            const parser::interval bounds = func.evaluate_interval(parser::interval{ lo, hi });
+            for (int i = 0; i <= 2000; i++)
+            {
+                const double y = func(lo + (hi - lo) * i / 2000.0);
+                passed &= std::isnan(y) || (bounds.lo <= y && y <= bounds.hi);
+                passed &= !bounds.continuous || std::isfinite(y);
+            }
+        }
+        std::cout << "interval test on: " << s << (passed ? " passed" : " failed") << '\n';
+    }
+
+    //poles and domains give infinite, empty or discontinuous bounds, other ranges stay tight
+    const auto bounds = [](std::string_view s, double lo, double hi)
+    {
+        return parser::compile(parser::s_yard(s, "x"), "x").evaluate_interval(parser::interval{ lo, hi });
+    };
+    const auto entire = [](parser::interval y) { return y.lo == -parser::infinity && y.hi == parser::infinity && !y.continuous; };
+    const auto near = [](parser::interval y, double lo, double hi) { return std::abs(y.lo - lo) < 1e-12 && std::abs(y.hi - hi) < 1e-12; };
+    const bool poles = entire(bounds("tan(x)", 1.0, 2.0)) && entire(bounds("tgamma(x)", -0.5, 0.5)) && entire(bounds("1/x", -1.0, 1.0))
+        && bounds("log(x)", 0.0, 1.0).lo == -parser::infinity && !bounds("log(x)", 0.0, 1.0).continuous
+        && bounds("sqrt(x)", -2.0, -1.0).empty() && !bounds("sqrt(x)", -1.0, 1.0).continuous
+        && !bounds("floor(x)", 0.5, 1.5).continuous && bounds("floor(x)", 0.2, 0.8).continuous
+        && bounds("tgamma(x)", -1.9, -1.1).continuous && near(bounds("tgamma(x)", 1.0, 2.0), 0.8856031944108887, 1.0)
+        && near(bounds("x^2", -1.0, 2.0), 0.0, 4.0) && near(bounds("sin(x)", 0.0, 2.0), 0.0, 1.0) && near(bounds("cos(x)", 3.0, 4.0), -1.0, std::cos(4.0));
+    std::cout << "interval test on: poles and domains" << (poles ? " passed" : " failed") << '\n';
+
+    //a curve that never reaches the screen needs no evaluations, a spike narrower than
+    //the coarse samples that comes into view between two of them below the screen is found
+    std::vector<uint32_t> data(screen_w * screen_h, black);
+    const size_t off_screen = plot({ data.data(), screen_w, screen_h }, -5, 5, parser::compile(parser::s_yard("x^2+20", "x"), "x"));
+    std::cout << "interval test on: off screen curve" << (off_screen == 0 ? " passed" : " failed") << "... " << off_screen << " evals\n";
+    const auto spike = parser::compile(parser::s_yard("30/(1+(1000*(x-0.3))^2)-15", "x"), "x");
+    plot({ data.data(), screen_w, screen_h }, -5, 5, spike);
+    const double coverage = plot_coverage(data, plot_reference(spike, -5, 5, 100'000));
+    std::cout << "interval test on: narrow spike" << (coverage > 0.99 ? " passed... " : " failed... ") << coverage << '\n';
+}
+
+//random lines from a fixed seed, about a third of them reach past the edges of a w x h buffer
+std::vector<std::pair<pt_2d, pt_2d>> random_lines(size_t count, int w, int h, int max_len)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> px(-w / 4, w + w / 4);
+    std::uniform_int_distribution<int> py(-h / 4, h + h / 4);
+    std::uniform_int_distribution<int> len(-max_len, max_len);
+    std::vector<std::pair<pt_2d, pt_2d>> lines;
+    for (size_t i = 0; i < count; i++)
+    {
+        const pt_2d a = { px(rng), py(rng) };
+        lines.push_back({ a, { a.x + len(rng), a.y + len(rng) } });
+    }
+    return lines;
+}
+
+//draw_line against the bresenham invariants, and banded drawing against one pass
+void raster_tests()
+{
+    constexpr int w = 200;
+    constexpr int h = 150;
+    const auto lines = random_lines(2000, w, h, 120);
+
+    bool exact = true;
+    for (const auto& [a, b] : lines)
+    {
+        if (!(pixel_buffer{ nullptr, w, h }.inside(a.x, a.y) && pixel_buffer{ nullptr, w, h }.inside(b.x, b.y)))
+        {
+            continue;
+        }
+        std::vector<uint32_t> data(w * h, black);
+        draw_line({ data.data(), w, h }, a, b, yellow, 0, h);
+        const auto count = std::count(data.begin(), data.end(), yellow);
+        exact &= count == std::max(std::abs(b.x - a.x), std::abs(b.y - a.y)) + 1;
+        exact &= data[a.x + a.y * w] == yellow && data[b.x + b.y * w] == yellow;
+    }
+    std::cout << "raster test on: one pixel per step, both ends drawn" << (exact ? " passed" : " failed") << '\n';
+
+    for (const bool aa : { false, true })
+    {
+        std::vector<uint32_t> whole(w * h, black);
+        std::vector<uint32_t> banded(w * h, black);
+        for (const auto& [a, b] : lines)
+        {
+            if (aa)
+            {
+                draw_line_aa({ whole.data(), w, h }, a.x, a.y, b.x + 0.5, b.y + 0.25, yellow, 0, h);
+            }
+            else
+            {
+                draw_line({ whole.data(), w, h }, a, b, yellow, 0, h);
+            }
+        }
+        for (int row = 0; row < h; row += 7)
+        {
+            for (const auto& [a, b] : lines)
+            {
+                if (aa)
+                {
+                    draw_line_aa({ banded.data(), w, h }, a.x, a.y, b.x + 0.5, b.y + 0.25, yellow, row, row + 7);
+                }
+                else
+                {
+                    draw_line({ banded.data(), w, h }, a, b, yellow, row, row + 7);
+                }
+            }
+        }
+        bool border = true;
+        for (int i = 0; i < w * h; i++)
+        {
+            border &= whole[i] == black || pixel_buffer{ nullptr, w, h }.inside(i % w, i / w);
+        }
+        std::cout << "raster test on: " << (aa ? "wu " : "") << "bands match one pass" << (whole == banded ? " passed" : " failed") << '\n';
+        std::cout << "raster test on: " << (aa ? "wu " : "") << "clipped to the border" << (border ? " passed" : " failed") << '\n';
+    }
+
+    //a horizontal wu line on a pixel row is solid and leaves out its last pixel
+    std::vector<uint32_t> data(w * h, black);
+    draw_line_aa({ data.data(), w, h }, 5, 10, 20, 10, yellow, 0, h);
+    const bool solid = std::count(data.begin(), data.end(), yellow) == 15 && data[5 + 10 * w] == yellow && data[20 + 10 * w] == black;
+    std::cout << "raster test on: wu horizontal line" << (solid ? " passed" : " failed") << '\n';
+}
+
+//true if no channel of a and b differs by more than tolerance
+bool pixels_close(std::span<const uint32_t> a, std::span<const uint32_t> b, int tolerance)
+{
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            if (std::abs(static_cast<int>(a[i] >> shift & 0xFF) - static_cast<int>(b[i] >> shift & 0xFF)) > tolerance)
+            {
+                return false;
+            }
+        }
+    }
+    return a.size() == b.size();
+}
+
+//the row major canvas against its definition, the background cache and composition
+void layer_tests()
+{
+    for (const auto& [w, h] : { std::pair{ screen_w, screen_h }, std::pair{ 301, 97 } })
+    {
+        std::vector<uint32_t> data(w * h, white);
+        create_canvas({ data.data(), w, h });
+        bool same = true;
+        for (int y = 0; y < h; y++)
+        {
+            for (int x = 0; x < w; x++)
+            {
+                const bool axis = x == w / 2 || y == h / 2;
+                const bool grid = (x > 0 && x % grid_spacing == 0) || (y > 0 && y % grid_spacing == 0);
+                same &= data[x + y * w] == (axis ? red : grid ? green : black);
+            }
+        }
+        std::cout << "layer test on: canvas " << w << "x" << h << (same ? " passed" : " failed") << '\n';
+    }
+
+    layered_canvas layers(screen_w, screen_h);
+    std::vector<uint32_t> frame(screen_w * screen_h);
+    const pixel_buffer out{ frame.data(), screen_w, screen_h };
+    layers.set_viewport(-5, 5);
+    layers.compose(out);
+    layers.compose(out);
+    layers.set_viewport(-5, 5);
+    layers.compose(out);
+    const bool cached = layers.get_background_builds() == 1;
+    layers.set_viewport(-6, 6);
+    layers.compose(out);
+    std::cout << "layer test on: background cache" << (cached && layers.get_background_builds() == 2 ? " passed" : " failed") << '\n';
+
+    //curves drawn into their layer and composed look like curves drawn straight onto the canvas
+    std::vector<parser::compiled_func> funcs;
+    std::vector<const parser::compiled_func*> func_ptrs;
+    for (const std::string s : { "sin(x)", "x^2/4", "tan(x)" })
+    {
+        funcs.push_back(parser::compile(parser::s_yard(s, "x"), "x"));
+    }
+    for (const auto& func : funcs)
+    {
+        func_ptrs.push_back(&func);
+    }
+    std::vector<uint32_t> direct(frame.size());
+    create_canvas({ direct.data(), screen_w, screen_h });
+    const size_t fresh_evals = plot_all({ direct.data(), screen_w, screen_h }, -6, 6, func_ptrs);
+    layers.set_viewport(-5, 5);
+    for (const auto& func : funcs)
+    {
+        layers.add_curve(std::make_shared<const parser::compiled_func>(func), yellow);
+    }
+    layers.compose(out);
+    layers.set_viewport(-6, 6);
+    const size_t zoom_evals = layers.update();
+    layers.compose(out);
+    //anti-aliased pixels a curve covers twice round once more on its own layer
+    std::cout << "layer test on: composed curves" << (pixels_close(frame, direct, 4) ? " passed" : " failed") << '\n';
+    std::cout << "layer test on: zoom reuses samples" << (zoom_evals < fresh_evals / 2 ? " passed" : " failed")
+              << "... " << zoom_evals << " of " << fresh_evals << " evaluations\n";
+    //everything needed for the old range is still in the stores
+    layers.set_viewport(-5, 5);
+    const size_t back_evals = layers.update();
+    layers.set_viewport(-6, 6);
+    const size_t again_evals = layers.update();
+    layers.compose(out);
+    const auto stats = layers.get_sample_stats();
+    std::cout << "layer test on: zoom back and forth" << (back_evals == 0 && again_evals == 0 && pixels_close(frame, direct, 4) ? " passed" : " failed")
+              << "... hit ratio " << static_cast<double>(stats.hits) / (stats.hits + stats.misses) << '\n';
+
+    //hiding, recoloring and removing curves only composes again
+    std::vector<uint32_t> background(frame.size());
+    create_canvas({ background.data(), screen_w, screen_h });
+    for (size_t i = 0; i < layers.curve_count(); i++)
+    {
+        layers.set_visible(i, false);
+    }
+    size_t evals = layers.update();
+    layers.compose(out);
+    const bool hidden = frame == background;
+    layers.set_visible(1, true);
+    layers.set_color(1, cyan);
+    layers.remove_curve(2);
+    layers.remove_curve(0);
+    evals += layers.update();
+    layers.compose(out);
+    std::vector<uint32_t> recolored = background;
+    plot_job recolored_job{ func_ptrs[1], { recolored.data(), screen_w, screen_h }, cyan };
+    plot_jobs(std::span(&recolored_job, 1), -6, 6);
+    std::cout << "layer test on: toggle and recolor" << (hidden && evals == 0 && pixels_close(frame, recolored, 2) ? " passed" : " failed") << '\n';
+
+    //a half covered pixel on the transparent layer ends up halfway between curve and grid
+    uint32_t layer_pixel = 0;
+    uint32_t canvas_pixel = green;
+    blend(layer_pixel, yellow, 0.5);
+    blend(canvas_pixel, yellow, 0.5);
+    const uint32_t composed = over(layer_pixel, green);
+    std::cout << "layer test on: premultiplied blend" << (pixels_close(std::span(&composed, 1), std::span(&canvas_pixel, 1), 2) ? " passed" : " failed") << '\n';
+}
+
+//fields against direct evaluation, a circle and a graph traced by marching squares,
+//the heatmap ramp at its ends and tiled results that don't depend on the pool
+void field_tests()
+{
+    const std::string_view names[] = { "x", "y" };
+    const auto compile_field = [&](std::string_view s)
+    {
+        return parser::compile(parser::s_yard(s, names), names, parser::opt_level::FULL);
+    };
+    const double scale = screen_w / 5.0 / 2.0;
+
+    //odd sizes leave partial tiles on both edges
+    const auto wave = compile_field("sin(x*y) + y/3");
+    std::vector<double> values;
+    evaluate_field(301, 97, 5, wave, values);
+    bool same = values.size() == 301 * 97;
+    for (const auto& [px, py] : { std::pair{ 0, 0 }, std::pair{ 300, 96 }, std::pair{ 64, 64 }, std::pair{ 150, 48 }, std::pair{ 299, 1 } })
+    {
+        const double vars[] = { (301 / 2 - px) / (301 / 5.0 / 2.0), (py - 97 / 2) / (301 / 5.0 / 2.0) };
+        same &= equality(values[py * 301 + px], wave(vars));
+    }
+    std::cout << "field test on: tiled evaluation" << (same ? " passed" : " failed") << '\n';
+
+    std::vector<uint32_t> circle(screen_w * screen_h, black);
+    plot_field({ circle.data(), screen_w, screen_h }, 5, compile_field("x^2 + y^2 - 16"), field_mode::IMPLICIT);
+    bool on_circle = true;
+    size_t count = 0;
+    for (int y = 0; y < screen_h; y++)
+    {
+        for (int x = 0; x < screen_w; x++)
+        {
+            //anti-aliased lines spread each step over two pixels, only one is at least half covered
+            if (circle[y * screen_w + x] != black)
+            {
+                count += (circle[y * screen_w + x] >> 16 & 0xFF) >= 0x80;
+                on_circle &= std::abs(std::hypot(x - screen_w / 2, y - screen_h / 2) - 4 * scale) < 2.0;
+            }
+        }
+    }
+    //a thin 8-connected circle has about 2 sqrt(2) / pi pixels per unit of length
+    const double expected = 2 * std::numbers::pi * 4 * scale * 2 * std::numbers::sqrt2 / std::numbers::pi;
+    std::cout << "field test on: implicit circle" << (on_circle && count > expected * 0.85 && count < expected * 1.2 ? " passed" : " failed")
+              << "... " << count << " pixels\n";
+
+    //y = sin(x) traced as a field lands where the graph is plotted
+    std::vector<uint32_t> implicit(screen_w * screen_h, black);
+    std::vector<uint32_t> graph(implicit.size(), black);
+    plot_field({ implicit.data(), screen_w, screen_h }, 5, compile_field("y - sin(x)"), field_mode::IMPLICIT);
+    plot({ graph.data(), screen_w, screen_h }, -5, 5, parser::compile(parser::s_yard("sin(x)", "x"), "x"));
+    size_t near = 0;
+    count = 0;
+    for (int y = 1; y < screen_h - 1; y++)
+    {
+        for (int x = 1; x < screen_w - 1; x++)
+        {
+            if (implicit[y * screen_w + x] != black)
+            {
+                ++count;
+                bool found = false;
+                for (int d = 0; d < 9; d++)
+                {
+                    found |= graph[(y + d / 3 - 1) * screen_w + x + d % 3 - 1] != black;
+                }
+                near += found;
+            }
+        }
+    }
+    std::cout << "field test on: implicit graph" << (count > 0 && near == count ? " passed" : " failed") << "... " << near << " of " << count << '\n';
+
+    //x + y is lowest in the top right corner and highest in the bottom left one
+    std::vector<uint32_t> heatmap(301 * 97, black);
+    const size_t evals = plot_field({ heatmap.data(), 301, 97 }, 5, compile_field("x + y"), field_mode::HEATMAP);
+    const bool ends = heatmap[300] == over(heatmap_color(0.0), black) && heatmap[96 * 301] == over(heatmap_color(1.0), black);
+    std::vector<uint32_t> serial_heatmap(heatmap.size(), black);
+    std::vector<uint32_t> serial_circle(circle.size(), black);
+    thread_pool serial(0);
+    plot_field({ serial_heatmap.data(), 301, 97 }, 5, compile_field("x + y"), field_mode::HEATMAP, yellow, serial);
+    plot_field({ serial_circle.data(), screen_w, screen_h }, 5, compile_field("x^2 + y^2 - 16"), field_mode::IMPLICIT, yellow, serial);
+    std::cout << "field test on: heatmap" << (ends && evals == heatmap.size() ? " passed" : " failed") << '\n';
+    std::cout << "field test on: same with 1 worker" << (serial_heatmap == heatmap && serial_circle == circle ? " passed" : " failed") << '\n';
+
+    //a field layer composes like the field drawn straight onto the canvas, in both modes
+    layered_canvas layers(screen_w, screen_h);
+    std::vector<uint32_t> frame(screen_w * screen_h);
+    std::vector<uint32_t> direct(frame.size());
+    layers.set_viewport(-5, 5);
+    layers.add_field(std::make_shared<const parser::compiled_func>(compile_field("x^2 + y^2 - 16")), field_mode::HEATMAP, yellow);
+    bool composed = true;
+    for (const auto mode : { field_mode::HEATMAP, field_mode::IMPLICIT })
+    {
+        layers.set_field_mode(0, mode);
+        layers.compose({ frame.data(), screen_w, screen_h });
+        create_canvas({ direct.data(), screen_w, screen_h });
+        plot_field({ direct.data(), screen_w, screen_h }, 5, compile_field("x^2 + y^2 - 16"), mode);
+        composed &= pixels_close(frame, direct, 2);
+    }
+    std::cout << "field test on: field layer" << (composed ? " passed" : " failed") << '\n';
+}
+
+//a store over its memory cap keeps the points around the middle of the last plot
+//and plots through it still match plots without one
+void sample_store_tests()
+{
+    const auto func = parser::compile(parser::s_yard("sin(x)*x", "x"), "x");
+    std::vector<uint32_t> direct(screen_w * screen_h, black);
+    std::vector<uint32_t> stored(direct.size(), black);
+    const size_t fresh_evals = plot({ direct.data(), screen_w, screen_h }, -8, 8, func);
+
+    sample_store store(256 * sizeof(std::pair<double, double>));
+    std::vector<curve_sample> samples;
+    plot_job job{ &func, { stored.data(), screen_w, screen_h }, yellow, &store, &samples };
+    size_t evals = 0;
+    for (const int range : { 4, 8, 6, 8 })
+    {
+        std::fill(stored.begin(), stored.end(), black);
+        evals += plot_jobs(std::span(&job, 1), -range, range);
+        store.add(samples, -range, range);
+    }
+    const auto stats = store.get_stats();
+    const bool capped = stats.entries == 256 && stats.evictions > 0 && stats.bytes <= 256 * sizeof(std::pair<double, double>);
+    std::cout << "sample store test on: memory cap" << (capped && stats.misses == evals ? " passed" : " failed")
+              << "... entries " << stats.entries << " evictions " << stats.evictions << '\n';
+    std::cout << "sample store test on: plot through store" << (stored == direct && job.evals < fresh_evals ? " passed" : " failed")
+              << "... " << job.evals << " of " << fresh_evals << " evaluations\n";
+}
+
+//evaluates expr over input with evaluate_stream, the input read through a temporary
+//file or the mapped file at path, returns the output or the error
+std::string stream_text(std::string_view expr, std::span<const std::string_view> names, const std::string& input,
+                        bool binary_in = false, bool binary_out = false, const std::filesystem::path& path = {})
+{
+    std::FILE* in_file = std::tmpfile();
+    std::FILE* out = std::tmpfile();
+    std::fwrite(input.data(), 1, input.size(), in_file);
+    std::rewind(in_file);
+    if (!path.empty())
+    {
+        std::ofstream(path, std::ios::binary).write(input.data(), input.size());
+    }
+    std::string res;
+    try
+    {
+        const auto func = parser::compile(parser::s_yard(expr, names), names, parser::opt_level::FULL);
+        auto in = path.empty() ? std::make_unique<input_source>(in_file) : std::make_unique<input_source>(path);
+        evaluate_stream(func, *in, out, binary_in, binary_out);
+        std::rewind(out);
+        char buf[1 << 16];
+        for (size_t n; (n = std::fread(buf, 1, sizeof(buf), out)) != 0;)
+        {
+            res.append(buf, n);
+        }
+    }
+    catch (const std::runtime_error& exc)
+    {
+        res = exc.what();
+    }
+    std::fclose(in_file);
+    std::fclose(out);
+    return res;
+}
+
+//text and binary rows through a buffered and a mapped input, several blocks and a row longer than a read
+void stream_tests()
+{
+    const std::string_view xy[] = { "x", "y" };
+    const std::string_view x[] = { "x" };
+    const std::pair<std::string, std::string> cases[] = {
+        { "1 2\n3,4\r\n\n  5\t6", "3\n13\n31\n" },
+        { "1 2 3\n", "line 1: more than 2 values" },
+        { "1 2\n4\n", "line 2: expected 2 values" },
+        { "1 2\nfoo 1\n", "line 2: not a number: foo" },
+        { "1 2\n3 4x\n", "line 2: not a number: 4x" } };
+    for (size_t i = 0; i < std::size(cases); i++)
+    {
+        const std::string res = stream_text("x*y+1", xy, cases[i].first);
+        std::cout << "stream test on: rows " << i << (res == cases[i].second ? " passed" : " failed") << "... " << res << '\n';
+    }
+
+    //rows over several blocks, one of them padded past the read size
+    std::string text;
+    std::string binary;
+    std::string expected;
+    const auto func = parser::compile(parser::s_yard("sin(x)*x+1", "x"), "x", parser::opt_level::FULL);
+    for (size_t i = 0; i < 3 * stream_block_rows + 17; i++)
+    {
+        const double v = i * 0.25 - 1000.0;
+        if (i == stream_block_rows + 5)
+        {
+            text.append(input_source::read_size * 3, ' ');
+        }
+        text += std::to_string(v) + '\n';
+        binary.append(reinterpret_cast<const char*>(&v), sizeof(v));
+        const double y = func(v);
+        expected.append(reinterpret_cast<const char*>(&y), sizeof(y));
+    }
+    const auto path = std::filesystem::temp_directory_path() / "mathparser_stream_test.bin";
+    const std::string from_text = stream_text("sin(x)*x+1", x, text, false, true);
+    const std::string buffered = stream_text("sin(x)*x+1", x, binary, true, true);
+    const std::string mapped = stream_text("sin(x)*x+1", x, binary, true, true, path);
+    const std::string truncated = stream_text("sin(x)*x+1", x, binary.substr(0, binary.size() - 3), true, true, path);
+    std::filesystem::remove(path);
+    std::cout << "stream test on: blocks" << (from_text == expected && buffered == expected && mapped == expected ? " passed" : " failed") << '\n';
+    std::cout << "stream test on: truncated binary" << (truncated == "input ends in the middle of row " + std::to_string(3 * stream_block_rows + 17) ? " passed" : " failed")
+              << "... " << truncated << '\n';
+}
+
+//checksums against their published check values, then the encoders on an odd sized plot
+void image_tests()
+{
+    const std::string_view check = "123456789";
+    const std::span<const uint8_t> check_bytes(reinterpret_cast<const uint8_t*>(check.data()), check.size());
+    std::cout << "image test on: crc32" << (image::crc32(check_bytes) == 0xCBF43926 ? " passed" : " failed") << '\n';
+    std::cout << "image test on: adler32" << (image::adler32(check_bytes) == 0x091E01DE ? " passed" : " failed") << '\n';
+
+    export_options opts;
+    opts.w = 301;
+    opts.h = 97;
+    const auto func = parser::compile(parser::s_yard("sin(x)", "x"), "x");
+    std::vector<uint32_t> pixels;
+    thread_pool serial(0);
+    const auto png = export_image(func, opts, pixels, serial);
+    const std::vector<uint8_t> iend = { 0, 0, 0, 0, 'I', 'E', 'N', 'D', 0xAE, 0x42, 0x60, 0x82 };
+    const bool png_ok = png.size() > 8 + iend.size() && png[1] == 'P' && std::equal(iend.begin(), iend.end(), png.end() - iend.size());
+    std::cout << "image test on: png " << opts.w << "x" << opts.h << (png_ok ? " passed... " : " failed... ") << png.size() << " bytes\n";
+
+    opts.format = "ppm";
+    const auto ppm = export_image(func, opts, pixels, serial);
+    const std::string header = "P6\n301 97\n255\n";
+    const bool ppm_ok = ppm.size() == header.size() + 301 * 97 * 3 && std::equal(header.begin(), header.end(), ppm.begin());
+    std::cout << "image test on: ppm " << opts.w << "x" << opts.h << (ppm_ok ? " passed" : " failed") << '\n';
+
+    //sin(x) stays on screen, so the curve has to change every inner column of the canvas
+    std::vector<uint32_t> canvas(pixels.size(), black);
+    create_canvas({ canvas.data(), opts.w, opts.h });
+    bool drawn = true;
+    for (int x = 1; x < opts.w - 1; x++)
+    {
+        bool found = false;
+        for (int y = 0; y < opts.h; y++)
+        {
+            found |= pixels[x + y * opts.w] != canvas[x + y * opts.w];
+        }
+        drawn &= found;
+    }
+    std::cout << "image test on: curve drawn" << (drawn ? " passed" : " failed") << '\n';
+}
+
+//frames from async_renderer have to end up the same as composing on the spot, come as a
+//preview first, and a burst of changes has to be drawn once instead of once per change
+void async_tests()
+{
+    //frames are taken on the worker as soon as they are done, so none of them is replaced unseen
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::vector<uint32_t> frame(static_cast<size_t>(screen_w) * screen_h);
+    std::vector<frame_info> infos;
+    async_renderer renderer(screen_w, screen_h, [&]
+    {
+        std::lock_guard lock(mtx);
+        if (const auto info = renderer.take_frame(frame))
+        {
+            infos.push_back(*info);
+        }
+        cv.notify_all();
+    });
+    //frames since the last call until the refined one of generation, false if it doesn't come within a few seconds
+    const auto wait_for = [&](uint64_t generation)
+    {
+        std::unique_lock lock(mtx);
+        const bool res = cv.wait_for(lock, std::chrono::seconds(10), [&]
+        {
+            return !infos.empty() && infos.back().generation == generation && infos.back().refined;
+        });
+        const auto first = std::ranges::find(infos, generation, &frame_info::generation);
+        infos.erase(infos.begin(), first);
+        return res;
+    };
+
+    const std::shared_ptr<const parser::compiled_func> funcs[] = {
+        std::make_shared<parser::compiled_func>(parser::compile(parser::s_yard("sin(x)*x", "x"), "x")),
+        std::make_shared<parser::compiled_func>(parser::compile(parser::s_yard("tan(x)", "x"), "x")) };
+    const auto setup = [&](layered_canvas& layers)
+    {
+        layers.set_viewport(-5, 5);
+        layers.add_curve(funcs[0], yellow);
+        layers.add_curve(funcs[1], red);
+    };
+    const auto expected = [&](int range)
+    {
+        layered_canvas layers(screen_w, screen_h);
+        setup(layers);
+        layers.set_viewport(-range, range);
+        std::vector<uint32_t> res(frame.size());
+        layers.compose({ res.data(), screen_w, screen_h });
+        return res;
+    };
+
+    const uint64_t first = renderer.edit(setup);
+    const bool shown = wait_for(first);
+    const bool previewed = shown && infos.size() == 2 && !infos[0].refined && infos[0].generation == first
+                           && infos[0].evals < infos[1].evals - infos[0].evals;
+    std::cout << "async test on: preview then refined" << (previewed ? " passed" : " failed") << "... "
+              << (infos.empty() ? 0 : infos[0].evals) << " evals, refined " << (infos.empty() ? 0 : infos.back().evals) << '\n';
+    std::cout << "async test on: same as compose" << (shown && frame == expected(5) ? " passed" : " failed") << '\n';
+
+    //the worker is held up by the first change, the zooms that pile up behind it have to be drawn as one frame
+    std::promise<void> entered;
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+    const auto before = renderer.get_stats();
+    renderer.edit([&entered, released](layered_canvas& layers)
+    {
+        entered.set_value();
+        released.wait();
+        layers.set_viewport(-6, 6);
+    });
+    entered.get_future().wait();
+    uint64_t last = 0;
+    for (int range = 7; range < 57; range++)
+    {
+        last = renderer.edit([range](layered_canvas& layers) { layers.set_viewport(-range, range); });
+    }
+    release.set_value();
+    const bool done = wait_for(last);
+    const auto after = renderer.get_stats();
+    const bool coalesced = done && after.frames - before.frames == 2 && after.cancelled - before.cancelled == 1
+                           && infos.size() == 2 && infos[0].generation == last;
+    std::cout << "async test on: 50 zooms coalesced" << (coalesced ? " passed" : " failed") << "... "
+              << after.frames - before.frames << " frames\n";
+    std::cout << "async test on: latest viewport shown" << (done && frame == expected(56) ? " passed" : " failed") << '\n';
+
+    //nothing to plot, so no preview
+    const uint64_t hidden = renderer.edit([](layered_canvas& layers) { layers.set_visible(0, false); });
+    const bool toggled = wait_for(hidden) && infos.size() == 1 && infos[0].evals == 0;
+    std::cout << "async test on: toggle without plotting" << (toggled ? " passed" : " failed") << '\n';
+
+    //work that went stale before it began draws nothing
+    std::atomic<uint64_t> latest = 2;
+    std::vector<uint32_t> data(frame.size(), 0);
+    plot_job job{ funcs[0].get(), { data.data(), screen_w, screen_h } };
+    const size_t evals = plot_jobs(std::span(&job, 1), -5, 5, get_thread_pool(), { &latest, 1 });
+    const bool stale = evals == 0 && std::ranges::all_of(data, [](uint32_t p) { return p == 0; });
+    latest = 1;
+    const bool fresh = plot_jobs(std::span(&job, 1), -5, 5, get_thread_pool(), { &latest, 1 }) > 0;
+    std::cout << "async test on: cancelled plot" << (stale && fresh ? " passed" : " failed") << '\n';
+    renderer.stop();
+}
+
+//the rings have to keep every thread's events apart, drop what was overwritten while
+//reading instead of returning it torn, and the trace and overlay have to show them
+void profiler_tests()
+{
+#ifdef PROFILING_ENABLED
+    const auto events_named = [](const char* name, int64_t since)
+    {
+        std::vector<std::pair<uint32_t, profiler::event>> res;
+        for (const auto& log : profiler::get_registry().get_logs())
+        {
+            for (const auto& e : log->events.snapshot())
+            {
+                if (e.start >= since && std::strcmp(e.name, name) == 0)
+                {
+                    res.emplace_back(log->tid, e);
+                }
+            }
+        }
+        return res;
+    };
+
+    constexpr int num_threads = 4;
+    constexpr size_t scopes_per_thread = 1000;
+    const int64_t t0 = profiler::now_ns();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&]
+        {
+            for (size_t i = 0; i < scopes_per_thread; i++)
+            {
+                size_t count = 0;
+                PROFILE_SCOPE_COUNT("profiler_test", count);
+                count = i + 1;
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    const auto scopes = events_named("profiler_test", t0);
+    std::unordered_map<uint32_t, size_t> per_thread;
+    bool in_order = true;
+    for (size_t i = 0; i < scopes.size(); i++)
+    {
+        const auto& [tid, e] = scopes[i];
+        ++per_thread[tid];
+        in_order &= e.duration >= 0 && (i == 0 || scopes[i - 1].first != tid || scopes[i - 1].second.count + 1 == e.count);
+    }
+    const bool threads_apart = per_thread.size() == num_threads && std::ranges::all_of(per_thread, [](const auto& p) { return p.second == scopes_per_thread; });
+    std::cout << "profiler test on: " << num_threads << " threads" << (threads_apart && in_order ? " passed" : " failed") << '\n';
+
+    profiler::event_ring ring;
+    const size_t extra = 100;
+    for (size_t i = 0; i < profiler::ring_capacity + extra; i++)
+    {
+        ring.push({ "wrap", static_cast<int64_t>(i), 0, i });
+    }
+    const auto kept = ring.snapshot();
+    //the oldest slot could be getting rewritten for all the reader knows, so it is left out
+    const bool wrapped = kept.size() == profiler::ring_capacity - 1 && kept.front().count == extra + 1
+                         && kept.back().count == profiler::ring_capacity + extra - 1 && ring.pushed() == profiler::ring_capacity + extra;
+    std::cout << "profiler test on: ring wrap" << (wrapped ? " passed" : " failed") << '\n';
+
+    //every event is written with the same number in each field, a torn one would mix two events
+    profiler::event_ring shared;
+    std::atomic<bool> done = false;
+    std::thread writer([&]
+    {
+        for (uint64_t i = 0; i < 8 * profiler::ring_capacity; i++)
+        {
+            shared.push({ "race", static_cast<int64_t>(i), static_cast<int64_t>(i), i });
+        }
+        done = true;
+    });
+    size_t snapshots = 0;
+    bool consistent = true;
+    while (!done || snapshots == 0)
+    {
+        const auto seen = shared.snapshot();
+        for (size_t i = 0; i < seen.size(); i++)
+        {
+            const auto& e = seen[i];
+            consistent &= e.start == e.duration && static_cast<uint64_t>(e.start) == e.count
+                          && (i == 0 || seen[i - 1].count + 1 == e.count);
+        }
+        ++snapshots;
+    }
+    writer.join();
+    std::cout << "profiler test on: concurrent reads" << (consistent ? " passed" : " failed") << "... " << snapshots << " snapshots\n";
+
+    //the instrumented phases show up, and the plot events add up to the evaluations
+    const int64_t t1 = profiler::now_ns();
+    const auto func = parser::compile(parser::s_yard("sin(x)*x", "x"), "x");
+    std::vector<uint32_t> data(static_cast<size_t>(screen_w) * screen_h);
+    const pixel_buffer buf{ data.data(), screen_w, screen_h };
+    create_canvas(buf);
+    const size_t evals = plot(buf, -5, 5, func);
+    size_t counted = 0;
+    for (const auto& [tid, e] : events_named("plot", t1))
+    {
+        counted += e.count;
+    }
+    bool phases = counted == evals;
+    for (const char* name : { "tokenize", "s_yard", "compile", "create_canvas", "draw" })
+    {
+        phases &= !events_named(name, t1).empty();
+    }
+    std::cout << "profiler test on: phases" << (phases ? " passed" : " failed") << "... " << evals << " evaluations\n";
+
+    std::ostringstream trace;
+    profiler::write_chrome_trace(trace);
+    const std::string json = trace.str();
+    const bool trace_ok = json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") && json.ends_with("\n]}\n")
+                          && json.find("{\"name\":\"s_yard\",\"ph\":\"X\"") != std::string::npos
+                          && json.find("\"args\":{\"count\":") != std::string::npos
+                          && std::ranges::count(json, '{') == std::ranges::count(json, '}');
+    std::cout << "profiler test on: chrome trace" << (trace_ok ? " passed" : " failed") << "... " << json.size() << " bytes\n";
+
+    std::vector<uint32_t> glyph(5 * 7, 0); //the border stays empty like everywhere else
+    draw_text({ glyph.data(), 5, 7 }, 1, 1, "8", white, 1);
+    profiler::frame_meter meter;
+    meter.add(0.016, 0.004, 40000);
+    std::vector<uint32_t> overlay(static_cast<size_t>(screen_w) * screen_h, 0);
+    draw_profile_overlay({ overlay.data(), screen_w, screen_h }, meter);
+    const bool drawn = std::ranges::count(glyph, white) == 13 && std::ranges::count(overlay, white) > 0
+                       && overlay[0] != 0 && overlay[static_cast<size_t>(screen_w) * screen_h - 1] == 0
+                       && std::abs(meter.get_evals_per_second() - 1e7) < 1.0;
+    std::cout << "profiler test on: overlay" << (drawn ? " passed" : " failed") << '\n';
+#else
+    std::cout << "profiler test on: skipped, PROFILING_ENABLED is off\n";
+#endif
+}
+
+//times the closure tree from build_func against the compiled bytecode
+void benchmarks()
+{
+    constexpr int iterations = 1'000'000;
+
+    //parse throughput, tokenize + s_yard
+    {
+        constexpr int parse_iterations = 20'000;
+        const auto exprs = test_expressions();
+        size_t sink = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < parse_iterations; i++)
+        {
+            sink += parser::s_yard(exprs[i % exprs.size()], "x").size();
+        }
+        const std::chrono::duration<double> parse_time = std::chrono::steady_clock::now() - start;
+        std::cout << "s_yard: " << parse_iterations / parse_time.count() << " parses/s (" << sink << ")\n";
+    }
+
+    //whole text to bytecode compiles, strings and fresh vectors against the arena compiler
+    {
+        constexpr int parse_iterations = 20'000;
+        const auto exprs = test_expressions();
+        size_t sink = 0;
+        parser::compiler comp;
+        parser::compiled_func func;
+        const auto time_compiles = [&](auto&& compile_one)
+        {
+#ifdef ALLOCATION_COUNTING_ENABLED
+            const size_t before = heap_allocations;
+#endif
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < parse_iterations; i++)
+            {
+                sink += compile_one(exprs[i % exprs.size()]);
+            }
+            const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+            std::cout << time.count() / parse_iterations << "ns/parse";
+#ifdef ALLOCATION_COUNTING_ENABLED
+            std::cout << ", " << (heap_allocations - before) / static_cast<double>(parse_iterations) << " allocations/parse";
+#endif
+        };
+        std::cout << "compile from text: ";
+        time_compiles([](const std::string& s) { return parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL).code.size(); });
+        std::cout << ", arena compiler: ";
+        time_compiles([&](const std::string& s) { comp.compile(s, "x", func); return func.code.size(); });
+        std::cout << " (" << sink << ")\n";
+    }
+    for (const auto& s : test_expressions())
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        const auto tree = parser::build_func(rpn, "x");
+        const auto compiled = parser::compile(rpn, "x");
+
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink += tree(i * 1e-6);
+        }
+        const std::chrono::duration<double, std::nano> tree_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink += compiled(i * 1e-6);
+        }
+        const std::chrono::duration<double, std::nano> compiled_time = std::chrono::steady_clock::now() - start;
+
+        std::cout << s << ": build_func " << tree_time.count() / iterations << "ns/eval, compile "
+                  << compiled_time.count() / iterations << "ns/eval, speedup "
+                  << tree_time.count() / compiled_time.count() << "x (" << sink << ")\n";
+    }
+
+    //a formula fixed at build time, static_expr against the runtime paths
+    {
+        static constexpr parser::fixed_string text = "x*x*0.5 + sin(x)*3.5 - x/7 + sqrt(abs(x))";
+        const parser::static_expr<text> fixed;
+        const auto rpn = parser::s_yard(text.view(), "x");
+        const auto tree = parser::build_func(rpn, "x");
+        const auto compiled = parser::compile(rpn, "x", parser::opt_level::FULL);
+        double sink = 0.0;
+        const auto time = [&](const auto& f)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++)
+            {
+                sink += f(i * 1e-6);
+            }
+            const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+            return time.count() / iterations;
+        };
+        std::cout << text.view() << ": static_expr " << time(fixed) << "ns/eval, build_func " << time(tree) << "ns/eval, compile "
+                  << time(compiled) << "ns/eval (" << sink << ")\n";
+    }
+
+    //node counts and batch speed with and without the optimizer
+    std::vector<std::string> opt_exprs = test_expressions();
+    opt_exprs.insert(opt_exprs.end(), { "x^2 / 2 + 3*x*1 - (4 + 0)", "sin(x)/pi + cos(pi/4)*x", "2^(1/2) * x + log(e) - 0" });
+    std::vector<double> opt_xs(iterations);
+    std::vector<double> opt_ys(opt_xs.size());
+    for (int i = 0; i < iterations; i++)
+    {
+        opt_xs[i] = i * 1e-6;
+    }
+    for (const auto& s : opt_exprs)
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        parser::opt_stats stats;
+        const auto plain = parser::compile(rpn, "x");
+        const auto optimized = parser::compile(rpn, "x", parser::opt_level::FULL, &stats);
+
+        auto start = std::chrono::steady_clock::now();
+        plain.evaluate(opt_xs, opt_ys);
+        const std::chrono::duration<double, std::nano> plain_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        optimized.evaluate(opt_xs, opt_ys);
+        const std::chrono::duration<double, std::nano> optimized_time = std::chrono::steady_clock::now() - start;
+
+        std::cout << s << ": nodes " << stats.nodes_before << " -> " << stats.nodes_after << " (" << stats.nodes_unique << " shared), batch "
+                  << plain_time.count() / iterations << "ns/eval -> " << optimized_time.count() / iterations << "ns/eval\n";
+    }
+
+    //interpreter against native code, both single point and batch
+    for (const auto& s : opt_exprs)
+    {
+        const auto compiled = parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL);
+        const auto native = jit::compile(compiled);
+        if (!native)
+        {
+            break;
+        }
+
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink += native->scalar()(opt_xs[i]);
+        }
+        const std::chrono::duration<double, std::nano> scalar_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        compiled.evaluate(opt_xs, opt_ys);
+        const std::chrono::duration<double, std::nano> interp_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        native->batch()(opt_xs.data(), opt_ys.data(), opt_xs.size());
+        const std::chrono::duration<double, std::nano> batch_time = std::chrono::steady_clock::now() - start;
+        sink += opt_ys.back();
+
+        std::cout << s << ": jit scalar " << scalar_time.count() / iterations << "ns/eval, interpreter batch "
+                  << interp_time.count() / iterations << "ns/eval, jit batch " << batch_time.count() / iterations
+                  << "ns/eval, " << iterations / batch_time.count() * 1e3 << "M evals/s (" << sink << ")\n";
+    }
+
+    //value and derivative from one dual number pass against two evaluations for a central difference
+    for (const auto& s : opt_exprs)
+    {
+        const auto rpn = parser::s_yard(s, "x");
+        const auto compiled = parser::compile(rpn, "x", parser::opt_level::FULL);
+        const auto derivative = parser::compile_derivative(rpn, "x");
+        std::vector<double> shifted(opt_xs.size());
+        std::vector<double> derivs(opt_xs.size());
+
+        auto start = std::chrono::steady_clock::now();
+        compiled.evaluate_dual(opt_xs, opt_ys, derivs);
+        const std::chrono::duration<double, std::nano> dual_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        compiled.evaluate(opt_xs, opt_ys);
+        derivative.evaluate(opt_xs, derivs);
+        const std::chrono::duration<double, std::nano> symbolic_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < opt_xs.size(); i++)
+        {
+            shifted[i] = opt_xs[i] + 1e-5;
+        }
+        compiled.evaluate(shifted, derivs);
+        for (size_t i = 0; i < opt_xs.size(); i++)
+        {
+            shifted[i] = opt_xs[i] - 1e-5;
+        }
+        compiled.evaluate(shifted, opt_ys);
+        const std::chrono::duration<double, std::nano> difference_time = std::chrono::steady_clock::now() - start;
+
+        std::cout << s << ": derivative by dual numbers " << dual_time.count() / iterations << "ns/eval, symbolic "
+                  << symbolic_time.count() / iterations << "ns/eval, central difference " << difference_time.count() / iterations << "ns/eval\n";
+    }
+
+    //libm against the approximations of each accuracy, batch kernels over the same inputs
+    {
+        const char* names[] = { "exp", "log", "sin", "cos", "tan", "pow" };
+        std::vector<double> args(iterations);
+        std::vector<double> exponents(iterations, 2.5);
+        for (int k = 0; k < 6; k++)
+        {
+            for (int i = 0; i < iterations; i++)
+            {
+                args[i] = k == 1 || k == 5 ? 0.5 + i * 1e-5 : -5.0 + i * 1e-5;
+            }
+            std::cout << names[k] << ":";
+            for (const auto acc : { simd::accuracy::EXACT, simd::accuracy::FAST, simd::accuracy::COARSE })
+            {
+                const int a = static_cast<int>(acc) - 1;
+                opt_ys = args;
+                const auto start = std::chrono::steady_clock::now();
+                if (k == 5 && acc == simd::accuracy::EXACT)
+                {
+                    for (int i = 0; i < iterations; i++) opt_ys[i] = std::pow(opt_ys[i], exponents[i]);
+                }
+                else if (k == 5)
+                {
+                    simd::kernels().pow[a](opt_ys.data(), exponents.data(), opt_ys.size());
+                }
+                else if (acc == simd::accuracy::EXACT)
+                {
+                    const auto f = parser::get_functions()[parser::find_function(names[k])].func;
+                    for (int i = 0; i < iterations; i++) opt_ys[i] = f(opt_ys[i]);
+                }
+                else
+                {
+                    simd::kernels().approx[a][k](opt_ys.data(), opt_ys.size());
+                }
+                const std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+                std::cout << (acc == simd::accuracy::EXACT ? " libm " : acc == simd::accuracy::FAST ? ", fast " : ", coarse ")
+                          << iterations / time.count() * 1e3 << "M evals/s";
+            }
+            std::cout << " (" << opt_ys.back() << ")\n";
+        }
+    }
+
+    //three variables, one row at a time against columns of a struct of arrays batch
+    {
+        const std::string_view names[] = { "x", "y", "t" };
+        const auto func = parser::compile(parser::s_yard("sin(x)*y + t^2 - x/y", names), names, parser::opt_level::FULL);
+        std::vector<double> ys(iterations, 1.5);
+        std::vector<double> ts(iterations, 0.5);
+        const double* columns[] = { opt_xs.data(), ys.data(), ts.data() };
+
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            const double vars[] = { opt_xs[i], ys[i], ts[i] };
+            sink += func(vars);
+        }
+        const std::chrono::duration<double, std::nano> row_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        func.evaluate(columns, iterations, opt_ys);
+        const std::chrono::duration<double, std::nano> batch_time = std::chrono::steady_clock::now() - start;
+        sink += opt_ys.back();
+
+        std::cout << "sin(x)*y + t^2 - x/y: rows " << row_time.count() / iterations << "ns/eval, columns "
+                  << batch_time.count() / iterations << "ns/eval (" << sink << ")\n";
+    }
+
+    //ten curves, serial against the shared pool
+    {
+        std::vector<parser::compiled_func> funcs;
+        std::vector<const parser::compiled_func*> func_ptrs;
+        const auto exprs = test_expressions();
+        for (size_t i = 0; i < 10; i++)
+        {
+            funcs.push_back(parser::compile(parser::s_yard(exprs[i], "x"), "x", parser::opt_level::FULL));
+        }
+        for (const auto& func : funcs)
+        {
+            func_ptrs.push_back(&func);
+        }
+        std::vector<uint32_t> data(screen_w * screen_h, black);
+        thread_pool serial(0);
+        for (thread_pool* pool : { &serial, &get_thread_pool() })
+        {
+            const auto start = std::chrono::steady_clock::now();
+            plot_all({ data.data(), screen_w, screen_h }, -10, 10, func_ptrs, *pool);
+            const std::chrono::duration<double, std::milli> plot_time = std::chrono::steady_clock::now() - start;
+            std::cout << "plot_all 10 curves, " << pool->size() << " threads: " << plot_time.count() << "ms\n";
+        }
+    }
+
+    //lines per second, fill_gaps against draw_line, for plot sized and long lines
+    for (const int max_len : { 8, 200 })
+    {
+        std::vector<uint32_t> data(screen_w * screen_h, black);
+        const pixel_buffer buf{ data.data(), screen_w, screen_h };
+        const auto lines = random_lines(100'000, screen_w, screen_h, max_len);
+        const auto time = [&](auto&& draw)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (const auto& [a, b] : lines)
+            {
+                draw(a, b);
+            }
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            return lines.size() / elapsed.count();
+        };
+        const double old_rate = time([&](pt_2d a, pt_2d b) { fill_gaps(buf, a, b, std::numeric_limits<int>::max(), 0, screen_h); });
+        const double new_rate = time([&](pt_2d a, pt_2d b) { draw_line(buf, a, b, yellow, 0, screen_h); });
+        const double aa_rate = time([&](pt_2d a, pt_2d b) { draw_line_aa(buf, a.x, a.y, b.x, b.y, yellow, 0, screen_h); });
+        std::cout << "lines up to " << max_len << "px: fill_gaps " << old_rate << " lines/s, draw_line " << new_rate
+                  << " lines/s (" << new_rate / old_rate << "x), draw_line_aa " << aa_rate << " lines/s\n";
+    }
+
+    //redrawing everything for a frame against the cached layers, after a curve
+    //was added (background + curves composed again) and when nothing below the overlay changed
+    {
+        constexpr int frames = 100;
+        layered_canvas layers(screen_w, screen_h);
+        std::vector<uint32_t> frame(screen_w * screen_h);
+        const pixel_buffer out{ frame.data(), screen_w, screen_h };
+        std::vector<parser::compiled_func> funcs;
+        std::vector<const parser::compiled_func*> func_ptrs;
+        const auto exprs = test_expressions();
+        for (size_t i = 0; i < 10; i++)
+        {
+            funcs.push_back(parser::compile(parser::s_yard(exprs[i], "x"), "x", parser::opt_level::FULL));
+        }
+        for (const auto& func : funcs)
+        {
+            func_ptrs.push_back(&func);
+        }
+        layers.set_viewport(-5, 5);
+        for (const auto& func : funcs)
+        {
+            layers.add_curve(std::make_shared<const parser::compiled_func>(func), yellow);
+        }
+
+        const auto time = [&](auto&& draw)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < frames; i++)
+            {
+                draw();
+            }
+            const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / frames;
+        };
+        const double full = time([&]
+        {
+            memset(frame.data(), black, frame.size() * sizeof(uint32_t));
+            create_canvas(out);
+            plot_all(out, -5, 5, func_ptrs);
+        });
+        const double toggled = time([&]
+        {
+            layers.set_visible(0, !layers.curve(0).visible);
+            layers.compose(out);
+        });
+        const double steady = time([&] { layers.compose(out); });
+        std::cout << "frame with 10 curves: full redraw " << full << "us, curve toggled " << toggled << "us, cached "
+                  << steady << "us (background drawn " << layers.get_background_builds() << " time)\n";
+    }
+
+    //zooming with 20 curves on screen, every curve replotted from scratch
+    //against replotting with the samples of the previous viewport
+    {
+        const auto exprs = test_expressions();
+        std::vector<std::shared_ptr<const parser::compiled_func>> funcs;
+        for (size_t i = 0; i < 20; i++)
+        {
+            funcs.push_back(std::make_shared<const parser::compiled_func>(
+                parser::compile(parser::s_yard(exprs[i % exprs.size()] + "+" + std::to_string(i / exprs.size()), "x"), "x", parser::opt_level::FULL)));
+        }
+        std::vector<uint32_t> frame(screen_w * screen_h);
+        const pixel_buffer out{ frame.data(), screen_w, screen_h };
+        for (const bool reuse : { false, true })
+        {
+            layered_canvas layers(screen_w, screen_h);
+            layers.set_viewport(-5, 5);
+            for (const auto& func : funcs)
+            {
+                layers.add_curve(func, yellow);
+            }
+            layers.compose(out);
+            size_t evals = 0;
+            const auto start = std::chrono::steady_clock::now();
+            for (int range = 6; range <= 15; range++)
+            {
+                layers.set_viewport(-range, range);
+                if (!reuse)
+                {
+                    layers.clear_curves();
+                    for (const auto& func : funcs)
+                    {
+                        layers.add_curve(func, yellow);
+                    }
+                }
+                evals += layers.update();
+                layers.compose(out);
+            }
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "zoom with 20 curves, " << (reuse ? "reusing samples: " : "from scratch: ") << elapsed.count() / 10
+                      << "ms and " << evals / 10 << " evaluations per step";
+            if (reuse)
+            {
+                const auto stats = layers.get_sample_stats();
+                std::cout << ", hit ratio " << static_cast<double>(stats.hits) / (stats.hits + stats.misses)
+                          << ", " << stats.bytes / 1024 << "kb stored";
+            }
+            std::cout << '\n';
+        }
+    }
+
+    //the same zooms through async_renderer, how long until the preview and the refined frame
+    //show up, then all ten zooms queued at once as a held arrow key does
+    {
+        const auto exprs = test_expressions();
+        std::mutex mtx;
+        std::condition_variable cv;
+        size_t signals = 0;
+        async_renderer renderer(screen_w, screen_h, [&]
+        {
+            std::lock_guard lock(mtx);
+            ++signals;
+            cv.notify_all();
+        });
+        std::vector<uint32_t> frame(screen_w * screen_h);
+        //milliseconds until the preview and until the refined frame of generation
+        const auto wait_for = [&](uint64_t generation, std::chrono::steady_clock::time_point start)
+        {
+            std::pair<double, double> res{ 0.0, 0.0 };
+            for (;;)
+            {
+                std::unique_lock lock(mtx);
+                const size_t seen = signals; //taken before looking, so no frame slips by
+                lock.unlock();
+                while (const auto info = renderer.take_frame(frame))
+                {
+                    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                    if (info->generation != generation)
+                    {
+                        continue;
+                    }
+                    (info->refined ? res.second : res.first) = ms;
+                    if (info->refined)
+                    {
+                        return res;
+                    }
+                }
+                lock.lock();
+                cv.wait(lock, [&] { return signals != seen; });
+            }
+        };
+        uint64_t generation = renderer.edit([&](layered_canvas& layers)
+        {
+            layers.set_viewport(-5, 5);
+            for (size_t i = 0; i < 20; i++)
+            {
+                layers.add_curve(std::make_shared<const parser::compiled_func>(parser::compile(
+                    parser::s_yard(exprs[i % exprs.size()] + "+" + std::to_string(i / exprs.size()), "x"), "x", parser::opt_level::FULL)), yellow);
+            }
+        });
+        wait_for(generation, std::chrono::steady_clock::now());
+        double preview = 0.0;
+        double refined = 0.0;
+        for (int range = 6; range <= 15; range++)
+        {
+            generation = renderer.edit([range](layered_canvas& layers) { layers.set_viewport(-range, range); });
+            const auto [p, r] = wait_for(generation, std::chrono::steady_clock::now());
+            preview += p;
+            refined += r;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        for (int range = 16; range <= 25; range++)
+        {
+            generation = renderer.edit([range](layered_canvas& layers) { layers.set_viewport(-range, range); });
+        }
+        const double burst = wait_for(generation, start).second;
+        const auto stats = renderer.get_stats();
+        std::cout << "async zoom with 20 curves: preview after " << preview / 10 << "ms, refined after " << refined / 10
+                  << "ms, 10 queued zooms done after " << burst << "ms (" << stats.cancelled << " generations cancelled)\n";
+    }
+
+    //fields over the whole window, frames per second serial against the shared pool
+    {
+        const std::string_view names[] = { "x", "y" };
+        std::vector<uint32_t> frame(screen_w * screen_h);
+        thread_pool serial(0);
+        for (const auto& [s, mode] : { std::pair{ "sin(x)*cos(y)", field_mode::HEATMAP }, std::pair{ "sin(x*y) - y/4", field_mode::HEATMAP },
+                                       std::pair{ "x^2 + y^2 - 16", field_mode::IMPLICIT }, std::pair{ "sin(x*y) - y/4", field_mode::IMPLICIT } })
+        {
+            const auto func = parser::compile(parser::s_yard(s, names), names, parser::opt_level::FULL);
+            std::cout << s << (mode == field_mode::HEATMAP ? " heatmap:" : " implicit:");
+            for (thread_pool* pool : { &serial, &get_thread_pool() })
+            {
+                constexpr int frames = 10;
+                size_t evals = 0;
+                const auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < frames; i++)
+                {
+                    create_canvas({ frame.data(), screen_w, screen_h });
+                    evals += plot_field({ frame.data(), screen_w, screen_h }, 5, func, mode, yellow, *pool);
+                }
+                const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                std::cout << ' ' << pool->size() << " threads " << frames / elapsed.count() << " fps ("
+                          << evals / elapsed.count() / 1e6 << "M evals/s)";
+            }
+            std::cout << '\n';
+        }
+    }
+
+    //headless export, whole png images per second at two sizes
+    for (const auto& [w, h] : { std::pair{ screen_w, screen_h }, std::pair{ 1920, 1080 } })
+    {
+        export_options opts;
+        opts.w = w;
+        opts.h = h;
+        const auto exprs = test_expressions();
+        std::vector<parser::compiled_func> funcs;
+        for (const auto& s : exprs)
+        {
+            funcs.push_back(parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL));
+        }
+        std::vector<uint32_t> pixels;
+        thread_pool serial(0);
+        size_t bytes = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& func : funcs)
+        {
+            bytes += export_image(func, opts, pixels, serial).size();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "png export " << w << "x" << h << ": " << funcs.size() / elapsed.count() << " images/s on one thread, "
+                  << bytes / funcs.size() << " bytes/image\n";
+    }
+
+    //streamed evaluation of a mapped file in text and binary, results written to a temporary file
+    {
+        constexpr size_t rows = 4'000'000;
+        const auto func = parser::compile(parser::s_yard("sin(x)*x+1", "x"), "x", parser::opt_level::FULL);
+        const auto path = std::filesystem::temp_directory_path() / "mathparser_stream_bench";
+        for (const bool binary : { false, true })
+        {
+            {
+                std::ofstream file(path, std::ios::binary);
+                std::string text;
+                for (size_t i = 0; i < rows; i++)
+                {
+                    const double v = i * 0.001;
+                    if (binary)
+                    {
+                        file.write(reinterpret_cast<const char*>(&v), sizeof(v));
+                    }
+                    else
+                    {
+                        text = std::to_string(v) + '\n';
+                        file.write(text.data(), text.size());
+                    }
+                }
+            }
+            std::FILE* out = std::tmpfile();
+            input_source in(path);
+            const auto start = std::chrono::steady_clock::now();
+            const size_t n = evaluate_stream(func, in, out, binary, binary);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::fclose(out);
+            std::cout << "stream " << (binary ? "binary" : "text") << ": " << n / elapsed.count() / 1e6 << "M rows/s, "
+                      << std::filesystem::file_size(path) / elapsed.count() / (1 << 20) << "MB/s in\n";
+        }
+        std::filesystem::remove(path);
+    }
+
+    //evaluations of adaptive sampling against the old uniform 1000 and 5000 samples per unit
+    for (const std::string s : { "sin(x)", "x^2/4", "tan(x)", "1/x", "sqrt(x)*2", "x^3/10 - x", "exp(x)/10", "sin(1/x)" })
+    {
+        const auto func = parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL);
+        std::vector<uint32_t> data(screen_w * screen_h, black);
+        const size_t evals = plot({ data.data(), screen_w, screen_h }, -5, 5, func);
+        const double coverage = plot_coverage(data, plot_reference(func, -5, 5, 100'000));
+        std::cout << s << ": adaptive " << evals << " evals, uniform " << 10 * 1000 << "/" << 10 * 5000 << " evals, "
+                  << 10 * 1000.0 / evals << "x/" << 10 * 5000.0 / evals << "x fewer, reference coverage " << coverage << '\n';
+    }
+
+    //zoomed in to -1..1, where most of these curves are off screen and culled by their interval bounds
+    for (const std::string s : { "x^2*50", "exp(x*10)", "tan(x*20)", "sin(x*40)*10", "1/x", "sqrt(0-x)*3", "tgamma(x*10)" })
+    {
+        const auto func = parser::compile(parser::s_yard(s, "x"), "x", parser::opt_level::FULL);
+        const parser::compiled_func* funcs[] = { &func };
+        std::vector<uint32_t> data(screen_w * screen_h, black);
+        thread_pool serial(0);
+        constexpr int frames = 100;
+        size_t evals = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < frames; i++)
+        {
+            evals += plot_all({ data.data(), screen_w, screen_h }, -1, 1, funcs, serial);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double coverage = plot_coverage(data, plot_reference(func, -1, 1, 1'000'000));
+        std::cout << s << " at -1..1: " << evals / frames << " evals for " << screen_w / coarse_step_px + 1 << " coarse samples, "
+                  << elapsed.count() / frames * 1e6 << "us/frame, reference coverage " << coverage << '\n';
+    }
+
+    //single point calls against one evaluate() over the same inputs
+    std::vector<double> xs(iterations);
+    for (int i = 0; i < iterations; i++)
+    {
+        xs[i] = i * 1e-6;
+    }
+    std::vector<double> ys(xs.size());
+    for (const auto& s : test_expressions())
+    {
+        const auto compiled = parser::compile(parser::s_yard(s, "x"), "x");
+
+        double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+        {
+            sink += compiled(xs[i]);
+        }
+        const std::chrono::duration<double, std::nano> single_time = std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        compiled.evaluate(xs, ys);
+        const std::chrono::duration<double, std::nano> batch_time = std::chrono::steady_clock::now() - start;
+        sink += ys.back();
+
+        std::cout << s << ": single " << single_time.count() / iterations << "ns/eval, batch ("
+                  << simd::kernels().name << ") " << batch_time.count() / iterations << "ns/eval, speedup "
+                  << single_time.count() / batch_time.count() << "x (" << sink << ")\n";
+    }
+}
+
+//settings of the benchmark suite, filled from the command line
+struct bench_options
+{
+    std::filesystem::path corpus;
+    std::filesystem::path json; //empty writes no json
+    double min_time = 0.5; //seconds every stage runs at least, 0 runs it once
+};
+
+//one stage over one category of the corpus
+struct bench_result
+{
+    std::string name; //stage/category
+    size_t iterations;
+    double real_ns; //per operation
+    double cpu_ns;
+    double items_per_second;
+};
 
-//creates the grid and axis
-//uses global constants to deduce array size
-void create_canvas(uint32_t *data)
+//reads the lines "<category> <expression>" of a corpus, # starts a comment
+//throws std::runtime_error for a line without expression or that doesn't parse
+std::vector<std::pair<std::string, std::vector<std::string>>> read_corpus(const std::filesystem::path& path)
 {
-    //create grid  
-    for (int x = grid_spacing; x < screen_w; x += grid_spacing)
+    std::ifstream file(path);
+    if (!file)
     {
-        for (int y = 0; y < screen_h; y++)
-        {
-            data[x + (y * screen_w)] = green;
-        }
+        throw std::runtime_error("can't open " + path.string());
     }
-   
-    for (int x = 0; x < screen_w; x++)
+    std::vector<std::pair<std::string, std::vector<std::string>>> categories;
+    size_t line_no = 0;
+    for (std::string line; std::getline(file, line);)
     {
-        for (int y = grid_spacing; y < screen_h; y += grid_spacing)
+        ++line_no;
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+        if (line.find_first_not_of(" \t") == std::string::npos || line[line.find_first_not_of(" \t")] == '#')
+        {
+            continue;
+        }
+        std::istringstream fields(line);
+        std::string category;
+        std::string expr;
+        fields >> category >> std::ws;
+        std::getline(fields, expr);
+        if (expr.empty())
+        {
+            throw std::runtime_error("line " + std::to_string(line_no) + ": no expression");
+        }
+        try
         {
-            data[x + (y * screen_w)] = green;
+            parser::compile(parser::s_yard(expr, "x"), "x");
         }
+        catch (const parser::parse_error& exc)
+        {
+            throw std::runtime_error("line " + std::to_string(line_no) + ": " + exc.what());
+        }
+        const auto it = std::ranges::find(categories, category, &decltype(categories)::value_type::first);
+        (it != categories.end() ? it->second : categories.emplace_back(category, std::vector<std::string>{}).second).push_back(expr);
     }
+    return categories;
+}
 
-    //draw y axis
-    for (int y = 0; y < screen_h; y++)
+//calls op until min_time has passed, doubling the calls between checks like google benchmark does
+//ops is the number of operations one call does, the times are per operation
+template<typename F>
+bench_result measure(std::string name, size_t ops, double min_time, F&& op)
+{
+    op(); //warm up caches and lazily built tables
+    size_t iterations = 1;
+    for (;;)
     {
-        data[screen_w/2 + (y * screen_w)] = red;
+        const std::clock_t cpu_start = std::clock();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            op();
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        const double cpu = static_cast<double>(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+        if (elapsed.count() >= min_time || iterations >= (size_t{ 1 } << 40))
+        {
+            const double total_ops = static_cast<double>(iterations) * ops;
+            return { std::move(name), iterations, elapsed.count() * 1e9 / total_ops, cpu * 1e9 / total_ops, total_ops / elapsed.count() };
+        }
+        //aim a bit past min_time from what this round took
+        const double factor = elapsed.count() > 0.0 ? std::clamp(min_time * 1.4 / elapsed.count(), 2.0, 10.0) : 10.0;
+        iterations = static_cast<size_t>(iterations * factor);
     }
-    //draw x axis
-    for (int x = 0; x < screen_h; x++)
-    {
-        data[x + (screen_h/2 * screen_w)] = red;
-    }   
 }
 
-//fills the gap between two points with a line
-void fill_gaps(uint32_t* data, pt_2d a, pt_2d b, int max)
+//json in the layout of google benchmark, so its compare.py works on two runs
+void write_bench_json(std::ostream& out, const bench_options& opts, std::span<const bench_result> results)
 {
-    const double dist = dist_2d(a, b);
-    if (dist > 2 && dist < max)
+    const auto quote = [](std::string_view str)
     {
-        std::vector<double> xvec = linspace(a.x, b.x, std::round(dist) + 1);
-        std::vector<double> yvec = linspace(a.y, b.y, std::round(dist) + 1);
-        for (int i = 0; i < xvec.size(); i++)
+        std::string res = "\"";
+        for (const char c : str)
         {
-            int ix = std::round(xvec[i]);
-            int iy = std::round(yvec[i]);
-            if (ix < screen_w - 1 && iy < screen_h - 1 && ix > 0 && iy > 0)
-            {
-                data[ix + (iy * screen_w)] = yellow;
-            }
+            if (c == '"' || c == '\\') res += '\\';
+            res += c;
         }
+        return res + '"';
+    };
+    char date[32] = {};
+    const std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+    out << "{\n  \"context\": {\n"
+        << "    \"date\": " << quote(date) << ",\n"
+        << "    \"corpus\": " << quote(opts.corpus.generic_string()) << ",\n"
+        << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"simd\": " << quote(simd::kernels().name) << ",\n"
+#ifdef JIT_ENABLED
+        << "    \"jit\": true,\n"
+#else
+        << "    \"jit\": false,\n"
+#endif
+#ifdef NDEBUG
+        << "    \"library_build_type\": \"release\"\n"
+#else
+        << "    \"library_build_type\": \"debug\"\n"
+#endif
+        << "  },\n  \"benchmarks\": [\n";
+    out.precision(17);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const auto& r = results[i];
+        out << "    {\n"
+            << "      \"name\": " << quote(r.name) << ",\n"
+            << "      \"run_name\": " << quote(r.name) << ",\n"
+            << "      \"run_type\": \"iteration\",\n"
+            << "      \"iterations\": " << r.iterations << ",\n"
+            << "      \"real_time\": " << r.real_ns << ",\n"
+            << "      \"cpu_time\": " << r.cpu_ns << ",\n"
+            << "      \"time_unit\": \"ns\",\n"
+            << "      \"items_per_second\": " << r.items_per_second << "\n"
+            << "    }" << (i + 1 < results.size() ? "," : "") << '\n';
     }
+    out << "  ]\n}\n";
 }
 
-//plot the function across the range lower to upper
-void plot(uint32_t* data, int range_lower, int range_upper, std::function<double(double)> func, std::string_view var_name, int pt_step_count, int max)
+//times every stage from text to pixels over each category of the corpus, on one thread so runs compare
+//prints a table and writes json if opts.json is set, returns the exit code
+int run_bench(const bench_options& opts)
 {
-    const int ratio = screen_w / range_upper;
-    int lst_ix = 0;
-    int lst_iy = 0;
-    
-    for (int x = (range_lower * pt_step_count); x < (range_upper * pt_step_count); x++)
+    std::vector<std::pair<std::string, std::vector<std::string>>> corpus;
+    try
+    {
+        corpus = read_corpus(opts.corpus);
+    }
+    catch (const std::runtime_error& exc)
+    {
+        std::cerr << opts.corpus.string() << ": " << exc.what() << '\n';
+        return 1;
+    }
+
+    constexpr size_t points = 1024;
+    std::vector<double> xs(points);
+    std::vector<double> ys(points);
+    for (size_t i = 0; i < points; i++)
     {
-        double tx = x / static_cast<double>(pt_step_count);       
-        double ty = func(tx);
+        xs[i] = -5.0 + 10.0 * i / points;
+    }
+    std::vector<uint32_t> pixels(screen_w * screen_h, black);
+    const pixel_buffer buf{ pixels.data(), screen_w, screen_h };
+    thread_pool serial(0);
+    volatile double sink = 0.0;
+    parser::compiler comp;
+    parser::compiled_func compiled;
+    //node counts as a tree and once common subexpressions are shared, of the expressions and their derivatives
+    std::vector<std::pair<std::string, std::array<int, 4>>> shared_nodes;
 
-        tx *= (screen_w / static_cast<double>(range_upper));
-        ty *= (screen_w / static_cast<double>(range_upper));
+    std::vector<bench_result> results;
+    for (const auto& [category, exprs] : corpus)
+    {
+        std::array<int, 4> nodes{};
+        std::vector<std::vector<std::variant<double, std::string>>> rpns;
+        std::vector<std::function<double(double)>> built;
+        std::vector<parser::compiled_func> funcs;
+        std::vector<const parser::compiled_func*> func_ptrs;
+        for (const auto& expr : exprs)
+        {
+            rpns.push_back(parser::s_yard(expr, "x"));
+            built.push_back(parser::build_func(rpns.back(), "x"));
+            parser::opt_stats stats;
+            funcs.push_back(parser::compile(rpns.back(), "x", parser::opt_level::FULL, &stats));
+            const std::string_view var = "x";
+            const auto tree = parser::optimize(parser::build_tree(rpns.back(), std::span(&var, 1)), parser::opt_level::FULL);
+            parser::opt_stats deriv_stats;
+            parser::optimize(parser::differentiate(tree), parser::opt_level::FULL, &deriv_stats);
+            nodes[0] += stats.nodes_after;
+            nodes[1] += stats.nodes_unique;
+            nodes[2] += deriv_stats.nodes_after;
+            nodes[3] += deriv_stats.nodes_unique;
+#ifdef JIT_ENABLED
+            funcs.back().native = jit::compile(funcs.back());
+#endif
+        }
+        for (const auto& func : funcs)
+        {
+            func_ptrs.push_back(&func);
+        }
+        //what the plots evaluate
+        std::vector<parser::compiled_func> fast_funcs = funcs;
+        for (auto& func : fast_funcs)
+        {
+            parser::approximate(func, simd::accuracy::FAST);
+#ifdef JIT_ENABLED
+            func.native = jit::compile(func);
+#endif
+        }
+        const size_t n = exprs.size();
+        const auto stage = [&](std::string_view name, size_t ops, auto&& op)
+        {
+            results.push_back(measure(std::string(name) + '/' + category, ops, opts.min_time, op));
+        };
 
-        int ix = -std::round(tx / 2.0);
-        int iy = std::round(ty / 2.0);
+        shared_nodes.emplace_back(category, nodes);
+        stage("tokenize", n, [&] { for (const auto& expr : exprs) sink = sink + parser::tokenize(expr).size(); });
+        stage("s_yard", n, [&] { for (const auto& expr : exprs) sink = sink + parser::s_yard(expr, "x").size(); });
+        stage("build_func", n, [&] { for (const auto& rpn : rpns) sink = sink + (parser::build_func(rpn, "x") ? 1 : 0); });
+        stage("compile", n, [&] { for (const auto& rpn : rpns) sink = sink + parser::compile(rpn, "x", parser::opt_level::FULL).code.size(); });
+        stage("compile_arena", n, [&]
+        {
+            for (const auto& expr : exprs)
+            {
+                comp.compile(expr, "x", compiled);
+                sink = sink + compiled.code.size();
+            }
+        });
+        stage("eval_build_func", n * points, [&] { for (const auto& f : built) for (const double x : xs) sink = sink + f(x); });
+        stage("eval_single", n * points, [&] { for (const auto& f : funcs) for (const double x : xs) sink = sink + f(x); });
+        stage("eval_batch", n * points, [&] { for (const auto& f : funcs) { f.evaluate(xs, ys); sink = sink + ys[0]; } });
+        stage("eval_batch_fast", n * points, [&] { for (const auto& f : fast_funcs) { f.evaluate(xs, ys); sink = sink + ys[0]; } });
+        stage("plot", n, [&]
+        {
+            for (const auto* f : func_ptrs) sink = sink + plot_all(buf, -5, 5, std::span(&f, 1), serial);
+        });
+        stage("render_frame", 1, [&]
+        {
+            create_canvas(buf);
+            sink = sink + plot_all(buf, -5, 5, func_ptrs, serial);
+        });
+    }
 
-        ix += screen_w / 2;
-        iy += screen_h / 2;
+    //line drawing doesn't depend on the corpus, the lines are the same random plot sized ones every run
+    const auto lines = random_lines(10'000, screen_w, screen_h, 8);
+    results.push_back(measure("fill_gaps/lines", lines.size(), opts.min_time, [&]
+    {
+        for (const auto& [a, b] : lines) fill_gaps(buf, a, b, std::numeric_limits<int>::max(), 0, screen_h);
+    }));
+    results.push_back(measure("draw_line/lines", lines.size(), opts.min_time, [&]
+    {
+        for (const auto& [a, b] : lines) draw_line(buf, a, b, yellow, 0, screen_h);
+    }));
 
-        if (ix < screen_w - 1 && iy < screen_h - 1 && ix > 0 && iy > 0)
+    for (const auto& r : results)
+    {
+        std::printf("%-28s %12zu iterations %14.2f ns/op %14.4gM items/s\n", r.name.c_str(), r.iterations, r.real_ns, r.items_per_second / 1e6);
+    }
+    for (const auto& [category, nodes] : shared_nodes)
+    {
+        std::printf("cse/%-24s %6d -> %6d nodes, derivatives %6d -> %6d nodes\n", category.c_str(), nodes[0], nodes[1], nodes[2], nodes[3]);
+    }
+    if (!opts.json.empty())
+    {
+        std::ofstream file(opts.json);
+        write_bench_json(file, opts, results);
+        if (!file)
         {
-            data[ix + (iy * screen_w)] = yellow;
+            std::cerr << "can't write " << opts.json.string() << '\n';
+            return 1;
         }
-        
-        fill_gaps(data, { lst_ix, lst_iy }, { ix, iy }, max);
-        lst_ix = ix;
-        lst_iy = iy;
     }
+    return 0;
 }
 
-/* 
-  Renders Pixel Buffer
-  params:
-  sdl window
-  sdl renderer
-  sdl texture
-  uint32 1d pixel buffer
-*/
-void render(SDL_Window* pWindow, SDL_Renderer* pRenderer, SDL_Texture* pTexture, uint32_t* data)
+//runs every *_tests() function with its output passed through
+//returns the exit code, non zero if any check failed, a test that throws counts as one failed check
+int run_tests()
 {
-    int32_t pitch = 0;
-    uint32_t* pPixelBuffer = nullptr;
-    if (!SDL_LockTexture(pTexture, nullptr, (void**)(&pPixelBuffer), &pitch))
+    constexpr std::pair<const char*, void(*)()> suites[] = {
+        { "tests", tests }, { "batch_tests", batch_tests }, { "var_tests", var_tests }, { "deriv_tests", deriv_tests },
+        { "approx_tests", approx_tests }, { "interval_tests", interval_tests }, { "jit_tests", jit_tests },
+        { "static_tests", static_tests }, { "cache_tests", cache_tests }, { "alloc_tests", alloc_tests },
+        { "plot_tests", plot_tests }, { "sample_store_tests", sample_store_tests }, { "field_tests", field_tests },
+        { "stream_tests", stream_tests }, { "image_tests", image_tests }, { "raster_tests", raster_tests },
+        { "layer_tests", layer_tests }, { "async_tests", async_tests }, { "profiler_tests", profiler_tests } };
+    int failed = 0;
+    for (const auto& [name, suite] : suites)
     {
-        pitch /= sizeof(uint32_t);
-        memcpy(pPixelBuffer, data, screen_h * static_cast<size_t>(pitch) * sizeof(uint32_t));
-        SDL_UnlockTexture(pTexture);
-        SDL_RenderCopy(pRenderer, pTexture, nullptr, nullptr);
-        SDL_RenderPresent(pRenderer);
+        std::ostringstream log;
+        std::streambuf* const out = std::cout.rdbuf(log.rdbuf());
+        try
+        {
+            suite();
+        }
+        catch (const std::exception& exc)
+        {
+            log << name << " failed... " << exc.what() << '\n';
+        }
+        std::cout.rdbuf(out);
+        std::istringstream lines(log.str());
+        for (std::string line; std::getline(lines, line);)
+        {
+            failed += line.find(" failed") != std::string::npos;
+        }
+        std::cout << log.str();
     }
+    std::cout << (failed ? std::to_string(failed) + " checks failed\n" : "all tests passed\n");
+    return failed ? 1 : 0;
 }
 
-bool equality(double a, double b)
+void print_usage()
 {
-    return (std::abs(a - b) < std::numeric_limits<double>::epsilon());
+    std::cout << "usage: MathParser --batch <file> [--out <dir>] [--size <w>x<h>] [--range <n>] [--var <name>] [--format png|ppm]\n"
+              << "renders every line of the file to <dir>/<line number>.png, x from -n to n\n"
+              << "       MathParser --eval <expr> [--in <file>] [--out <file>] [--var <names>] [--in-format text|binary] [--out-format text|binary]\n"
+              << "evaluates expr on every row of the file or stdin and writes the results to the file or stdout\n"
+              << "rows hold one number per variable, names are comma separated, binary rows are native doubles\n"
+              << "       MathParser --bench <corpus> [--json <file>] [--min-time <seconds>]\n"
+              << "times every stage over each category of the corpus, see bench/corpus.txt\n"
+              << "       MathParser --test\n"
+              << "runs every test, the exit code is non zero if any check failed\n"
+#ifdef PROFILING_ENABLED
+              << "every mode also takes --trace <file>, the timed phases are written to it as a chrome trace\n"
+#endif
+#ifndef HEADLESS_ONLY
+              << "without arguments the interactive window is opened\n"
+#endif
+              ;
 }
 
-void tests()
+//command line mode, returns the exit code
+int run_cli(std::span<char*> args)
 {
-    const std::string a = "x+2+5 + 6 + 10";
-    const std::string b = "cos( sin(tan(x)) )";
-    const std::string c = "x+ 10 *(5 +2)";
-    const std::string d = "-x + 1 - (3 + 2)";
-
-    double real = 1.0 + 2.0 + 5.0 + 6.0 + 10.0;
-    auto rpn = parser::s_yard(a, "x");
-    auto func = parser::build_func(rpn, "x");
-    if (!equality(real, func(1.0))) 
-        std::cout << "test on: " << a << " failed... " << real << " " << func(1.0) << '\n'; 
-    else
-        std::cout << "test on: " << a << " passed... " << real << " " << func(1.0) << '\n';
-
-    real = std::cos(std::sin(std::tan(1.0)));
-    rpn = parser::s_yard(b, "x");
-    func = parser::build_func(rpn, "x");
-    if (!equality(real, func(1.0))) 
-        std::cout << "test on: " << b << " failed... " << real << " " << func(1.0) << '\n'; 
-    else 
-        std::cout << "test on: " << b << " passed... " << real << " " << func(1.0) << '\n';
-
-    real = 1.0 + 10.0 * (5.0 + 2.0);
-    rpn = parser::s_yard(c, "x");
-    func = parser::build_func(rpn, "x");
-    if (!equality(real, func(1.0))) 
-        std::cout << "test on: " << c << " failed... " << real << " " << func(1.0) << '\n'; 
-    else  
-        std::cout << "test on: " << c << " passed... " << real << " " << func(1.0) << '\n'; 
-
-    real = -1.0 + 1.0 - (3.0 + 2.0);
-    rpn = parser::s_yard(d, "x");
-    func = parser::build_func(rpn, "x"); 
-    if (!equality(real, func(1.0)))
-        std::cout << "test on: " << d << " failed... " << real << " " << func(1.0) << '\n'; 
-    else  
-        std::cout << "test on: " << d << " passed... " << real << " " << func(1.0) << '\n'; 
-
-    //testing all funcs from the table, mostly uneeded
-    for (const auto& [k, v] : parser::unary_func_tbl)
+    export_options opts;
+    stream_options stream;
+    bench_options bench;
+    std::filesystem::path list;
+#ifdef PROFILING_ENABLED
+    std::filesystem::path trace;
+#endif
+    const auto parse_int = [](std::string_view str, int& out)
     {
-        double test_val = 1.0;
-        //make sure the function is well defined at the input value
-        if (k == "atanh")
+        const auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), out);
+        return ec == std::errc() && ptr == str.data() + str.size() && out > 0;
+    };
+    bool test = false;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        const std::string_view arg = args[i];
+        if (arg == "--test")
         {
-            test_val = -0.5;
+            test = true;
+            continue;
         }
-      
-        const std::string s = static_cast<std::string>(k) + "(x)";
-        real = v(test_val);
-        rpn = parser::s_yard(s, "x");
-        func = parser::build_func(rpn, "x");
-        if (!equality(real, func(test_val)))
-            std::cout << "test on: " << s << " failed... " << real << " " << func(test_val) << '\n';
-        else 
-            std::cout << "test on " << s << " passed... " << real << " " << func(test_val) << '\n'; 
-    }
-
-    for (const auto& [k, v] : parser::unary_func_tbl)
-    {
-        double test_val = 1.0;
-        
-        if (k == "atanh")
+        if (i + 1 == args.size())
         {
-            test_val = -0.5;
+            print_usage();
+            return 1;
         }
-        else if (k == "acosh")
+        const std::string_view value = args[++i];
+        bool ok = true;
+        if (arg == "--batch")
         {
-            test_val = 2.0;
+            list = value;
+        }
+        else if (arg == "--eval")
+        {
+            stream.expr = value;
+        }
+        else if (arg == "--bench")
+        {
+            bench.corpus = value;
+        }
+        else if (arg == "--json")
+        {
+            bench.json = value;
+        }
+        else if (arg == "--min-time")
+        {
+            const auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), bench.min_time);
+            ok = ec == std::errc() && ptr == value.data() + value.size() && bench.min_time >= 0.0;
+        }
+        else if (arg == "--in")
+        {
+            stream.input = value;
+        }
+        else if (arg == "--out")
+        {
+            opts.out_dir = value;
+            stream.output = value;
+        }
+        else if (arg == "--in-format" || arg == "--out-format")
+        {
+            (arg == "--in-format" ? stream.binary_in : stream.binary_out) = value == "binary";
+            ok = value == "text" || value == "binary";
+        }
+        else if (arg == "--size")
+        {
+            const size_t x = value.find('x');
+            ok = x != std::string_view::npos && parse_int(value.substr(0, x), opts.w) && parse_int(value.substr(x + 1), opts.h)
+                 && opts.w <= 16384 && opts.h <= 16384;
+        }
+        else if (arg == "--range")
+        {
+            ok = parse_int(value, opts.range);
+        }
+        else if (arg == "--var")
+        {
+            opts.var_name = value;
+            stream.var_names.clear();
+            for (const auto name : std::views::split(value, ','))
+            {
+                stream.var_names.emplace_back(name.begin(), name.end());
+            }
+        }
+        else if (arg == "--format")
+        {
+            opts.format = value;
+            ok = value == "png" || value == "ppm";
+        }
+#ifdef PROFILING_ENABLED
+        else if (arg == "--trace")
+        {
+            trace = value;
+        }
+#endif
+        else
+        {
+            ok = false;
+        }
+        if (!ok)
+        {
+            std::cerr << "bad argument: " << arg << ' ' << value << '\n';
+            print_usage();
+            return 1;
+        }
+    }
+    const int modes = test + !list.empty() + !stream.expr.empty() + !bench.corpus.empty();
+    if (modes != 1)
+    {
+        print_usage();
+        return 1;
+    }
+    const int res = test ? run_tests() : !stream.expr.empty() ? run_stream(stream) : !bench.corpus.empty() ? run_bench(bench) : run_batch(list, opts);
+#ifdef PROFILING_ENABLED
+    if (!trace.empty())
+    {
+        std::ofstream out(trace);
+        profiler::write_chrome_trace(out);
+        if (!out)
+        {
+            std::cerr << "couldn't write " << trace << '\n';
+            return res ? res : 1;
         }
-        const std::string s = static_cast<std::string>(k) + "(x-0.001*(2 - 1))";
-        real = v(test_val - 0.001 * (2 - 1));
-        rpn = parser::s_yard(s, "x");
-        func = parser::build_func(rpn, "x");
-        if (!equality(real, func(test_val)))
-            std::cout << "test on: " << s << " failed... " << real << " " << func(test_val) << '\n';
-        else 
-            std::cout << "test on " << s << " passed... " << real << " " << func(test_val) << '\n'; 
     }
+#endif
+    return res;
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    //tests();
+    //benchmarks();
+    if (argc > 1)
+    {
+        return run_cli(std::span(argv + 1, argc - 1));
+    }
+#ifdef HEADLESS_ONLY
+    print_usage();
+    return 1;
+#else
     bool clr_ln = false;
     const std::string var_name = "x";
     int range_upper = 5;
     int range_lower = -5;
-    int pt_step_count = min_pt;
 
     SDL_Event e;
     SDL_Window* pWindow = nullptr;
@@ -624,8 +9422,10 @@ int main()
     SDL_Texture* pTexture = nullptr;
 
     std::string in_txt;
-    std::vector<std::function<double(double)>> eqs_on_graph;
-    std::vector<std::string> eqs; //store input strings, so we can check for dupes
+    expr_cache cache(1 << 20, simd::accuracy::FAST);
+    std::vector<std::string> eqs_on_graph; //normalized input strings in the order of the curve layers
+    std::unordered_set<std::string> eqs; //normalized input strings, so we can check for dupes
+    size_t next_color = 0;
 
     //the exceptions throw if a sdl func fails will terminate the program
     if (SDL_Init(SDL_INIT_VIDEO) != 0) { throw SDL_error("SDL Failed to Init"); }
@@ -639,13 +9439,31 @@ int main()
     pTexture = SDL_CreateTexture(pRenderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, screen_w, screen_h);
     if (!pTexture) { throw SDL_error("SDL texture creation failed"); }
 
-    uint32_t* data = new uint32_t[screen_w * screen_h];
+    //plotting runs on the renderer's thread, which posts frame_event for every frame it finishes
+    //this loop only queues changes and shows the frames, so zooming never waits for a plot
+    const Uint32 frame_event = SDL_RegisterEvents(1);
+    if (frame_event == static_cast<Uint32>(-1)) { throw SDL_error("SDL event registration failed"); }
+    std::vector<uint32_t> frame(static_cast<size_t>(screen_w) * screen_h, black);
+    async_renderer renderer(screen_w, screen_h, [frame_event]
+    {
+        SDL_Event ev{};
+        ev.type = frame_event;
+        SDL_PushEvent(&ev);
+    });
+#ifdef PROFILING_ENABLED
+    bool show_profile = false;
+    profiler::frame_meter meter;
+#endif
 
     SDL_StartTextInput();
-    create_canvas(data);
-    render(pWindow, pRenderer, pTexture, data);
+    renderer.edit([=](layered_canvas& layers) { layers.set_viewport(range_lower, range_upper); });
 
-    std::cout << "zoom out with arrow down, zoom in with arrow up, reset with del, exit with esc\n";
+    std::cout << "zoom out with arrow down, zoom in with arrow up, reset with del, exit with esc\n"
+              << "f1-f9 show/hide a curve, shift+f1-f9 change its color, ctrl+f1-f9 remove it\n"
+              << "formulas with y are drawn as heatmaps, a = b as implicit curves, f10 switches between the two\n";
+#ifdef PROFILING_ENABLED
+    std::cout << "f11 shows the frame time and evaluation rate, f12 writes " << profiler::trace_file << '\n';
+#endif
 
     for (;;)
     {
@@ -654,9 +9472,27 @@ int main()
         {       
             if (e.type == SDL_QUIT)
             {
-                delete[] data;
+                renderer.stop();
                 shutdown(&pWindow, &pRenderer, &pTexture);          
             }
+            //a preview or refined frame is done, older ones it replaced are never shown
+            else if (e.type == frame_event)
+            {
+                if (const auto info = renderer.take_frame(frame))
+                {
+#ifdef PROFILING_ENABLED
+                    if (info->refined)
+                    {
+                        meter.add(info->seconds, info->plot_seconds, info->evals);
+                    }
+                    if (show_profile)
+                    {
+                        draw_profile_overlay({ frame.data(), screen_w, screen_h }, meter);
+                    }
+#endif
+                    render(pWindow, pRenderer, pTexture, frame.data());
+                }
+            }
             else if (e.type == SDL_TEXTINPUT)
             {
                 if (clr_ln)
@@ -671,7 +9507,7 @@ int main()
             {
                 if (e.key.keysym.sym == SDLK_ESCAPE)
                 {
-                    delete[] data;
+                    renderer.stop();
                     shutdown(&pWindow, &pRenderer, &pTexture);
                 }
                 //reset graph(default zoom, other params, clear)
@@ -680,12 +9516,14 @@ int main()
                     eqs.clear();
                     eqs_on_graph.clear();
                     std::cout << "\033[2J" << "\033[1;1H";
-                    memset(data, black, screen_w * screen_h * sizeof(uint32_t));
-                    create_canvas(data);
-                    render(pWindow, pRenderer, pTexture, data);
                     range_upper = 5;
                     range_lower = -5;
-                    pt_step_count = 1000;
+                    next_color = 0;
+                    renderer.edit([=](layered_canvas& layers)
+                    {
+                        layers.set_viewport(range_lower, range_upper);
+                        layers.clear_curves();
+                    });
                     std::cout << "range: " << range_lower << " to: " << range_upper << '\r';
                     continue;
                 }
@@ -697,19 +9535,9 @@ int main()
                         ++range_lower;
                         --range_upper;
                     }
-                    --pt_step_count;
-                    pt_step_count = std::max(pt_step_count, min_pt);
 
-                    if (!eqs_on_graph.empty())
-                    {
-                        memset(data, black, screen_w * screen_h * sizeof(uint32_t));
-                        create_canvas(data);
-                        for (const auto& func : eqs_on_graph)
-                        {
-                            plot(data, range_lower, range_upper, func, var_name, pt_step_count, range_upper);
-                        }
-                        render(pWindow, pRenderer, pTexture, data);
-                    }
+                    //held keys queue up zooms faster than they plot, the renderer only draws the last
+                    renderer.edit([=](layered_canvas& layers) { layers.set_viewport(range_lower, range_upper); });
                     std::cout << "range: " << range_lower << " to: " << range_upper << "    " <<'\r';
                     clr_ln = true;
                     continue;
@@ -719,23 +9547,70 @@ int main()
                 {
                     --range_lower;
                     ++range_upper;
-                    ++pt_step_count;
-                    pt_step_count = std::min(pt_step_count, max_pt);
 
-                    if (!eqs_on_graph.empty())
+                    //held keys queue up zooms faster than they plot, the renderer only draws the last
+                    renderer.edit([=](layered_canvas& layers) { layers.set_viewport(range_lower, range_upper); });
+                    std::cout << "range: " << range_lower << " to: " << range_upper << "    " << '\r';
+                    clr_ln = true;
+                    continue;
+                }
+                //the curve of the nth equation, only composed again, nothing is replotted
+                else if (e.key.keysym.sym >= SDLK_F1 && e.key.keysym.sym <= SDLK_F9)
+                {
+                    const size_t i = e.key.keysym.sym - SDLK_F1;
+                    if (i >= eqs_on_graph.size())
+                    {
+                        continue;
+                    }
+                    if (e.key.keysym.mod & KMOD_CTRL)
+                    {
+                        eqs.erase(eqs_on_graph[i]);
+                        eqs_on_graph.erase(eqs_on_graph.begin() + i);
+                        renderer.edit([i](layered_canvas& layers) { layers.remove_curve(i); });
+                    }
+                    else if (e.key.keysym.mod & KMOD_SHIFT)
+                    {
+                        const uint32_t color = curve_colors[next_color++ % std::size(curve_colors)];
+                        renderer.edit([i, color](layered_canvas& layers) { layers.set_color(i, color); });
+                    }
+                    else
+                    {
+                        renderer.edit([i](layered_canvas& layers) { layers.set_visible(i, !layers.curve(i).visible); });
+                    }
+                    continue;
+                }
+                //heatmaps become implicit curves and the other way around
+                else if (e.key.keysym.sym == SDLK_F10)
+                {
+                    renderer.edit([](layered_canvas& layers)
                     {
-                        memset(data, black, screen_w * screen_h * sizeof(uint32_t));
-                        create_canvas(data);
-                        for (const auto& func : eqs_on_graph)
+                        for (size_t i = 0; i < layers.curve_count(); i++)
                         {
-                            plot(data, range_lower, range_upper, func, var_name, pt_step_count, range_upper);
+                            if (const auto mode = layers.curve(i).field)
+                            {
+                                layers.set_field_mode(i, *mode == field_mode::HEATMAP ? field_mode::IMPLICIT : field_mode::HEATMAP);
+                            }
                         }
-                        render(pWindow, pRenderer, pTexture, data);
-                    }
-                    std::cout << "range: " << range_lower << " to: " << range_upper << "    " << '\r';
-                    clr_ln = true;
+                    });
+                    continue;
+                }
+#ifdef PROFILING_ENABLED
+                //frame time and evaluation rate on screen
+                else if (e.key.keysym.sym == SDLK_F11)
+                {
+                    show_profile = !show_profile;
+                    renderer.edit();
                     continue;
                 }
+                //everything timed so far, for chrome://tracing or ui.perfetto.dev
+                else if (e.key.keysym.sym == SDLK_F12)
+                {
+                    std::ofstream trace(profiler::trace_file);
+                    profiler::write_chrome_trace(trace);
+                    std::cout << (trace ? "trace written to " : "couldn't write ") << profiler::trace_file << '\n';
+                    continue;
+                }
+#endif
                 //delete last char from in_txt
                 else if (e.key.keysym.sym == SDLK_BACKSPACE)
                 {
@@ -760,16 +9635,36 @@ int main()
         {
             try
             {
-                auto rpn = parser::s_yard(in_txt, var_name); //will throw if there is bad input
-                auto func = parser::build_func(rpn, var_name);
+                //a = b is the implicit curve a - b = 0, any other formula using y is a heatmap
+                const std::string_view field_vars[] = { var_name, "y" };
+                const size_t eq = in_txt.find('=');
+                const std::string text = eq == std::string::npos ? in_txt : "(" + in_txt.substr(0, eq) + ")-(" + in_txt.substr(eq + 1) + ")";
+                const bool field = eq != std::string::npos || std::ranges::any_of(parser::tokenize(text, field_vars), [](const parser::token& tok)
+                {
+                    return tok.kind == parser::token_kind::IDENTIFIER && tok.text == "y";
+                });
+                //will throw if there is bad input
+                auto func = field ? cache.get(text, field_vars) : cache.get(text, var_name);
                 
                 //if eq is not already on graph
-                if (std::find(eqs.begin(), eqs.end(), in_txt) == eqs.end()) 
+                const auto key = field ? expr_cache::normalize(text, field_vars) : expr_cache::normalize(text, var_name);
+                if (eqs.insert(key).second) 
                 {                  
-                    plot(data, range_lower, range_upper, func, var_name, pt_step_count, range_upper);
-                    render(pWindow, pRenderer, pTexture, data);
-                    eqs_on_graph.push_back(func);
-                    eqs.push_back(in_txt);
+                    const uint32_t color = curve_colors[next_color++ % std::size(curve_colors)];
+                    const std::optional<field_mode> mode = field ? std::optional(eq == std::string::npos ? field_mode::HEATMAP : field_mode::IMPLICIT)
+                                                                 : std::nullopt;
+                    renderer.edit([func, mode, color](layered_canvas& layers)
+                    {
+                        if (mode)
+                        {
+                            layers.add_field(func, *mode, color);
+                        }
+                        else
+                        {
+                            layers.add_curve(func, color);
+                        }
+                    });
+                    eqs_on_graph.push_back(key);
                 }      
             }
             catch (const parser::parse_error& exc)
@@ -778,4 +9673,5 @@ int main()
             }            
         }
     }
-}
\ No newline at end of file
+#endif
+}